@@ -13,16 +13,20 @@ void DS18B20SettingsDialog::setDevice(DeviceDS18B20 *device)
 	idLabel->setText(OneWireDevice::dallasRomIdString(device->romId()));
 	tempDevice = *device;
 	resolutionSpinBox->setValue(tempDevice.resolution());
+	alarmLowSpinBox->setValue(tempDevice.alarmLow());
+	alarmHighSpinBox->setValue(tempDevice.alarmHigh());
 }
 
 void DS18B20SettingsDialog::accept()
 {
 	DallasError error;
+	tempDevice.setAlarmLow(alarmLowSpinBox->value());
+	tempDevice.setAlarmHigh(alarmHighSpinBox->value());
 	setCursor(Qt::WaitCursor);
 	error = tempDevice.writeConfiguration();
 	unsetCursor();
 	if (error != DALLAS_NO_ERROR) {
-		QMessageBox::warning(this, tr("Dallas error"), QString(dallasGetErrorText(error)));
+		QMessageBox::warning(this, tr("Dallas error"), QString(dallasGetErrorText(tempDevice.dallasBus(), error)));
 		return;
 	}
 	*m_device = tempDevice;
@@ -31,11 +35,10 @@ void DS18B20SettingsDialog::accept()
 
 void DS18B20SettingsDialog::on_resolutionSpinBox_valueChanged(int /*i*/)
 {
-	const int Tconv = 750;
 	tempDevice.setResolution(resolutionSpinBox->value());
 	stepSizeLabel->setText(DeviceDS18B20::temperatureText(
 		1.0 / (1 << (tempDevice.resolution() - DS18B20_RES_MIN + 1))));
 	conversionTimeLabel->setText(QString::number(
-		double(Tconv) / (1 << (DS18B20_RES_MAX - tempDevice.resolution())), 'f', 2) + " ms");
+		double(ds18b20ConversionTime(tempDevice.resolution())) / 1000, 'f', 2) + " ms");
 }
 
@@ -8,7 +8,7 @@ DS2450SettingsDialog::DS2450SettingsDialog(QWidget *parent)
 {
 	setupUi(this);
 	channelControls.append(ChannelControlSet(&tempDevice, 0, resolutionSpinBox, inputRangeComboBox, stepSizeLabel, 
-		discretenessComboBox, filterComboBox));
+		discretenessComboBox, filterComboBox, alarmLowSpinBox, alarmHighSpinBox));
 	createChannelSettingsTabs();
 }
 
@@ -29,6 +29,8 @@ void DS2450SettingsDialog::setDevice(DeviceDS2450 *device)
 		}
 		tempDevice.setDiscreteness(i, discreteness[channelControls[i].discretenessComboBox->currentIndex()]);
 		channelControls[i].filterComboBox->setCurrentIndex(tempDevice.filterType(i));
+		channelControls[i].alarmLowSpinBox->setValue(tempDevice.alarmLow(i));
+		channelControls[i].alarmHighSpinBox->setValue(tempDevice.alarmHigh(i));
 	}
 }
 
@@ -60,13 +62,27 @@ void DS2450SettingsDialog::on_discretenessComboBox_currentIndexChanged(int /*i*/
 			ccs.on_discretenessComboBox_currentIndexChanged();
 }
 
+void DS2450SettingsDialog::on_alarmLowSpinBox_valueChanged(int /*i*/)
+{
+	foreach(ChannelControlSet ccs, channelControls)
+		if (sender() == ccs.alarmLowSpinBox)
+			ccs.on_alarmLowSpinBox_valueChanged();
+}
+
+void DS2450SettingsDialog::on_alarmHighSpinBox_valueChanged(int /*i*/)
+{
+	foreach(ChannelControlSet ccs, channelControls)
+		if (sender() == ccs.alarmHighSpinBox)
+			ccs.on_alarmHighSpinBox_valueChanged();
+}
+
 void DS2450SettingsDialog::createChannelSettingsTabs()
 {
 	while(channelControls.size() < 4) {
 		QWidget *tab = new QWidget;
 		QGridLayout *layout = new QGridLayout(tab);
 		ChannelControlSet ccs(&tempDevice, channelControls.size(), new QSpinBox(this), new QComboBox(this), new QLabel(this), 
-			new QComboBox(this), new QComboBox(this));
+			new QComboBox(this), new QComboBox(this), new QSpinBox(this), new QSpinBox(this));
 
 		ccs.resolutionSpinBox->setGeometry(resolutionSpinBox->geometry());
 		ccs.resolutionSpinBox->setSizePolicy(resolutionSpinBox->sizePolicy());
@@ -94,6 +110,17 @@ void DS2450SettingsDialog::createChannelSettingsTabs()
 		for (int i = 0; i < filterComboBox->count(); ++i)
 			ccs.filterComboBox->addItem(filterComboBox->itemText(i));
 
+		QSpinBox *alarmSpinBoxes[] = { ccs.alarmLowSpinBox, ccs.alarmHighSpinBox };
+		QSpinBox *prototypeSpinBoxes[] = { alarmLowSpinBox, alarmHighSpinBox };
+		for (int i = 0; i < 2; ++i) {
+			alarmSpinBoxes[i]->setGeometry(prototypeSpinBoxes[i]->geometry());
+			alarmSpinBoxes[i]->setSizePolicy(prototypeSpinBoxes[i]->sizePolicy());
+			alarmSpinBoxes[i]->setToolTip(prototypeSpinBoxes[i]->toolTip());
+			alarmSpinBoxes[i]->setMinimum(prototypeSpinBoxes[i]->minimum());
+			alarmSpinBoxes[i]->setMaximum(prototypeSpinBoxes[i]->maximum());
+			alarmSpinBoxes[i]->setValue(prototypeSpinBoxes[i]->value());
+		}
+
 		QLabel *label = new QLabel(this);
 		label->setText(resolutionLabel->text());
 		layout->addWidget(label, 0, 0);
@@ -119,6 +146,16 @@ void DS2450SettingsDialog::createChannelSettingsTabs()
 		layout->addWidget(label, 4, 0);
 		layout->addWidget(ccs.filterComboBox, 4, 1);
 
+		label = new QLabel(this);
+		label->setText(alarmLowLabel->text());
+		layout->addWidget(label, 5, 0);
+		layout->addWidget(ccs.alarmLowSpinBox, 5, 1);
+
+		label = new QLabel(this);
+		label->setText(alarmHighLabel->text());
+		layout->addWidget(label, 6, 0);
+		layout->addWidget(ccs.alarmHighSpinBox, 6, 1);
+
 		channelControls.append(ccs);
 		channelsTabWidget->addTab(tab, QString::number(channelControls.size()));
 
@@ -130,6 +167,10 @@ void DS2450SettingsDialog::createChannelSettingsTabs()
 			this, SLOT(on_discretenessComboBox_currentIndexChanged(int)));
 		connect(ccs.filterComboBox, SIGNAL(currentIndexChanged(int)),
 			this, SLOT(on_filterComboBox_currentIndexChanged(int)));
+		connect(ccs.alarmLowSpinBox, SIGNAL(valueChanged(int)),
+			this, SLOT(on_alarmLowSpinBox_valueChanged(int)));
+		connect(ccs.alarmHighSpinBox, SIGNAL(valueChanged(int)),
+			this, SLOT(on_alarmHighSpinBox_valueChanged(int)));
 	}
 }
 
@@ -140,7 +181,7 @@ void DS2450SettingsDialog::accept()
 	error = tempDevice.writeConfiguration();
 	unsetCursor();
 	if (error != DALLAS_NO_ERROR) {
-		QMessageBox::warning(this, tr("Dallas error"), QString(dallasGetErrorText(error)));
+		QMessageBox::warning(this, tr("Dallas error"), QString(dallasGetErrorText(tempDevice.dallasBus(), error)));
 		return;
 	}
 	*m_device = tempDevice;
@@ -169,6 +210,16 @@ void DS2450SettingsDialog::ChannelControlSet::on_filterComboBox_currentIndexChan
 	m_device->setFilterType(m_channel, DeviceDS2450::FilterType(filterComboBox->currentIndex()));
 }
 
+void DS2450SettingsDialog::ChannelControlSet::on_alarmLowSpinBox_valueChanged()
+{
+	m_device->setAlarmLow(m_channel, alarmLowSpinBox->value());
+}
+
+void DS2450SettingsDialog::ChannelControlSet::on_alarmHighSpinBox_valueChanged()
+{
+	m_device->setAlarmHigh(m_channel, alarmHighSpinBox->value());
+}
+
 void DS2450SettingsDialog::ChannelControlSet::updateStepSize()
 {
 	stepSizeLabel->setText(m_device->milliVoltsText(m_device->milliVoltsStep(m_channel)));
@@ -27,6 +27,8 @@ private slots:
 	void on_inputRangeComboBox_currentIndexChanged(int i);
 	void on_discretenessComboBox_currentIndexChanged(int i);
 	void on_filterComboBox_currentIndexChanged(int i);
+	void on_alarmLowSpinBox_valueChanged(int i);
+	void on_alarmHighSpinBox_valueChanged(int i);
 
 private:
 	void createChannelSettingsTabs();
@@ -35,20 +37,25 @@ private:
 	class ChannelControlSet {
 	public:
 		ChannelControlSet() {}
-		ChannelControlSet(DeviceDS2450 *device, int channel, QSpinBox *rsb, QComboBox *ircb, QLabel *ssl, QComboBox *dcb, QComboBox *fcb)
+		ChannelControlSet(DeviceDS2450 *device, int channel, QSpinBox *rsb, QComboBox *ircb, QLabel *ssl, QComboBox *dcb, QComboBox *fcb,
+			QSpinBox *alsb, QSpinBox *ahsb)
 			: m_device(device), m_channel(channel), resolutionSpinBox(rsb), inputRangeComboBox(ircb), stepSizeLabel(ssl), 
-			discretenessComboBox(dcb), filterComboBox(fcb) { }
+			discretenessComboBox(dcb), filterComboBox(fcb), alarmLowSpinBox(alsb), alarmHighSpinBox(ahsb) { }
 
 		void on_resolutionSpinBox_valueChanged();
 		void on_inputRangeComboBox_currentIndexChanged();
 		void on_discretenessComboBox_currentIndexChanged();
 		void on_filterComboBox_currentIndexChanged();
+		void on_alarmLowSpinBox_valueChanged();
+		void on_alarmHighSpinBox_valueChanged();
 
 		QSpinBox *resolutionSpinBox;
 		QComboBox *inputRangeComboBox;
 		QLabel *stepSizeLabel;
 		QComboBox *discretenessComboBox;
 		QComboBox *filterComboBox;
+		QSpinBox *alarmLowSpinBox;
+		QSpinBox *alarmHighSpinBox;
 		void updateStepSize();
 		DeviceDS2450 *m_device;
 		int m_channel;
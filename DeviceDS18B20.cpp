@@ -1,6 +1,17 @@
 #include "DeviceDS18B20.h"
 #include "dallas/ds18x20.h"
 
+DeviceDS18B20::DeviceDS18B20() : OneWireDevice(DS18B20_FAMILY)
+{
+	m_resolution = DS18B20_RES_MAX;
+	m_alarmLow = DS18B20_NO_ALARM_LOW;
+	m_alarmHigh = DS18B20_NO_ALARM_HIGH;
+	m_isConditionMet = true;
+	m_temperature = m_sample = 85;
+	m_isExternallyPowered = false;
+	memset(m_learnedTimes, 0, sizeof(m_learnedTimes));
+}
+
 OneWireDevice *DeviceDS18B20::clone() const
 {
 	DeviceDS18B20 *device = new DeviceDS18B20();
@@ -10,19 +21,29 @@ OneWireDevice *DeviceDS18B20::clone() const
 
 DeviceDS18B20 &DeviceDS18B20::operator=(const DeviceDS18B20 &source)
 {
-	QMutexLocker locker(busMutex);
+	OneWireBusLocker locker(this);
 	static_cast<OneWireDevice &>(*this) = static_cast<const OneWireDevice &>(source);
 	m_temperature = source.m_temperature;
 	m_resolution = source.m_resolution;
+	m_alarmLow = source.m_alarmLow;
+	m_alarmHigh = source.m_alarmHigh;
+	m_isExternallyPowered = source.m_isExternallyPowered;
+	memcpy(m_learnedTimes, source.m_learnedTimes, sizeof(m_learnedTimes));
 	return *this;
 }
 
 DallasError DeviceDS18B20::readConfiguration()
 {
-	QMutexLocker locker(busMutex);
-	DallasError error = ds18b20GetResolution(&id, &m_resolution);
+	OneWireBusLocker locker(this);
+	DallasError error = ds18b20GetResolution(bus, &id, &m_resolution);
+	u08 isExternallyPowered = 0;
+	if (error == DALLAS_NO_ERROR)
+		error = ds18b20GetAlarms(bus, &id, &m_alarmLow, &m_alarmHigh);
+	if (error == DALLAS_NO_ERROR)
+		error = ds18b20ReadPowerSupply(bus, &id, &isExternallyPowered);
+	m_isExternallyPowered = isExternallyPowered;
 	if (error != DALLAS_NO_ERROR) {
-		QString message(dallasGetErrorText(error));
+		QString message(dallasGetErrorText(bus, error));
 		emitError(message);
 	}
 	return error;
@@ -30,51 +51,93 @@ DallasError DeviceDS18B20::readConfiguration()
 
 DallasError DeviceDS18B20::writeConfiguration()
 {
-	QMutexLocker locker(busMutex);
-	DallasError error = ds18b20Setup(&id, m_resolution, DS18B20_NO_ALARM_LOW, DS18B20_NO_ALARM_HIGH);
+	OneWireBusLocker locker(this);
+	DallasError error = ds18b20Setup(bus, &id, m_resolution, m_alarmLow, m_alarmHigh);
 	if (error != DALLAS_NO_ERROR) {
-		QString message(dallasGetErrorText(error));
+		QString message(dallasGetErrorText(bus, error));
 		emitError(message);
 	}
 	return error;
 }
 
-DallasError DeviceDS18B20::readState()
+// learned conversion times are kept too, the first poll does not measure them again
+void DeviceDS18B20::saveConfiguration(QDataStream &stream) const
 {
-	DallasError error = prepareState(&id);
-	if (error == DALLAS_NO_ERROR)
-		error = readPreparedState();
-	return error;
+	stream << quint8(m_resolution) << qint8(m_alarmLow) << qint8(m_alarmHigh) << m_isExternallyPowered;
+	for (int i = 0; i <= DS18B20_RES_MAX - DS18B20_RES_MIN; ++i)
+		stream << quint32(m_learnedTimes[i]);
 }
 
-DallasError DeviceDS18B20::prepareState(dallas_rom_id_T *rom_id)
+void DeviceDS18B20::loadConfiguration(QDataStream &stream)
 {
-	QMutexLocker locker(busMutex);
-	DallasError error = ds18b20Start(rom_id);
-	if (error != DALLAS_NO_ERROR) {
-		QString message(dallasGetErrorText(error));
-		emitError(message);
+	quint8 resolution;
+	qint8 alarmLow, alarmHigh;
+	stream >> resolution >> alarmLow >> alarmHigh >> m_isExternallyPowered;
+	m_resolution = resolution;
+	m_alarmLow = alarmLow;
+	m_alarmHigh = alarmHigh;
+	for (int i = 0; i <= DS18B20_RES_MAX - DS18B20_RES_MIN; ++i) {
+		quint32 time;
+		stream >> time;
+		m_learnedTimes[i] = time;
 	}
-	else {
-		dallasWaitUntilDone();					// wait until conversion done
+}
+
+void DeviceDS18B20::startReadState(dallas_job_T *job, bool isPrepared)
+{
+	if (isPrepared && !m_isConditionMet) {
+		// the sensor has stayed in the window, the job is empty
+		dallasJobInit(job, 0, 0, 0);
+		return;
+	}
+	m_isConditionMet = true;
+	if (isPrepared)
+		ds18b20ResultJob(job, &id, &m_sample);
+	else
+		ds18b20StartAndResultJob(job, &id, conversionTime(), &m_sample);
+	if (m_isExternallyPowered) {
+		job->flags |= DALLAS_JOB_POLL_DONE;
+		job->expected_us = learnedConversionTime();
+	} else {
+		job->flags |= DALLAS_JOB_PARASITE_POWER;
 	}
-	return error;
 }
 
-DallasError DeviceDS18B20::readPreparedState()
+DallasError DeviceDS18B20::finishReadState(dallas_job_T *job, DallasError error)
 {
 	unsigned short oldTemperature = m_temperature;
 
-	QMutexLocker locker(busMutex);
-	DallasError error = ds18b20Result(&id, &m_temperature);
+	if (!m_isConditionMet) {
+		m_isConditionMet = true;
+		return error;
+	}
+	if (error == DALLAS_NO_ERROR && job->measured_us)
+		learnConversionTime(job->measured_us);
+
+	OneWireBusLocker locker(this);
 	if (error != DALLAS_NO_ERROR) {
-		QString message(dallasGetErrorText(error));
+		QString message(dallasGetErrorText(bus, error));
 		emitError(message);
 		return error;
 	}
 
+	m_temperature = m_sample;
 	if (m_temperature != oldTemperature)
 		emitChannelStateChanged(0, oldTemperature, m_temperature);
+	adaptPollPeriod(&m_temperature, ChannelCount);
 
 	return error;
 }
+
+unsigned int DeviceDS18B20::learnedConversionTime()
+{
+	if (m_resolution < DS18B20_RES_MIN || m_resolution > DS18B20_RES_MAX)
+		return 0;
+	return m_learnedTimes[m_resolution - DS18B20_RES_MIN];
+}
+
+void DeviceDS18B20::learnConversionTime(unsigned int time)
+{
+	if (m_resolution >= DS18B20_RES_MIN && m_resolution <= DS18B20_RES_MAX)
+		m_learnedTimes[m_resolution - DS18B20_RES_MIN] = time;
+}
@@ -9,7 +9,7 @@ public:
 	static const int ChannelCount = 1;
 
 public:
-	DeviceDS18B20() : OneWireDevice(DS18B20_FAMILY) { m_temperature = 85; }
+	DeviceDS18B20();
 	~DeviceDS18B20() { }
 	
 	OneWireDevice *clone() const;
@@ -20,8 +20,18 @@ public:
 	unsigned char resolution()						{ return m_resolution; }
 	void setResolution(unsigned char resolution)	{ m_resolution = resolution; }
 
+	// alarm window in whole degrees, DS18B20_NO_ALARM_LOW and DS18B20_NO_ALARM_HIGH disable
+	// the thresholds, a sensor with a threshold is read only when it is out of the window
+	// or at the background rate, see isConditionalSearchArmed()
+	signed char alarmLow()							{ return m_alarmLow; }
+	void setAlarmLow(signed char deg)				{ m_alarmLow = deg; }
+	signed char alarmHigh()							{ return m_alarmHigh; }
+	void setAlarmHigh(signed char deg)				{ m_alarmHigh = deg; }
+
 	DallasError readConfiguration();
 	DallasError writeConfiguration();
+	void saveConfiguration(QDataStream &stream) const;
+	void loadConfiguration(QDataStream &stream);
 
 	// state
 
@@ -32,15 +42,26 @@ public:
 	static QString temperatureText(double deg)		{ return QString::number(deg, 'f', 4) + " "; }
 
 	bool isPrepareStateAllSupported()	{ return true; }
-	DallasError prepareStateAll()		{ return prepareState(0); }
-	DallasError readPreparedState();
-	DallasError readState();
+	void startPrepareStateAll(dallas_job_T *job, unsigned int conversionTime)	{ ds18b20StartJob(job, 0, conversionTime); }
+	unsigned int conversionTime()		{ return ds18b20ConversionTime(m_resolution); }
+	bool isExternallyPowered()			{ return m_isExternallyPowered; }
+	unsigned int learnedConversionTime();
+	void learnConversionTime(unsigned int time);
+	void startReadState(dallas_job_T *job, bool isPrepared);
+	DallasError finishReadState(dallas_job_T *job, DallasError error);
 
-private:
-	DallasError prepareState(dallas_rom_id_T *rom_id);
+	bool isConditionalSearchArmed()		{ return m_alarmLow > DS18B20_NO_ALARM_LOW || m_alarmHigh < DS18B20_NO_ALARM_HIGH; }
+	void setConditionMet(bool isMet)	{ m_isConditionMet = isMet; }
 
+private:
 	unsigned char m_resolution;
+	signed char m_alarmLow;
+	signed char m_alarmHigh;
+	bool m_isConditionMet;			// the alarm search has found the sensor out of the window
 	unsigned short m_temperature;
+	unsigned short m_sample;		// temperature read by the job
+	bool m_isExternallyPowered;
+	unsigned int m_learnedTimes[DS18B20_RES_MAX - DS18B20_RES_MIN + 1];	// conversion times by resolution, 0 - unknown
 };
 
 #endif //DEVICEDS18B20_H
\ No newline at end of file
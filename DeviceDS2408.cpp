@@ -13,15 +13,19 @@ DeviceDS2408 &DeviceDS2408::operator=(const DeviceDS2408 &source)
 	static_cast<OneWireDevice &>(*this) = static_cast<const OneWireDevice &>(source);
 	inputStates = source.inputStates;
 	outputStates = source.outputStates;
+	isSearchArmed = source.isSearchArmed;
 	return *this;
 }
 
 DallasError DeviceDS2408::readConfiguration()
 {
-	QMutexLocker locker(busMutex);
-	DallasError error = ds2408_read_output(&id, &outputStates);
+	OneWireBusLocker locker(this);
+	DallasError error = ds2408_read_output(bus, &id, &outputStates);
+	if (error == DALLAS_NO_ERROR)
+		error = ds2408_arm_activity_search(bus, &id);
+	isSearchArmed = (error == DALLAS_NO_ERROR);
 	if (error != DALLAS_NO_ERROR) {
-		QString message(dallasGetErrorText(error));
+		QString message(dallasGetErrorText(bus, error));
 		locker.unlock();
 		emitError(message);
 	}
@@ -30,30 +34,62 @@ DallasError DeviceDS2408::readConfiguration()
 
 DallasError DeviceDS2408::writeConfiguration()
 {
-	QMutexLocker locker(busMutex);
-	ds2408_write_register(&id, CONTROL_STATUS, RSTZ_STRB); // debug!! don't forget to remove!!
-	DallasError error = ds2408_write_output(&id, outputStates);
+	OneWireBusLocker locker(this);
+	ds2408_write_register(bus, &id, CONTROL_STATUS, RSTZ_STRB | (isSearchArmed ? PLS_LATCH : PLS_PIN)); // debug!! don't forget to remove!!
+	DallasError error = ds2408_write_output(bus, &id, outputStates);
 	if (error != DALLAS_NO_ERROR) {
-		QString message(dallasGetErrorText(error));
+		QString message(dallasGetErrorText(bus, error));
 		locker.unlock();
 		emitError(message);
 	}
 	return error;
 }
 
-DallasError DeviceDS2408::readState()
+void DeviceDS2408::saveConfiguration(QDataStream &stream) const
+{
+	stream << quint8(outputStates) << isSearchArmed;
+}
+
+// the activity search rearms itself if the device has been reset since, see ds2408_read_activity_job()
+void DeviceDS2408::loadConfiguration(QDataStream &stream)
+{
+	quint8 states;
+	stream >> states >> isSearchArmed;
+	outputStates = states;
+}
+
+void DeviceDS2408::startReadState(dallas_job_T *job, bool)
+{
+	if (!isSearchArmed)
+		ds2408_read_input_job(job, &id, &sampleStates);
+	else if (isActivityLatched)
+		ds2408_read_activity_job(job, &id, &sampleStates);
+	else {
+		// inputs have not changed since the last read
+		sampleStates = inputStates;
+		dallasJobInit(job, 0, 0, 0);
+	}
+	// a read without search before reads the inputs
+	isActivityLatched = true;
+}
+
+DallasError DeviceDS2408::finishReadState(dallas_job_T *, DallasError error)
 {
 	unsigned char oldInputStates = inputStates;
 
-	QMutexLocker locker(busMutex);
-	DallasError error = ds2408_read_input(&id, &inputStates);
+	OneWireBusLocker locker(this);
 	if (error != DALLAS_NO_ERROR) {
-		QString message(dallasGetErrorText(error));
+		QString message(dallasGetErrorText(bus, error));
 		locker.unlock();
 		emitError(message);
 	}
 	else {
+		inputStates = sampleStates;
 		locker.unlock();
+		unsigned short states[ChannelCount];
+		for (int i = 0; i < ChannelCount; ++i)
+			states[i] = (inputStates >> i) & 1;
+		adaptPollPeriod(states, ChannelCount);
 	}
 
 	for (int i = 0; i < ChannelCount; ++i) {
@@ -9,7 +9,7 @@ public:
 	static const int ChannelCount = 8;
 
 public:
-	DeviceDS2408() : OneWireDevice(DS2408_FAMILY) { inputStates = outputStates = 0; }
+	DeviceDS2408() : OneWireDevice(DS2408_FAMILY) { inputStates = outputStates = sampleStates = 0; isSearchArmed = false; isActivityLatched = true; }
 	~DeviceDS2408() { }
 	
 	OneWireDevice *clone() const;
@@ -22,16 +22,27 @@ public:
 
 	DallasError readConfiguration();
 	DallasError writeConfiguration();
+	void saveConfiguration(QDataStream &stream) const;
+	void loadConfiguration(QDataStream &stream);
 
 	// state
 
 	bool isInputHigh(int channel)							{ return inputStates & (1 << channel) ? true : false; }
 
-	DallasError readState();
+	void startReadState(dallas_job_T *job, bool isPrepared);
+	DallasError finishReadState(dallas_job_T *job, DallasError error);
+
+	// activity latches of inputs arm the conditional search, the inputs are read
+	// only when a latch is set and the read resets the latches
+	bool isConditionalSearchArmed()							{ return isSearchArmed; }
+	void setConditionMet(bool isMet)						{ isActivityLatched = isMet; }
 
 private:
 	unsigned char inputStates;
 	unsigned char outputStates;
+	unsigned char sampleStates;		// input states read by the job
+	bool isSearchArmed;
+	bool isActivityLatched;			// the last search has found input activity
 };
 
 #endif //DEVICEDS2408_H
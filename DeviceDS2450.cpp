@@ -11,11 +11,17 @@ static const int DefaultMedianWindowSize = 15;
 DeviceDS2450::DeviceDS2450() : 
 	OneWireDevice(DS2450_FAMILY)
 {
+	samplingRound = 0;
+	isSamplingPrepared = false;
+	isConditionMet = true;
+	isSeriesSkipped = false;
 	for (int i = 0; i < ChannelCount; ++i) {
 		ranges[i] = DS2450_RANGE_2V;
+		alarmLows[i] = DS2450_NO_ALARM_LOW;
+		alarmHighs[i] = DS2450_NO_ALARM_HIGH;
 		outputStates[i] = 0;
 		resolutions[i] = 8;
-		values[i] = 0;
+		values[i] = rawValues[i] = newValues[i] = 0;
 		filters[i] = 0;
 		setFilterType(i, MedianLowPass);
 		setDiscreteness(i, DefaultDiscreteness);
@@ -32,12 +38,15 @@ DeviceDS2450::~DeviceDS2450()
 
 DeviceDS2450 &DeviceDS2450::operator=(const DeviceDS2450 &source)
 {
-	QMutexLocker locker(busMutex);
+	OneWireBusLocker locker(this);
 	static_cast<OneWireDevice &>(*this) = static_cast<const OneWireDevice &>(source);
 	memcpy(ranges, source.ranges, sizeof(ranges));
 	memcpy(outputStates, source.outputStates, sizeof(outputStates));
 	memcpy(resolutions, source.resolutions, sizeof(resolutions));
 	memcpy(values, source.values, sizeof(values));
+	memcpy(alarmLows, source.alarmLows, sizeof(alarmLows));
+	memcpy(alarmHighs, source.alarmHighs, sizeof(alarmHighs));
+	learnedTimes = source.learnedTimes;
 	for (int i = 0; i < ChannelCount; ++i) {
 		setFilterType(i, source.filterType(i));
 		setDiscreteness(i, source.discreteness(i));
@@ -54,10 +63,12 @@ OneWireDevice *DeviceDS2450::clone() const
 
 DallasError DeviceDS2450::readConfiguration()
 {
-	QMutexLocker locker(busMutex);
-	DallasError error = ds2450ReadAllSettings(&id, resolutions, ranges, outputStates);
+	OneWireBusLocker locker(this);
+	DallasError error = ds2450ReadAllSettings(bus, &id, resolutions, ranges, outputStates);
+	if (error == DALLAS_NO_ERROR)
+		error = ds2450ReadAlarms(bus, &id, alarmLows, alarmHighs);
 	if (error != DALLAS_NO_ERROR) {
-		QString message(dallasGetErrorText(error));
+		QString message(dallasGetErrorText(bus, error));
 		emitError(message);
 	}
 	return error;
@@ -65,34 +76,114 @@ DallasError DeviceDS2450::readConfiguration()
 
 DallasError DeviceDS2450::writeConfiguration()
 {
-	QMutexLocker locker(busMutex);
-	DallasError error = ds2450WriteAllSettings(&id, resolutions, ranges, outputStates);
+	OneWireBusLocker locker(this);
+	DallasError error = ds2450WriteAllSettings(bus, &id, resolutions, ranges, outputStates);
+	if (error == DALLAS_NO_ERROR)
+		error = ds2450WriteAlarms(bus, &id, alarmLows, alarmHighs);
 	if (error != DALLAS_NO_ERROR) {
-		QString message(dallasGetErrorText(error));
+		QString message(dallasGetErrorText(bus, error));
 		emitError(message);
 	}
 	return error;
 }
 
-DallasError DeviceDS2450::readState()
+// learned conversion times are kept too, the first poll does not measure them again
+void DeviceDS2450::saveConfiguration(QDataStream &stream) const
 {
-	unsigned short newValues[ChannelCount];
+	for (int i = 0; i < ChannelCount; ++i)
+		stream << quint8(resolutions[i]) << quint8(ranges[i]) << quint8(outputStates[i]) << quint8(alarmLows[i]) << quint8(alarmHighs[i]);
+	stream << learnedTimes;
+}
 
-	QMutexLocker locker(busMutex);
-	for (int k = 0; k < SamplingSeriesLength; ++k) {
-		unsigned short rawValues[ChannelCount];
+void DeviceDS2450::loadConfiguration(QDataStream &stream)
+{
+	for (int i = 0; i < ChannelCount; ++i) {
+		quint8 resolution, range, outputState, alarmLow, alarmHigh;
+		stream >> resolution >> range >> outputState >> alarmLow >> alarmHigh;
+		setResolution(i, resolution);
+		setRange(i, VoltageRange(range));
+		outputStates[i] = outputState;
+		alarmLows[i] = alarmLow;
+		alarmHighs[i] = alarmHigh;
+	}
+	stream >> learnedTimes;
+}
 
-		DallasError error = ds2450StartAll(0);		// to save 5.6 ms (actually 8-9 ms), send SKIP_ROM command instead of MATCH_ROM command and 8 bytes of rom id
-		if (error == DALLAS_NO_ERROR)
-			error = ds2450ResultAll(&id, rawValues);
-		if (error != DALLAS_NO_ERROR) {
-			QString message(dallasGetErrorText(error));
-			emitError(message);
-			return error;
-		}
-		for (int i = 0; i < ChannelCount; ++i) {
-			newValues[i] = filters[i]->filter(rawValues[i]);
-		}
+void DeviceDS2450::startReadState(dallas_job_T *job, bool)
+{
+	samplingRound = 0;
+	isSamplingPrepared = false;
+	isConditionMet = true;
+	isSeriesSkipped = false;
+	startSampling(job);
+}
+
+void DeviceDS2450::startPrepareStateAll(dallas_job_T *job, unsigned int conversionTime)
+{
+	ds2450StartAllJob(job, 0);
+	job->conversion_us = conversionTime;
+}
+
+void DeviceDS2450::startPreparedRound(dallas_job_T *job, int round)
+{
+	if (!round) {
+		isSeriesSkipped = !isConditionMet;
+		isConditionMet = true;
+	}
+	samplingRound = round;
+	isSamplingPrepared = true;
+	if (isSeriesSkipped) {
+		// no level crossed, the job is empty
+		dallasJobInit(job, 0, 0, 0);
+		return;
+	}
+	ds2450ResultAllJob(job, &id, rawValues);
+}
+
+bool DeviceDS2450::isConditionalSearchArmed()
+{
+	for (int i = 0; i < ChannelCount; ++i) {
+		if (alarmLows[i] != DS2450_NO_ALARM_LOW || alarmHighs[i] != DS2450_NO_ALARM_HIGH)
+			return true;
+	}
+	return false;
+}
+
+void DeviceDS2450::startSampling(dallas_job_T *job)
+{
+	ds2450StartAndResultAllJob(job, &id, rawValues);
+	job->flags |= DALLAS_JOB_START_ALL;		// to save 5.6 ms (actually 8-9 ms), send SKIP_ROM command instead of MATCH_ROM command and 8 bytes of rom id
+	job->expected_us = learnedConversionTime();
+}
+
+int DeviceDS2450::conversionBits() const
+{
+	int bits = 0;
+	for (int i = 0; i < ChannelCount; ++i)
+		bits += resolutions[i];
+	return bits;
+}
+
+DallasError DeviceDS2450::finishReadState(dallas_job_T *job, DallasError error)
+{
+	OneWireBusLocker locker(this);
+	if (error != DALLAS_NO_ERROR) {
+		QString message(dallasGetErrorText(bus, error));
+		emitError(message);
+		return error;
+	}
+	if (isSeriesSkipped)
+		return DALLAS_NO_ERROR;
+	if (job->measured_us)
+		learnConversionTime(job->measured_us);
+	for (int i = 0; i < ChannelCount; ++i) {
+		newValues[i] = filters[i]->filter(rawValues[i]);
+	}
+	if (++samplingRound < SamplingSeriesLength) {
+		if (isSamplingPrepared)
+			return DALLAS_NO_ERROR;
+		startSampling(job);
+		return DALLAS_PENDING;
 	}
 	for (int i = 0; i < ChannelCount; ++i) {
 		unsigned short oldValue = values[i];
@@ -100,6 +191,7 @@ DallasError DeviceDS2450::readState()
 		if (values[i] != oldValue)
 			emitChannelStateChanged(i, oldValue, values[i]);
 	}
+	adaptPollPeriod(values, ChannelCount);
 	return DALLAS_NO_ERROR;
 }
 
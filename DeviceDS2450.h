@@ -2,6 +2,7 @@
 #define DEVICEDS2450_H
 
 #include <QString>
+#include <QMap>
 #include "dallas/dallas.h"
 #include "dallas/ds2450.h"
 #include "OneWireBus.h"
@@ -47,12 +48,39 @@ public:
 	bool isValidResolution(int resolution)			{ return (resolution >= MinimalResolution) && (resolution <= MaximalResolution); }
 	bool isResolutionWithNoise(int resolution)		{ return (resolution >= MinimalNoiseResolution); }
 
+	// alarm levels compare the 8 most significant bits of the result, DS2450_NO_ALARM_LOW
+	// and DS2450_NO_ALARM_HIGH disable them, a converter with an alarm is read only when
+	// the first conversion of the series has crossed a level or at the background rate
+	unsigned char alarmLow(int channel) const		{ return alarmLows[channel]; }
+	void setAlarmLow(int channel, unsigned char level)	{ alarmLows[channel] = level; }
+	unsigned char alarmHigh(int channel) const		{ return alarmHighs[channel]; }
+	void setAlarmHigh(int channel, unsigned char level)	{ alarmHighs[channel] = level; }
+
 	bool isOutputActivated(int channel)				{ return outputStates[channel] == DS2450_OUTPUT_LOW; }
 	void setOutputActivated(int channel, bool isActivated)	{ outputStates[channel] = isActivated ? DS2450_OUTPUT_LOW : DS2450_OUTPUT_HIGH; }
 	
 	DallasError readConfiguration();
 	DallasError writeConfiguration();
-	DallasError readState();
+	void saveConfiguration(QDataStream &stream) const;
+	void loadConfiguration(QDataStream &stream);
+
+	void startReadState(dallas_job_T *job, bool isPrepared);
+	DallasError finishReadState(dallas_job_T *job, DallasError error);
+
+	// converters of the bus sample the series at once, each round is read from all of them
+	bool isPrepareStateAllSupported()				{ return true; }
+	void startPrepareStateAll(dallas_job_T *job, unsigned int conversionTime);
+	unsigned int conversionTime()					{ return DALLAS_CONVERSION_US; }
+	int preparedStateRounds()						{ return isSeriesSkipped ? 1 : SamplingSeriesLength; }
+	void startPreparedRound(dallas_job_T *job, int round);
+
+	bool isConditionalSearchArmed();
+	void setConditionMet(bool isMet)				{ isConditionMet = isMet; }
+
+	// setup makes the converters VCC powered, the conversion time depends on the sum of the resolutions
+	bool isExternallyPowered()						{ return true; }
+	unsigned int learnedConversionTime()			{ return learnedTimes.value(conversionBits()); }
+	void learnConversionTime(unsigned int time)		{ learnedTimes[conversionBits()] = time; }
 
 	// value
 	unsigned int value(int channel)					{ return values[channel] >> (MaximalResolution - resolutions[channel]); }
@@ -68,10 +96,22 @@ public:
 private:
 	static double voltage(unsigned short value, VoltageRange range) { return double(range == Voltage2560mV ? ValueVoltage2560mV : ValueVoltage5120mV) * value / (1 << MaximalResolution); }
 
+	void startSampling(dallas_job_T *job);
+	int conversionBits() const;
+
 	unsigned char ranges[ChannelCount];
 	unsigned char outputStates[ChannelCount];
 	unsigned char resolutions[ChannelCount];
 	unsigned short values[ChannelCount];
+	unsigned short rawValues[ChannelCount];			// sample read by the job
+	unsigned short newValues[ChannelCount];			// filtered samples of the series
+	int samplingRound;
+	bool isSamplingPrepared;						// the bus converts the rounds of the series
+	bool isConditionMet;							// the alarm search has found a level crossed
+	bool isSeriesSkipped;							// no level crossed, the series is not read
+	unsigned char alarmLows[ChannelCount];
+	unsigned char alarmHighs[ChannelCount];
+	QMap<int, unsigned int> learnedTimes;			// conversion times by conversionBits()
 	DigitalFilter_u16 *filters[ChannelCount];
 	FilterType filterTypes[ChannelCount];
 	HysteresisFilter_double voltageFilters[ChannelCount];
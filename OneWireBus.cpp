@@ -1,5 +1,6 @@
 #include <QTime>
 #include <QSettings>
+#include <QMetaType>
 
 #include "OneWireBus.h"
 #include "dallas/ds18x20.h"
@@ -48,13 +49,80 @@ QString OneWireDevice::dallasFamilyString(const dallas_rom_id_T &id)
 	}
 }
 
+DallasError OneWireDevice::prepareStateAll()
+{
+	dallas_job_T job;
+
+	startPrepareStateAll(&job, conversionTime());
+	// the power supply of all devices is not known here
+	job.flags |= DALLAS_JOB_PARASITE_POWER;
+	OneWireBusLocker locker(this);
+	DallasError error = dallasJobExecute(bus, &job);
+	if (error != DALLAS_NO_ERROR) {
+		QString message(dallasGetErrorText(bus, error));
+		locker.unlock();
+		emitError(message);
+	}
+	return error;
+}
+
+DallasError OneWireDevice::executeReadState(bool isPrepared, int round)
+{
+	dallas_job_T job;
+	DallasError error;
+
+	if (isPrepared)
+		startPreparedRound(&job, round);
+	else
+		startReadState(&job, false);
+	do {
+		OneWireBusLocker locker(this);
+		error = dallasJobExecute(bus, &job);
+		locker.unlock();
+		error = finishReadState(&job, error);
+	} while (error == DALLAS_PENDING);
+	return error;
+}
+
+void OneWireDevice::adaptPollPeriod(const unsigned short *states, int count)
+{
+	bool isSteady = (steadyStates.size() == count);
+	for (int i = 0; isSteady && i < count; ++i) {
+		if ((states[i] > steadyStates[i] ? states[i] - steadyStates[i] : steadyStates[i] - states[i]) > deadband)
+			isSteady = false;
+	}
+	if (!isSteady) {
+		steadyStates.resize(count);
+		for (int i = 0; i < count; ++i)
+			steadyStates[i] = states[i];
+		currentPeriod = period;
+	}
+	else if (currentPeriod < maxPeriod) {
+		currentPeriod = (currentPeriod > maxPeriod / 2) ? maxPeriod : qMax(currentPeriod * 2, 1u);
+	}
+}
+
 OneWireBus::OneWireBus(bool isLogEnabled)
 	: logFile("OneWireBusLog.txt"), log(&logFile)
 {
 	started = false;
 	m_portNumber = 0;
+	m_overdriveEnabled = false;
+	m_adapter = DALLAS_ADAPTER_UART;
+	m_timeout = DALLAS_DEFAULT_TIMEOUT_MS;
+	m_lastPollBaudSwitches = 0;
+	isTopologyComplete = false;
+	m_rescanEnabled = true;
+	m_rescanPeriod = 100;
+	rescanDueTime = 0;
+	bus = dallasCreateBus();
 	dallasLibraryInitialized = false;
 	memset(prototypes, 0, sizeof(prototypes));
+	m_deviceSetup = 0;
+	memset(conversions, 0, sizeof(conversions));
+	restartRescan();
+	qRegisterMetaType<OneWireDevice *>("OneWireDevice*");
+	qRegisterMetaType<QVector<OneWireDevice *> >("QVector<OneWireDevice*>");
 	if (isLogEnabled)
 		logFile.open(QIODevice::Append | QIODevice::WriteOnly | QIODevice::Text);
 }
@@ -65,13 +133,16 @@ OneWireBus::~OneWireBus()
 		if (prototypes[i])
 			delete prototypes[i];
 	}
+	clearConversions();
 	qDeleteAll(m_devices.begin(), m_devices.end());
+	dallasDestroyBus(bus);
 }
 
 void OneWireBus::addFamilyPrototype(OneWireDevice *prototype)
 {
 	prototypes[prototype->family()] = prototype;
 	prototype->setMutex(&mutex);
+	prototype->setDallasBus(bus);
 }
 
 void OneWireBus::start()
@@ -93,7 +164,17 @@ void OneWireBus::stop()
 void OneWireBus::run()
 {
 	while (started) {
-		pollDevices();
+		u64 now = dallasGetClock();
+		u64 wakeTime = nextWakeTime();
+		if (wakeTime > now) {
+			// short naps keep stop() responsive
+			usleep(qMin<u64>(wakeTime - now, 50000));
+			continue;
+		}
+		if (nextPollTime() <= now)
+			pollDevices();
+		if (m_rescanEnabled && rescanDueTime <= now)
+			rescanDevices();
 	}
 }
 
@@ -141,33 +222,489 @@ void OneWireBus::writeStateToLog(OneWireDevice *device, int msecs)
 
 }
 
+// state reading of a device or conversion of a family in pollDevices()
+struct OneWirePollTask {
+	enum Stage { Idle, Converting, Reading, Done };
+
+	OneWireDevice *device;
+	Stage stage;
+	int round;				// round of the state sampled in series, see preparedStateRounds()
+	bool isPrepared;
+	QTime startTime;
+	dallas_job_T job;
+};
+
+static bool pollsAtStandardSpeed(const OneWireDevice *device, const OneWireDevice *other)
+{
+	return !dallasOverdriveSupported(device->family()) && dallasOverdriveSupported(other->family());
+}
+
+static bool isDueEarlier(const OneWireDevice *device, const OneWireDevice *other)
+{
+	return device->pollDueTime() < other->pollDueTime();
+}
+
 void OneWireBus::pollDevices()
 {
 	QVector<bool> isFamilyStatePrepared(256);
 	QVector<bool> isFamilyStateFailed(256);
+	// one job of a family runs at a time, conversions may be started
+	// on the whole family by SKIP ROM and another job would restart them
+	QVector<bool> isFamilyBusy(256);
+	QVector<int> familyRound(256);
+	QVector<OneWireDevice *> dueDevices;
+	QVector<OneWirePollTask *> running;
+	QVector<OneWirePollTask *> familyConversions;
+	OneWirePollTask *holder = 0;
+	u64 now = dallasGetClock();
+	u32 baudSwitches = dallasGetBaudSwitchCount(bus);
 
+	// devices due are polled, the most overdue first, all of them are polled
+	// in this cycle, so the standard speed ones still go first to save switches
 	foreach(OneWireDevice *device, m_devices) {
-		QTime lastPollingTime = QTime::currentTime();
-		if (!isFamilyStatePrepared[device->family()]) {
-			isFamilyStateFailed[device->family()] = (device->prepareStateAll() != DALLAS_NO_ERROR);
-			isFamilyStatePrepared[device->family()] = true;
-		}
-		if (isFamilyStateFailed[device->family()]) {
-			device->readPreparedState();
+		if (device->pollDueTime() <= now)
+			dueDevices.append(device);
+	}
+	qStableSort(dueDevices.begin(), dueDevices.end(), isDueEarlier);
+	qStableSort(dueDevices.begin(), dueDevices.end(), pollsAtStandardSpeed);
+
+	// conditions following a family conversion are searched when it ends
+	QVector<OneWireDevice *> searchedDevices;
+	foreach(OneWireDevice *device, dueDevices) {
+		if (!device->isPrepareStateAllSupported())
+			searchedDevices.append(device);
+	}
+	searchConditions(searchedDevices);
+
+	QVector<OneWirePollTask> tasks(dueDevices.size());
+	int left = tasks.size();
+	for (int i = 0; i < tasks.size(); ++i) {
+		OneWireDevice *device = dueDevices[i];
+		tasks[i].device = device;
+		tasks[i].stage = OneWirePollTask::Idle;
+		tasks[i].round = 0;
+		tasks[i].isPrepared = false;
+	}
+
+	// family conversions run while other families are polled
+	// and their devices are read when they are done
+	for (int i = 0; i < tasks.size(); ++i) {
+		OneWireDevice *device = dueDevices[i];
+		unsigned char family = device->family();
+		if (device->isPrepareStateAllSupported() && !conversions[family])
+			conversions[family] = startConversion(device);
+	}
+	for (int family = 0; family <= UCHAR_MAX; ++family) {
+		if (!conversions[family])
+			continue;
+		familyConversions.append(conversions[family]);
+		// strong pull-up of a conversion going on since the last poll is kept too
+		if (conversions[family]->job.hold_bus)
+			holder = conversions[family];
+	}
+	running = familyConversions;
+	for (int i = 0; i < tasks.size(); ++i)
+		running.append(&tasks[i]);
+
+	// every pass makes a step of each job which is not waiting,
+	// when all of them wait the thread sleeps until the nearest wake time
+	while (left) {
+		bool isStepDone = false;
+		u32 sleepTime = UINT_MAX;
+
+		for (int i = 0; i < running.size(); ++i) {
+			OneWirePollTask &task = *running[i];
+			OneWireDevice *device = task.device;
+			unsigned char family = device->family();
+
+			if (task.stage == OneWirePollTask::Done || (holder && holder != &task))
+				continue;
+
+			if (task.stage == OneWirePollTask::Idle) {
+				if (conversions[family] || isFamilyBusy[family])
+					continue;
+				isFamilyBusy[family] = true;
+				if (!task.round)
+					task.startTime = QTime::currentTime();
+				task.isPrepared = isFamilyStatePrepared[family] && !isFamilyStateFailed[family];
+				if (task.isPrepared)
+					device->startPreparedRound(&task.job, task.round);
+				else
+					device->startReadState(&task.job, false);
+				task.stage = OneWirePollTask::Reading;
+			}
+
+			u32 timeLeft = dallasJobTimeLeft(&task.job);
+			if (timeLeft) {
+				if (timeLeft < sleepTime)
+					sleepTime = timeLeft;
+				continue;
+			}
+
+			OneWireBusLocker locker(device);
+			DallasError error = dallasJobRun(bus, &task.job);
+			locker.unlock();
+			isStepDone = true;
+			holder = (error == DALLAS_PENDING && task.job.hold_bus) ? &task : 0;
+			if (error == DALLAS_PENDING)
+				continue;
+
+			if (task.stage == OneWirePollTask::Converting) {
+				// devices of the family read the prepared state or convert one by one
+				isFamilyStatePrepared[family] = true;
+				isFamilyStateFailed[family] = (error != DALLAS_NO_ERROR);
+				finishConversion(&task, error);
+				if (error != DALLAS_NO_ERROR || familyRound[family])
+					continue;
+				searchedDevices.clear();
+				for (int j = 0; j < tasks.size(); ++j) {
+					if (tasks[j].device->family() == family && tasks[j].stage == OneWirePollTask::Idle)
+						searchedDevices.append(tasks[j].device);
+				}
+				searchConditions(searchedDevices);
+				continue;
+			}
+
+			error = device->finishReadState(&task.job, error);
+			if (error == DALLAS_PENDING)
+				continue;
+
+			isFamilyBusy[family] = false;
+			if (error == DALLAS_NO_ERROR && task.isPrepared && ++task.round < device->preparedStateRounds()) {
+				// the next sample of the series comes with the next family conversion
+				task.stage = OneWirePollTask::Idle;
+			} else {
+				task.stage = OneWirePollTask::Done;
+				left--;
+				// a late state is due a period after it was read and not at once again
+				u64 dueTime = device->pollDueTime() + u64(device->currentPollPeriod()) * 1000;
+				device->setPollDueTime(qMax(dueTime, dallasGetClock()));
+				int msecs = task.startTime.msecsTo(QTime::currentTime());
+				if (msecs < 0)
+					msecs += 86400000;
+				writeStateToLog(device, msecs);
+			}
+
+			// the family converts again when all its devices have read the round
+			bool isRoundAwaited = false;
+			bool isRoundRead = true;
+			for (int j = 0; j < tasks.size(); ++j) {
+				if (tasks[j].device->family() != family || tasks[j].stage == OneWirePollTask::Done)
+					continue;
+				if (tasks[j].round > familyRound[family])
+					isRoundAwaited = true;
+				else
+					isRoundRead = false;
+			}
+			if (isRoundAwaited && isRoundRead) {
+				familyRound[family]++;
+				conversions[family] = startConversion(device);
+				familyConversions.append(conversions[family]);
+				running.append(conversions[family]);
+			}
+			yieldCurrentThread();
 		}
-		else {
-			device->readState();
+
+		if (isStepDone)
+			continue;
+
+		// devices left wait for family conversions, which go on during the next poll,
+		// unless a series of rounds is being sampled, meanwhile run() serves devices
+		// due earlier
+		bool isConversionAwaited = true;
+		for (int i = 0; i < tasks.size() && isConversionAwaited; ++i) {
+			if (tasks[i].stage != OneWirePollTask::Done && (!conversions[tasks[i].device->family()] || tasks[i].round))
+				isConversionAwaited = false;
 		}
-		int msecs = lastPollingTime.msecsTo(QTime::currentTime());
-		if (msecs < 0)
-			msecs += 86400000;
-		writeStateToLog(device, msecs);
-		yieldCurrentThread();
+		if (isConversionAwaited)
+			break;
+
+		if (sleepTime != UINT_MAX)
+			usleep(sleepTime);
+	}
+
+	for (int i = 0; i < familyConversions.size(); ++i) {
+		if (familyConversions[i]->stage == OneWirePollTask::Done)
+			delete familyConversions[i];
+	}
+
+	m_lastPollBaudSwitches = dallasGetBaudSwitchCount(bus) - baudSwitches;
+	if (logFile.isOpen()) {
+		log << QTime::currentTime().toString("hh:mm:ss.zzz") << " ";
+		log << "Poll baud switches: " << QString::number(m_lastPollBaudSwitches) << "\r\n";
 	}
 
 	emit pollDevicesCompleted();
 }
 
+// one Conditional Search tells the armed devices which of them need reading, those due
+// at the background rate read anyway, it is not run while a conversion holds the bus,
+// the devices read their state then
+void OneWireBus::searchConditions(const QVector<OneWireDevice *> &devices)
+{
+	QVector<OneWireDevice *> armedDevices;
+	foreach(OneWireDevice *device, devices) {
+		if (device->isConditionalSearchArmed())
+			armedDevices.append(device);
+	}
+	if (armedDevices.isEmpty())
+		return;
+
+	bool isSearched = true;
+	for (int family = 0; family <= UCHAR_MAX; ++family) {
+		if (conversions[family] && conversions[family]->job.hold_bus)
+			isSearched = false;
+	}
+
+	QVector<u64> answers;
+	if (isSearched) {
+		dallas_rom_id_T id;
+		DallasError error;
+		QMutexLocker locker(&mutex);
+		dallasFindConditionalInit(bus);
+		while (dallasFindNextDevice(bus, &id, &error))
+			answers.append(id.id);
+		isSearched = (error == DALLAS_NO_ERROR);
+	}
+
+	u64 now = dallasGetClock();
+	foreach(OneWireDevice *device, armedDevices) {
+		bool isMet = !isSearched || answers.contains(device->romId().id);
+		if (device->backgroundReadPeriod() && device->backgroundDueTime() <= now)
+			isMet = true;
+		if (isMet)
+			device->setBackgroundDueTime(now + u64(device->backgroundReadPeriod()) * 1000);
+		device->setConditionMet(isMet);
+	}
+}
+
+void OneWireBus::restartRescan()
+{
+	QMutexLocker locker(&mutex);
+	int family = nextFamily(0);
+	dallasFindFamilyInit(bus, family <= UCHAR_MAX ? family : 0);
+	dallasFindSave(bus, &rescanPosition);
+	rescanFound.clear();
+}
+
+// one SEARCH ROM step of the rescan finds the next device of the families having
+// prototypes, it waits for a conversion holding the bus, an error starts the pass anew
+void OneWireBus::rescanDevices()
+{
+	u64 now = dallasGetClock();
+	for (int family = 0; family <= UCHAR_MAX; ++family) {
+		if (conversions[family] && conversions[family]->job.hold_bus) {
+			rescanDueTime = now + qMax<u32>(dallasJobTimeLeft(&conversions[family]->job), 1000);
+			return;
+		}
+	}
+	rescanDueTime = now + u64(m_rescanPeriod) * 1000;
+
+	DallasError error;
+	QMutexLocker locker(&mutex);
+	dallasFindRestore(bus, &rescanPosition);
+	bool isFound = dallasFindNextDevice(bus, &rescanId, &error);
+	dallasFindSave(bus, &rescanPosition);
+	locker.unlock();
+
+	if (error != DALLAS_NO_ERROR) {
+		restartRescan();
+		return;
+	}
+	if (isFound)
+		rescanFound.append(rescanId.id);
+	if (isFound && !rescanPosition.done_flag)
+		return;
+
+	int family = nextFamily(rescanPosition.family);
+	if (family <= UCHAR_MAX) {
+		locker.relock();
+		dallasFindFamilyInit(bus, family);
+		dallasFindSave(bus, &rescanPosition);
+		return;
+	}
+
+	applyRescan();
+	restartRescan();
+}
+
+// the complete pass adds the devices found the first time and removes those missing
+// in two passes in a row, the devices staying keep their state and filters
+void OneWireBus::applyRescan()
+{
+	QVector<OneWireDevice *> devices = m_devices;
+	QVector<OneWireDevice *> added;
+	QVector<OneWireDevice *> removed;
+	QVector<u64> missing;
+
+	for (int i = devices.size() - 1; i >= 0; --i) {
+		u64 romId = devices[i]->romId().id;
+		if (rescanFound.contains(romId))
+			continue;
+		if (!rescanMissing.contains(romId)) {
+			missing.append(romId);
+			continue;
+		}
+		removed.append(devices[i]);
+		devices.remove(i);
+	}
+	rescanMissing = missing;
+
+	foreach(u64 romId, rescanFound) {
+		dallas_rom_id_T id;
+		id.id = romId;
+		if (!prototypes[id.byte[0]])
+			continue;
+		bool isKnown = false;
+		foreach(OneWireDevice *device, devices)
+			isKnown = isKnown || device->romId().id == romId;
+		if (isKnown)
+			continue;
+		OneWireDevice *device = prototypes[id.byte[0]]->clone();
+		device->setRomId(id);
+		device->readConfiguration();
+		// the device is polled with its settings from the first cycle
+		if (m_deviceSetup)
+			m_deviceSetup->setupDevice(device);
+		// the device belongs to the thread of the bus object like the others
+		device->moveToThread(thread());
+		devices.append(device);
+		added.append(device);
+	}
+	if (added.isEmpty() && removed.isEmpty())
+		return;
+
+	// overdrive devices are polled one after another, see searchDevices()
+	if (m_overdriveEnabled)
+		qStableSort(devices.begin(), devices.end(), pollsAtStandardSpeed);
+
+	// a conversion going on for a device removed goes on for the rest of its family
+	foreach(OneWireDevice *device, removed) {
+		OneWirePollTask *conversion = conversions[device->family()];
+		if (!conversion || conversion->device != device)
+			continue;
+		conversion->device = 0;
+		foreach(OneWireDevice *other, devices) {
+			if (other->family() == device->family())
+				conversion->device = other;
+		}
+		if (!conversion->device) {
+			delete conversion;
+			conversions[device->family()] = 0;
+		}
+	}
+
+	QMutexLocker locker(&mutex);
+	m_devices = devices;
+	locker.unlock();
+
+	foreach(OneWireDevice *device, added)
+		emit deviceAdded(device);
+	// the signal is queued to the thread of the bus object before the deletion,
+	// so the receivers have dropped the devices removed when they are deleted
+	emit devicesChanged(removed);
+	if (!removed.isEmpty())
+		QMetaObject::invokeMethod(this, "deleteDevices", Qt::QueuedConnection,
+			Q_ARG(QVector<OneWireDevice *>, removed));
+}
+
+void OneWireBus::deleteDevices(const QVector<OneWireDevice *> &devices)
+{
+	qDeleteAll(devices);
+}
+
+// family conversion lasts as long as the slowest device of the family needs,
+// read slots end it earlier when all devices are externally powered,
+// otherwise strong pull-up feeds it
+OneWirePollTask *OneWireBus::startConversion(OneWireDevice *device)
+{
+	unsigned char family = device->family();
+	unsigned int conversionTime = 0;
+	unsigned int learnedTime = 0;
+	bool isPolled = true;
+	bool isLearned = true;
+
+	foreach(OneWireDevice *other, m_devices) {
+		if (other->family() != family)
+			continue;
+		isPolled = isPolled && other->isExternallyPowered();
+		conversionTime = qMax(conversionTime, other->conversionTime());
+	}
+	foreach(OneWireDevice *other, m_devices) {
+		if (other->family() != family || other->conversionTime() != conversionTime)
+			continue;
+		isLearned = isLearned && other->learnedConversionTime();
+		learnedTime = qMax(learnedTime, other->learnedConversionTime());
+	}
+
+	OneWirePollTask *conversion = new OneWirePollTask;
+	conversion->device = device;
+	conversion->stage = OneWirePollTask::Converting;
+	device->startPrepareStateAll(&conversion->job, conversionTime);
+	if (isPolled) {
+		conversion->job.flags |= DALLAS_JOB_POLL_DONE;
+		conversion->job.expected_us = isLearned ? learnedTime : 0;
+	} else {
+		conversion->job.flags |= DALLAS_JOB_PARASITE_POWER;
+	}
+	return conversion;
+}
+
+// the slowest devices of the family learn the time read slots have measured
+void OneWireBus::finishConversion(OneWirePollTask *conversion, DallasError error)
+{
+	OneWireDevice *device = conversion->device;
+	unsigned char family = device->family();
+
+	conversion->stage = OneWirePollTask::Done;
+	if (conversions[family] == conversion)
+		conversions[family] = 0;
+	if (error != DALLAS_NO_ERROR) {
+		device->emitError(dallasGetErrorText(bus, error));
+		return;
+	}
+	if (!conversion->job.measured_us)
+		return;
+	foreach(OneWireDevice *other, m_devices) {
+		if (other->family() == family && other->conversionTime() == conversion->job.conversion_us)
+			other->learnConversionTime(conversion->job.measured_us);
+	}
+}
+
+// the earliest due time of the devices, those waiting for a family conversion
+// are due when the conversion wants the next step
+u64 OneWireBus::nextPollTime()
+{
+	u64 now = dallasGetClock();
+	u64 wakeTime = ULLONG_MAX;
+
+	foreach(OneWireDevice *device, m_devices) {
+		u64 dueTime = device->pollDueTime();
+		OneWirePollTask *conversion = conversions[device->family()];
+		if (conversion)
+			dueTime = qMax(dueTime, now + dallasJobTimeLeft(&conversion->job));
+		wakeTime = qMin(wakeTime, dueTime);
+	}
+	return wakeTime;
+}
+
+// the rescan has its own due time, so a bus with no devices or long poll periods finds devices soon
+u64 OneWireBus::nextWakeTime()
+{
+	u64 wakeTime = nextPollTime();
+	if (m_rescanEnabled)
+		wakeTime = qMin(wakeTime, rescanDueTime);
+	return wakeTime;
+}
+
+void OneWireBus::clearConversions()
+{
+	for (int i = 0; i <= UCHAR_MAX; ++i) {
+		delete conversions[i];
+		conversions[i] = 0;
+	}
+}
+
 void OneWireBus::setPortNumber(unsigned int portNumber)
 {
     m_portNumber = portNumber;
@@ -180,30 +717,183 @@ DallasError OneWireBus::searchDevices()
 
 	stop();
 
+	clearConversions();
 	qDeleteAll(m_devices);
 	m_devices.clear();
+	isTopologyComplete = false;
+	restartRescan();
+	rescanMissing.clear();
+	rescanDueTime = 0;
 
 	if (dallasLibraryInitialized) {
-		dallasDeinit();
+		dallasDeinit(bus);
 		dallasLibraryInitialized = false;
 	}
 
-	error = dallasInit(m_portName.toLatin1().data());
+	dallasSetAdapter(bus, m_adapter);
+	dallasSetTimeout(bus, m_timeout);
+	error = dallasInit(bus, m_portName.toLatin1().data());
 	if (error != DALLAS_NO_ERROR)
 		return error;
 
 	dallasLibraryInitialized = true;
+	dallasSetOverdrive(bus, m_overdriveEnabled);
+
+	// the cached devices are polled at once, the first poll reads their state
+	if (loadTopologyCache())
+		isTopologyComplete = true;
+	else {
+		error = findDevices();
+		isTopologyComplete = (error == DALLAS_NO_ERROR);
+		saveTopologyCache();
+	}
+
+	// overdrive devices are polled one after another, so the bus enters
+	// overdrive once per poll and not after every standard speed device
+	if (m_overdriveEnabled)
+		qStableSort(m_devices.begin(), m_devices.end(), pollsAtStandardSpeed);
+	return error;
+}
 
+// the first family after family having a prototype, UCHAR_MAX + 1 if there is none
+int OneWireBus::nextFamily(int family) const
+{
+	for (++family; family <= UCHAR_MAX; ++family) {
+		if (prototypes[family])
+			break;
+	}
+	return family;
+}
+
+// searches the bus, reads the configuration and the first state of the devices found
+DallasError OneWireBus::findDevices()
+{
+	DallasError error;
+
+	// only the families having prototypes are searched, other devices cost no passes
 	dallas_rom_id_T id;
-	dallasFindInit();
-	while (dallasFindNextDevice(&id, &error)) {
-		if (prototypes[id.byte[0]]) {
-			OneWireDevice *device = prototypes[id.byte[0]]->clone();
+	error = DALLAS_NO_ERROR;
+	for (int family = nextFamily(0); family <= UCHAR_MAX && error == DALLAS_NO_ERROR; family = nextFamily(family)) {
+		dallasFindFamilyInit(bus, family);
+		while (dallasFindNextDevice(bus, &id, &error)) {
+			OneWireDevice *device = prototypes[family]->clone();
 			m_devices.append(device);
 			device->setRomId(id);
 			device->readConfiguration();
-			device->readState();
+			if (m_deviceSetup)
+				m_deviceSetup->setupDevice(device);
+			if (!device->isPrepareStateAllSupported())
+				device->readState();
+		}
+	}
+
+	// families converting at once convert here while nothing else disturbs the bus,
+	// read slots measure their conversion time before their first state is read
+	QVector<bool> isFamilyConverted(256);
+	for (int i = 0; i < m_devices.size(); ++i) {
+		OneWireDevice *device = m_devices[i];
+		unsigned char family = device->family();
+		if (!device->isPrepareStateAllSupported() || isFamilyConverted[family])
+			continue;
+		isFamilyConverted[family] = true;
+
+		for (int round = 0; round < device->preparedStateRounds(); ++round) {
+			OneWirePollTask *conversion = startConversion(device);
+			OneWireBusLocker locker(device);
+			DallasError conversionError = dallasJobExecute(bus, &conversion->job);
+			locker.unlock();
+			finishConversion(conversion, conversionError);
+			delete conversion;
+			for (int j = i; j < m_devices.size(); ++j) {
+				if (m_devices[j]->family() != family)
+					continue;
+				// devices start their series anew when the family cannot convert
+				if (conversionError != DALLAS_NO_ERROR)
+					m_devices[j]->readState();
+				else
+					m_devices[j]->readPreparedState(round);
+			}
+			if (conversionError != DALLAS_NO_ERROR)
+				break;
 		}
 	}
 	return error;
 }
+
+// cache file: magic, version, port name, device count, then ROM id and configuration of each device
+static const quint32 TopologyCacheMagic = 0x31575443;
+static const quint16 TopologyCacheVersion = 1;
+
+bool OneWireBus::loadTopologyCache()
+{
+	if (m_topologyCacheFileName.isEmpty())
+		return false;
+	QFile file(m_topologyCacheFileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&file);
+	quint32 magic = 0, count = 0;
+	quint16 version = 0;
+	QString portName;
+	stream >> magic >> version >> portName >> count;
+	if (magic != TopologyCacheMagic || version != TopologyCacheVersion || portName != m_portName || !count)
+		return false;
+
+	QVector<OneWireDevice*> devices;
+	bool isValid = true;
+	for (quint32 i = 0; i < count; ++i) {
+		quint64 romId;
+		QByteArray configuration;
+		stream >> romId >> configuration;
+		dallas_rom_id_T id;
+		id.id = romId;
+		isValid = stream.status() == QDataStream::Ok && prototypes[id.byte[0]];
+		if (!isValid)
+			break;
+		OneWireDevice *device = prototypes[id.byte[0]]->clone();
+		devices.append(device);
+		device->setRomId(id);
+		QDataStream configurationStream(configuration);
+		device->loadConfiguration(configurationStream);
+		isValid = configurationStream.status() == QDataStream::Ok;
+	}
+
+	// one SEARCH ROM pass along the id of each device, a missing one makes the bus searched
+	QMutexLocker locker(&mutex);
+	for (int i = 0; i < devices.size() && isValid; ++i) {
+		dallas_rom_id_T id = devices[i]->romId();
+		isValid = dallasVerifyDevice(bus, &id) == DALLAS_NO_ERROR;
+	}
+	locker.unlock();
+
+	if (!isValid) {
+		qDeleteAll(devices);
+		return false;
+	}
+	// the setup may write the devices, they are known to be present now
+	if (m_deviceSetup) {
+		foreach(OneWireDevice *device, devices)
+			m_deviceSetup->setupDevice(device);
+	}
+	m_devices = devices;
+	return true;
+}
+
+void OneWireBus::saveTopologyCache()
+{
+	if (m_topologyCacheFileName.isEmpty() || !isTopologyComplete || m_devices.isEmpty())
+		return;
+	QFile file(m_topologyCacheFileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return;
+
+	QDataStream stream(&file);
+	stream << TopologyCacheMagic << TopologyCacheVersion << m_portName << quint32(m_devices.size());
+	foreach(OneWireDevice *device, m_devices) {
+		QByteArray configuration;
+		QDataStream configurationStream(&configuration, QIODevice::WriteOnly);
+		device->saveConfiguration(configurationStream);
+		stream << quint64(device->romId().id) << configuration;
+	}
+}
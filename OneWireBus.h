@@ -2,6 +2,7 @@
 #define ONEWIREBUS_H
 
 #include <QFile>
+#include <QDataStream>
 #include <QTextStream>
 #include <QString>
 #include <QVector>
@@ -13,6 +14,15 @@
 typedef unsigned char DallasError;
 
 class OneWireDevice;
+struct OneWirePollTask;
+
+// sets up the devices the bus creates before they are polled, the rescan calls it
+// in the thread of the bus, so it takes nothing from objects of other threads
+class OneWireDeviceSetup {
+public:
+	virtual ~OneWireDeviceSetup() { }
+	virtual void setupDevice(OneWireDevice *device) const = 0;
+};
 
 class OneWireBus : public QThread {
 	Q_OBJECT
@@ -22,34 +32,109 @@ public:
 
 	void addFamilyPrototype(OneWireDevice *prototype);
 
+	// the setup must stay in place and unchanged while the bus is started
+	const OneWireDeviceSetup *deviceSetup() const		{ return m_deviceSetup; }
+	void setDeviceSetup(const OneWireDeviceSetup *setup)	{ m_deviceSetup = setup; }
+
 	QString portName() const                    { return m_portName; }
 	void setPortName(const QString &portName)   { m_portName = portName; }
     
 	unsigned int portNumber() const				{ return m_portNumber; }
 	void setPortNumber(unsigned int portNumber);
 
+	dallas_bus_T *dallasBus() const				{ return bus; }
+
+	bool isOverdriveEnabled() const				{ return m_overdriveEnabled; }
+	void setOverdriveEnabled(bool enabled)		{ m_overdriveEnabled = enabled; }
+
+	// DALLAS_ADAPTER_UART or DALLAS_ADAPTER_DS2480B, used by the next searchDevices()
+	u08 adapter() const							{ return m_adapter; }
+	void setAdapter(u08 adapter)				{ m_adapter = adapter; }
+
+	// time allowed for an exchange beyond its wire time, used by the next searchDevices()
+	unsigned int timeout() const				{ return m_timeout; }
+	void setTimeout(unsigned int msecs)			{ m_timeout = msecs; }
+
+	// ROM ids and configurations of the devices found are kept in the cache file, searchDevices()
+	// verifies them device by device instead of searching the bus and reading the devices,
+	// the bus is searched when one of them is missing, empty name disables the cache
+	QString topologyCacheFileName() const					{ return m_topologyCacheFileName; }
+	void setTopologyCacheFileName(const QString &fileName)	{ m_topologyCacheFileName = fileName; }
+	// writes the cache with the current configurations of the devices, unless the last
+	// searchDevices() has failed and some of them may be missing
+	void saveTopologyCache();
+
+	// only the families of addFamilyPrototype() are searched, devices of other families are not walked
 	DallasError searchDevices();
 	const QVector<OneWireDevice*> &devices() const	{ return m_devices; }
+	// the rescan adds and removes devices while the bus is started,
+	// other threads take a copy of the list then
+	QVector<OneWireDevice*> lockedDevices()		{ QMutexLocker locker(&mutex); return m_devices; }
+
+	// the bus started is searched again one device every rescanPeriod() milliseconds,
+	// independently of the polls, see devicesChanged()
+	bool isRescanEnabled() const				{ return m_rescanEnabled; }
+	void setRescanEnabled(bool enabled)			{ m_rescanEnabled = enabled; }
+	unsigned int rescanPeriod() const			{ return m_rescanPeriod; }
+	void setRescanPeriod(unsigned int msecs)	{ m_rescanPeriod = msecs; }
 
 	void start();
 	void stop();
 
 	void pollDevices();
+	// baud rate changes of the port during the last pollDevices()
+	u32 lastPollBaudSwitches() const				{ return m_lastPollBaudSwitches; }
 
 signals:
 	void pollDevicesCompleted();
+	// the rescan has found a new device, it is set up and in devices() already
+	void deviceAdded(OneWireDevice *device);
+	// the rescan has changed devices(), the receivers drop the devices removed,
+	// they are deleted in the thread of the bus object after the signal is delivered
+	void devicesChanged(const QVector<OneWireDevice *> &removed);
 
 protected:
 	void run();
 
+private slots:
+	void deleteDevices(const QVector<OneWireDevice *> &devices);
+
 private:
 	void writeStateToLog(OneWireDevice *device, int msecs);
+	DallasError findDevices();
+	int nextFamily(int family) const;
+	bool loadTopologyCache();
+	void restartRescan();
+	void rescanDevices();
+	void applyRescan();
+	void searchConditions(const QVector<OneWireDevice *> &devices);
+	void clearConversions();
+	u64 nextPollTime();
+	u64 nextWakeTime();
+	OneWirePollTask *startConversion(OneWireDevice *device);
+	void finishConversion(OneWirePollTask *conversion, DallasError error);
 
 	QString m_portName;
 	unsigned int m_portNumber;
+	bool m_overdriveEnabled;
+	u08 m_adapter;
+	unsigned int m_timeout;
+	u32 m_lastPollBaudSwitches;
+	QString m_topologyCacheFileName;
+	bool isTopologyComplete;		// the devices are all found, they may be cached
+	bool m_rescanEnabled;
+	unsigned int m_rescanPeriod;
+	u64 rescanDueTime;				// dallasGetClock() time of the next rescan step
+	dallas_search_T rescanPosition;	// the rescan pass goes on between the steps
+	dallas_rom_id_T rescanId;
+	QVector<u64> rescanFound;		// devices found by the current pass
+	QVector<u64> rescanMissing;		// devices missing in the last complete pass
+	dallas_bus_T *bus;
 	bool dallasLibraryInitialized;
 	QVector<OneWireDevice*> m_devices;
 	OneWireDevice *prototypes[UCHAR_MAX + 1];
+	const OneWireDeviceSetup *m_deviceSetup;
+	OneWirePollTask *conversions[UCHAR_MAX + 1];	// family conversions, they may outlast a poll
 	volatile bool started;
 	QMutex mutex;
 	QFile logFile;
@@ -60,13 +145,13 @@ class OneWireDevice : public QObject {
 	Q_OBJECT
 
 public:
-	OneWireDevice(unsigned char family) { busMutex = 0; id.byte[0] = family; }
+	OneWireDevice(unsigned char family) { busMutex = 0; bus = 0; memset(&frame, 0, sizeof(frame)); id.byte[0] = family; period = maxPeriod = currentPeriod = 0; deadband = 0; dueTime = 0; backgroundPeriod = 0; backgroundTime = 0; }
 	~OneWireDevice() { }
 
 	// identification
 
 	dallas_rom_id_T romId() const					{ return id; }
-	void setRomId(const dallas_rom_id_T &romId)		{ id = romId; }
+	void setRomId(const dallas_rom_id_T &romId)		{ id = romId; dallasPrepareSelectFrame(&frame, &id); }
 	unsigned char family() const					{ return id.byte[0]; }
 
 	static QString dallasRomIdString(const dallas_rom_id_T &id);
@@ -76,21 +161,82 @@ public:
 
 	virtual DallasError readConfiguration() { return DALLAS_NO_ERROR; }
 	virtual DallasError writeConfiguration() { return DALLAS_NO_ERROR; }
-	virtual DallasError readState() { return DALLAS_NO_ERROR; }
+	// the topology cache of the bus keeps what readConfiguration() has read,
+	// loadConfiguration() takes it back instead of reading the device
+	virtual void saveConfiguration(QDataStream &) const { }
+	virtual void loadConfiguration(QDataStream &) { }
+
+	// the state is read by a job, see dallasJobRun(), the bus serves other devices while it waits:
+	// startReadState() prepares the job, finishReadState() is called without the bus lock
+	// and takes its result, it returns DALLAS_PENDING if it has prepared the job of the next round
+	virtual void startReadState(dallas_job_T *job, bool isPrepared) { dallasJobInit(job, 0, 0, 0); }
+	virtual DallasError finishReadState(dallas_job_T *job, DallasError error) { return error; }
 
+	// family converts at once, then startReadState() of its devices is told the state is prepared,
+	// the job waits conversionTime microseconds, the longest conversionTime() of the family
 	virtual bool isPrepareStateAllSupported() { return false; }
-	virtual DallasError prepareStateAll() { return DALLAS_NO_ERROR; }
-	virtual DallasError readPreparedState() { return readState(); }
+	virtual void startPrepareStateAll(dallas_job_T *job, unsigned int conversionTime) { dallasJobInit(job, 0, 0, 0); }
+	virtual unsigned int conversionTime() { return 0; }
+	// a state sampled in series is prepared preparedStateRounds() times, the family converts
+	// once per round and startPreparedRound() reads the round, the last one completes the state
+	virtual int preparedStateRounds() { return 1; }
+	virtual void startPreparedRound(dallas_job_T *job, int) { startReadState(job, true); }
+
+	// conversions of externally powered devices end by read slots, see DALLAS_JOB_POLL_DONE,
+	// the jobs measure them and the devices learn the time for their current settings,
+	// learnedConversionTime() is 0 until then
+	virtual bool isExternallyPowered() { return false; }
+	virtual unsigned int learnedConversionTime() { return 0; }
+	virtual void learnConversionTime(unsigned int) { }
+
+	// armed devices answer Conditional Search when their state needs reading, the bus
+	// searches before polling them, or when the family conversion ends if they convert
+	// at once, and tells each one if it answered, it is told the condition is met when
+	// the search fails and the state is read then
+	virtual bool isConditionalSearchArmed() { return false; }
+	virtual void setConditionMet(bool) { }
+	// armed devices which do not answer are read anyway every backgroundPeriod milliseconds,
+	// period 0 reads them only when they answer, dueTime is dallasGetClock() time
+	unsigned int backgroundReadPeriod() const		{ return backgroundPeriod; }
+	void setBackgroundReadPeriod(unsigned int msecs)	{ backgroundPeriod = msecs; }
+	u64 backgroundDueTime() const					{ return backgroundTime; }
+	void setBackgroundDueTime(u64 time)				{ backgroundTime = time; }
+
+	// polling schedule: the state is due period milliseconds after it was due last time,
+	// period 0 polls the device as often as the bus can, dueTime is dallasGetClock() time
+	unsigned int pollPeriod() const					{ return period; }
+	void setPollPeriod(unsigned int msecs)			{ period = currentPeriod = msecs; }
+	// adaptive polling: while all channels stay within deadband of the state they stepped to,
+	// the period doubles with each poll up to maxPeriod, a step outside brings it back to period,
+	// deadband is in units of channelStateChanged() states, maxPeriod not above period disables it
+	unsigned int pollPeriodMax() const				{ return maxPeriod; }
+	void setPollPeriodMax(unsigned int msecs)		{ maxPeriod = msecs; }
+	unsigned short pollDeadband() const				{ return deadband; }
+	void setPollDeadband(unsigned short delta)		{ deadband = delta; }
+	unsigned int currentPollPeriod() const			{ return currentPeriod; }
+	u64 pollDueTime() const							{ return dueTime; }
+	void setPollDueTime(u64 time)					{ dueTime = time; }
+
+	// the jobs run to completion
+	DallasError readState()							{ return executeReadState(false, 0); }
+	DallasError prepareStateAll();
+	DallasError readPreparedState(int round = 0)	{ return executeReadState(true, round); }
 
 	// bus synchronization 
 
 	QMutex *mutex() const					{ return busMutex; }
 	void setMutex(QMutex *mutex)			{ busMutex = mutex; }
 
+	dallas_bus_T *dallasBus() const			{ return bus; }
+	void setDallasBus(dallas_bus_T *bus)	{ this->bus = bus; }
+
+	// MATCH ROM encoded when the id is set, OneWireBusLocker passes it to the bus
+	const dallas_select_frame_T *selectFrame() const	{ return &frame; }
+
 	// copying
 
 	virtual OneWireDevice *clone() const = 0;
-	OneWireDevice &operator=(const OneWireDevice &source) { id = source.id; busMutex = source.busMutex; return *this; }
+	OneWireDevice &operator=(const OneWireDevice &source) { id = source.id; frame = source.frame; busMutex = source.busMutex; bus = source.bus; period = source.period; maxPeriod = source.maxPeriod; currentPeriod = source.currentPeriod; deadband = source.deadband; dueTime = source.dueTime; backgroundPeriod = source.backgroundPeriod; backgroundTime = source.backgroundTime; steadyStates = source.steadyStates; return *this; }
 
 	void emitError(const QString &message) { emit errorOccured(message); }
 
@@ -99,10 +245,37 @@ signals:
 	void channelStateChanged(int channel, unsigned short oldState, unsigned short newState);
 
 protected:
+	DallasError executeReadState(bool isPrepared, int round);
 	void emitChannelStateChanged(int channel, unsigned short oldState, unsigned short newState) { emit channelStateChanged(channel, oldState, newState); }
+	// finishReadState() passes the states of all channels after a successful read
+	void adaptPollPeriod(const unsigned short *states, int count);
 
 	dallas_rom_id_T id;
+	dallas_select_frame_T frame;
 	QMutex *busMutex;
+	dallas_bus_T *bus;
+	unsigned int period;
+	unsigned int maxPeriod;
+	unsigned int currentPeriod;
+	unsigned short deadband;
+	u64 dueTime;
+	unsigned int backgroundPeriod;
+	u64 backgroundTime;
+	QVector<unsigned short> steadyStates;	// channel states of the last step, see adaptPollPeriod()
+};
+
+// locks the bus for a device, its transactions use the prepared MATCH ROM frame
+class OneWireBusLocker {
+public:
+	explicit OneWireBusLocker(const OneWireDevice *device) : locker(device->mutex()), bus(device->dallasBus())
+		{ if (bus) dallasSetSelectFrame(bus, device->selectFrame()); }
+	~OneWireBusLocker() { unlock(); }
+
+	void unlock() { if (bus) dallasSetSelectFrame(bus, 0); bus = 0; locker.unlock(); }
+
+private:
+	QMutexLocker locker;
+	dallas_bus_T *bus;
 };
 
 #endif // ONEWIREBUS_H
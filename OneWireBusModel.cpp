@@ -9,7 +9,7 @@ QModelIndex OneWireBusModel::index(int row, int column, const QModelIndex &paren
 	if (!parent.isValid())
 		return createIndex(row, column);									// device index
 	else if (!parent.internalPointer())
-		return createIndex(row, column, bus->devices().at(parent.row()));	// device channel index
+		return createIndex(row, column, devices.at(parent.row()));			// device channel index
 	else
 		return QModelIndex();
 }
@@ -19,18 +19,16 @@ QModelIndex	OneWireBusModel::parent(const QModelIndex &index) const
 	if (!index.internalPointer())
 		return QModelIndex();
 	else
-		return createIndex(bus->devices().indexOf(static_cast<OneWireDevice *>(index.internalPointer())),
+		return createIndex(devices.indexOf(static_cast<OneWireDevice *>(index.internalPointer())),
 			index.column());
 }
 
 int OneWireBusModel::rowCount(const QModelIndex &parent) const
 {
-	if (!bus)
-		return 0;
 	if (!parent.isValid())
-		return bus->devices().count();
+		return devices.count();
 	if (!parent.internalPointer()) {
-		OneWireDevice *device = bus->devices().at(parent.row());
+		OneWireDevice *device = devices.at(parent.row());
 		switch (device->family()) {
 			case DS2408_FAMILY: return DeviceDS2408::ChannelCount;
 			case DS2450_FAMILY: return DeviceDS2450::ChannelCount;
@@ -51,7 +49,7 @@ QVariant OneWireBusModel::data(const QModelIndex &index, int role) const
 	if (role != Qt::DisplayRole)
 		return QVariant();
 	if (!index.internalPointer()) {
-		OneWireDevice *device = bus->devices().at(index.row());
+		OneWireDevice *device = devices.at(index.row());
 		if (index.column() == 0)
 			return OneWireDevice::dallasFamilyString(device->romId());
 		else if (index.column() == 1)
@@ -115,7 +113,7 @@ OneWireDevice *OneWireBusModel::deviceFromIndex(const QModelIndex &index)
 	if (!index.isValid())
 		return 0;
 	if (!index.internalPointer())
-		return bus->devices().at(index.row());
+		return devices.at(index.row());
 	else
 		return static_cast<OneWireDevice *>(index.internalPointer());
 }
@@ -133,19 +131,30 @@ int OneWireBusModel::channelFromIndex(const QModelIndex &index)
 void OneWireBusModel::setBus(OneWireBus *bus)
 {
 	this->bus = bus; 
+	devices.clear();
+	updateDevices();
+}
+
+void OneWireBusModel::updateDevices()
+{
+	QVector<OneWireDevice *> oldDevices = devices;
+	devices = bus ? bus->lockedDevices() : QVector<OneWireDevice *>();
 	reset();
-	if (bus) {
-		foreach(OneWireDevice *device, bus->devices()) {
-			connect(device, SIGNAL(channelStateChanged(int, unsigned short, unsigned short)),
-				this, SLOT(channelChanged(int)));
-			connect(device, SIGNAL(errorOccured(QString)),
-				this, SIGNAL(errorOccured(QString)));
-		}
+	foreach(OneWireDevice *device, devices) {
+		if (oldDevices.contains(device))
+			continue;
+		connect(device, SIGNAL(channelStateChanged(int, unsigned short, unsigned short)),
+			this, SLOT(channelChanged(int)));
+		connect(device, SIGNAL(errorOccured(QString)),
+			this, SIGNAL(errorOccured(QString)));
 	}
 }
 
 void OneWireBusModel::channelChanged(int channel)
 {
 	OneWireDevice *device = static_cast<OneWireDevice *>(sender());
+	// the state may come from a device the rescan has just removed
+	if (!devices.contains(device))
+		return;
 	dataChanged(createIndex(channel, 0, device), createIndex(channel, 1, device));
 }
@@ -2,6 +2,7 @@
 #define ONEWIREBUSMODEL_H
 
 #include <QAbstractItemModel>
+#include <QVector>
 
 class OneWireBus;
 class OneWireDevice;
@@ -31,9 +32,12 @@ signals:
 
 public slots:
 	void channelChanged(int channel);
+	// takes the devices of the bus again after its rescan
+	void updateDevices();
 
 private:
 	OneWireBus *bus;
+	QVector<OneWireDevice *> devices;	// copy of the bus list, the rescan changes it in the bus thread
 };
 
 #endif //ONEWIREBUSMODEL_H
\ No newline at end of file
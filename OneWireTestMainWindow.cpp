@@ -22,6 +22,13 @@ OneWireTestMainWindow::OneWireTestMainWindow(QSettings & settings, QWidget *pare
     portSpinBox->hide();
 #endif
 	
+	bus.setOverdriveEnabled(settings.value("overdrive", false).toBool());
+	// the started bus finds the devices plugged in and out, rescan=false turns it off,
+	// rescanPeriod is the time between the search steps in milliseconds
+	bus.setRescanEnabled(settings.value("rescan", true).toBool());
+	bus.setRescanPeriod(settings.value("rescanPeriod", bus.rescanPeriod()).toUInt());
+	bus.setDeviceSetup(&deviceSettings);
+
 	model = new OneWireBusModel(parent);
 	model->setBus(&bus);
 	connect(model, SIGNAL(errorOccured(QString)),
@@ -29,6 +36,8 @@ OneWireTestMainWindow::OneWireTestMainWindow(QSettings & settings, QWidget *pare
 
 	connect(&bus, SIGNAL(pollDevicesCompleted()),
 		this, SLOT(busPollDevicesCompleted()));
+	connect(&bus, SIGNAL(devicesChanged(QVector<OneWireDevice*>)),
+		this, SLOT(busDevicesChanged()));
 
 	devicesTreeView->setModel(model);
 	devicesTreeView->header()->setStretchLastSection(true);
@@ -54,6 +63,73 @@ OneWireTestMainWindow::~OneWireTestMainWindow()
 
 }
 
+QMap<QString, QVariant> OneWireTestMainWindow::DeviceSettings::readGroup(QSettings &settings, const QString &group)
+{
+	QMap<QString, QVariant> values;
+	settings.beginGroup(group);
+	foreach(QString key, settings.childKeys())
+		values[key] = settings.value(key);
+	settings.endGroup();
+	return values;
+}
+
+// value of the settings group set for the device by ROM id or by family
+QVariant OneWireTestMainWindow::DeviceSettings::value(const QMap<QString, QVariant> &group, const OneWireDevice *device)
+{
+	return group.value(OneWireDevice::dallasRomIdString(device->romId()),
+		group.value(OneWireDevice::dallasFamilyString(device->romId())));
+}
+
+void OneWireTestMainWindow::DeviceSettings::load(QSettings &settings)
+{
+	poll = readGroup(settings, "poll");
+	background = readGroup(settings, "background");
+	alarms = readGroup(settings, "alarms");
+}
+
+void OneWireTestMainWindow::DeviceSettings::setupDevice(OneWireDevice *device) const
+{
+	// polling periods in ms are set in group [poll] by ROM id or family, e.g. DS2408=50,
+	// devices not listed are polled as often as the bus can, DS2450=500,30000,64 polls
+	// the device adaptively up to every 30 s while its channels stay within 64 of their state
+	QStringList values = value(poll, device).toStringList();
+	device->setPollPeriod(values.value(0).toUInt());
+	device->setPollPeriodMax(values.value(1).toUInt());
+	device->setPollDeadband(values.value(2).toUShort());
+	// devices read when they answer Conditional Search, like DS18B20 with alarm thresholds,
+	// are read anyway every period in ms set in group [background], e.g. DS18B20=60000
+	device->setBackgroundReadPeriod(value(background, device).toUInt());
+	// DS2450 alarm levels are set in group [alarms] by ROM id or family, the low and the high
+	// level of channels A to D, e.g. DS2450=0,255,0,255,20,230,0,255, the converter
+	// is written when its levels differ, the settings dialog keeps them by ROM id
+	QStringList levels = value(alarms, device).toStringList();
+	if (device->family() == DS2450_FAMILY && levels.size() == 2 * DeviceDS2450::ChannelCount) {
+		DeviceDS2450 *adc = static_cast<DeviceDS2450 *>(device);
+		bool isChanged = false;
+		for (int i = 0; i < DeviceDS2450::ChannelCount; ++i) {
+			unsigned char low = qMin(levels[2 * i].toUInt(), 255u);
+			unsigned char high = qMin(levels[2 * i + 1].toUInt(), 255u);
+			isChanged = isChanged || low != adc->alarmLow(i) || high != adc->alarmHigh(i);
+			adc->setAlarmLow(i, low);
+			adc->setAlarmHigh(i, high);
+		}
+		if (isChanged)
+			adc->writeConfiguration();
+	}
+}
+
+void OneWireTestMainWindow::saveAlarms(const DeviceDS2450 *adc)
+{
+	QStringList levels;
+	for (int i = 0; i < DeviceDS2450::ChannelCount; ++i)
+		levels << QString::number(adc->alarmLow(i)) << QString::number(adc->alarmHigh(i));
+	settings.beginGroup("alarms");
+	settings.setValue(OneWireDevice::dallasRomIdString(adc->romId()), levels);
+	settings.endGroup();
+	// the bus is stopped while the settings dialog is open
+	deviceSettings.load(settings);
+}
+
 bool OneWireTestMainWindow::search()
 {
 	setCursor(Qt::WaitCursor);
@@ -64,6 +140,18 @@ bool OneWireTestMainWindow::search()
     else {
     	bus.setPortName(portLineEdit->text());
     }
+	// adapter of the port is set in group named after the port, e.g. [ttyUSB0] adapter=ds2480b
+	settings.beginGroup(QFileInfo(bus.portName()).fileName());
+	bus.setAdapter(settings.value("adapter", "uart").toString() == "ds2480b"
+		? DALLAS_ADAPTER_DS2480B : DALLAS_ADAPTER_UART);
+	bus.setTimeout(settings.value("timeout", DALLAS_DEFAULT_TIMEOUT_MS).toUInt());
+	// devices found are cached in file topologyCache of the group, ttyUSB0.topology by default,
+	// and only verified on the next start, empty topologyCache= searches the bus every time
+	bus.setTopologyCacheFileName(settings.value("topologyCache",
+		QFileInfo(bus.portName()).fileName() + ".topology").toString());
+	settings.endGroup();
+	// the bus is stopped, the settings change only here
+	deviceSettings.load(settings);
 	DallasError error = bus.searchDevices();
 	unsetCursor();
 	if (error != DALLAS_NO_ERROR) {
@@ -129,7 +217,8 @@ void OneWireTestMainWindow::on_devicesTreeView_clicked(const QModelIndex & index
 			DS2450SettingsDialog dialog;
 			dialog.setDevice(adc);
 			dialog.showMaximized();
-			dialog.exec();
+			if (dialog.exec() == QDialog::Accepted)
+				saveAlarms(adc);
 			if (isStarted)
 				start();
 			this->activateWindow();
@@ -175,7 +264,7 @@ void OneWireTestMainWindow::on_portSpinBox_valueChanged(int)
 
 void OneWireTestMainWindow::showDallasError(int error)
 {
-	QMessageBox::warning(this, tr("Dallas error"), QString(dallasGetErrorText(error)));
+	QMessageBox::warning(this, tr("Dallas error"), QString(dallasGetErrorText(bus.dallasBus(), error)));
 }
 
 void OneWireTestMainWindow::busErrorOccured(QString message)
@@ -201,9 +290,17 @@ void OneWireTestMainWindow::busPollDevicesCompleted()
 	lastPollingTime = now;
 }
 
+void OneWireTestMainWindow::busDevicesChanged()
+{
+	model->updateDevices();
+	devicesTreeView->expandAll();
+}
+
 void OneWireTestMainWindow::closeEvent(QCloseEvent *event)
 {
 	if (started)
 		stop();
+	// configurations changed since the start are cached too
+	bus.saveTopologyCache();
 	event->accept();
 }
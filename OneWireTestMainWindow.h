@@ -2,11 +2,14 @@
 #define ONEWIRETESTMAINWINDOW_H
 
 #include <QDateTime>
+#include <QMap>
+#include <QVariant>
 #include <QtGui/QMainWindow>
 #include "ui_OneWireTestMainWindow.h"
 #include "OneWireBus.h"
 
 class OneWireBusModel;
+class DeviceDS2450;
 class QModelIndex;
 class QSettings;
 
@@ -32,8 +35,28 @@ private slots:
 	void showDallasError(int error);
 	void busErrorOccured(QString message);
 	void busPollDevicesCompleted();
+	void busDevicesChanged();
 
 private:
+	// [poll], [background] and [alarms] groups of the settings taken by search(), the bus sets up
+	// the devices of the rescan in its own thread, where the settings are not read
+	class DeviceSettings : public OneWireDeviceSetup {
+	public:
+		void load(QSettings &settings);
+		void setupDevice(OneWireDevice *device) const;
+
+	private:
+		static QMap<QString, QVariant> readGroup(QSettings &settings, const QString &group);
+		static QVariant value(const QMap<QString, QVariant> &group, const OneWireDevice *device);
+
+		QMap<QString, QVariant> poll;
+		QMap<QString, QVariant> background;
+		QMap<QString, QVariant> alarms;
+	};
+
+	void saveAlarms(const DeviceDS2450 *adc);
+
+	DeviceSettings deviceSettings;
 	OneWireBusModel *model;
 	OneWireBus bus;
 	bool started;
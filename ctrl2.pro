@@ -24,6 +24,7 @@ HEADERS += DeviceDS18B20.h \
            dallas/ds18x20.h \
            dallas/ds2408.h \
            dallas/ds2450.h \
+           dallas/ds2480.h \
            dallas/types.h
 FORMS += DS18B20SettingsDialog.ui \
          DS2450SettingsDialog.ui \
@@ -42,7 +43,8 @@ SOURCES += DeviceDS18B20.cpp \
            dallas/delay.c \
            dallas/ds18x20.c \
            dallas/ds2408.c \
-           dallas/ds2450.c
+           dallas/ds2450.c \
+           dallas/ds2480.c
 RESOURCES += onewiretestmainwindow.qrc
 
 MOC_DIR = build
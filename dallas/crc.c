@@ -6,40 +6,91 @@
 #define CRC16INIT	0x0000
 #define CRC16POLY	0xA001            //0xA001 = X^16+X^15+X^2+X^0
 
+//----- Tables ------------------------------------------------------------------
+// Tables are generated at compile time. Both CRCs are linear, so an entry
+// is XOR of the entries of its set bits, and only 8 basis values per table
+// are calculated with the bit loop. Table k is the CRC of a byte followed
+// by k zero bytes, it is used by slice-by-4 to process 4 bytes at once.
+
+#define CRC_STEP(c, poly)	(((c) >> 1) ^ (((c) & 1) ? (poly) : 0))
+#define CRC_STEP2(c, poly)	CRC_STEP(CRC_STEP(c, poly), poly)
+#define CRC_STEP4(c, poly)	CRC_STEP2(CRC_STEP2(c, poly), poly)
+#define CRC_STEP8(c, poly)	CRC_STEP4(CRC_STEP4(c, poly), poly)
+
+// enumerators keep every level a single token, so macro expansion does not grow with k
+#define CRC_BASIS(name, poly) \
+	name##0_0 = CRC_STEP8(0x01, poly), name##0_1 = CRC_STEP8(0x02, poly), \
+	name##0_2 = CRC_STEP8(0x04, poly), name##0_3 = CRC_STEP8(0x08, poly), \
+	name##0_4 = CRC_STEP8(0x10, poly), name##0_5 = CRC_STEP8(0x20, poly), \
+	name##0_6 = CRC_STEP8(0x40, poly), name##0_7 = CRC_STEP8(0x80, poly), \
+	CRC_BASIS_NEXT(name, 1, 0, poly), CRC_BASIS_NEXT(name, 2, 1, poly), CRC_BASIS_NEXT(name, 3, 2, poly)
+#define CRC_BASIS_NEXT(name, k, prev, poly) \
+	name##k##_0 = CRC_STEP8(name##prev##_0, poly), name##k##_1 = CRC_STEP8(name##prev##_1, poly), \
+	name##k##_2 = CRC_STEP8(name##prev##_2, poly), name##k##_3 = CRC_STEP8(name##prev##_3, poly), \
+	name##k##_4 = CRC_STEP8(name##prev##_4, poly), name##k##_5 = CRC_STEP8(name##prev##_5, poly), \
+	name##k##_6 = CRC_STEP8(name##prev##_6, poly), name##k##_7 = CRC_STEP8(name##prev##_7, poly)
+
+enum { CRC_BASIS(CRC8_, CRC8POLY) };
+enum { CRC_BASIS(CRC16_, CRC16POLY) };
+
+#define CRC_ENTRY(name, k, n) ( \
+	(((n) & 0x01) ? name##k##_0 : 0) ^ (((n) & 0x02) ? name##k##_1 : 0) ^ \
+	(((n) & 0x04) ? name##k##_2 : 0) ^ (((n) & 0x08) ? name##k##_3 : 0) ^ \
+	(((n) & 0x10) ? name##k##_4 : 0) ^ (((n) & 0x20) ? name##k##_5 : 0) ^ \
+	(((n) & 0x40) ? name##k##_6 : 0) ^ (((n) & 0x80) ? name##k##_7 : 0))
+#define CRC_ENTRIES_4(name, k, n)	CRC_ENTRY(name, k, n), CRC_ENTRY(name, k, n + 1), \
+									CRC_ENTRY(name, k, n + 2), CRC_ENTRY(name, k, n + 3)
+#define CRC_ENTRIES_16(name, k, n)	CRC_ENTRIES_4(name, k, n), CRC_ENTRIES_4(name, k, n + 4), \
+									CRC_ENTRIES_4(name, k, n + 8), CRC_ENTRIES_4(name, k, n + 12)
+#define CRC_ENTRIES_64(name, k, n)	CRC_ENTRIES_16(name, k, n), CRC_ENTRIES_16(name, k, n + 16), \
+									CRC_ENTRIES_16(name, k, n + 32), CRC_ENTRIES_16(name, k, n + 48)
+#define CRC_TABLE(name, k)			{ CRC_ENTRIES_64(name, k, 0), CRC_ENTRIES_64(name, k, 64), \
+									  CRC_ENTRIES_64(name, k, 128), CRC_ENTRIES_64(name, k, 192) }
+
+static const u08 crc8_table[4][256] = {
+	CRC_TABLE(CRC8_, 0), CRC_TABLE(CRC8_, 1), CRC_TABLE(CRC8_, 2), CRC_TABLE(CRC8_, 3)
+};
+
+static const u16 crc16_table[4][256] = {
+	CRC_TABLE(CRC16_, 0), CRC_TABLE(CRC16_, 1), CRC_TABLE(CRC16_, 2), CRC_TABLE(CRC16_, 3)
+};
+
+//----- Functions ---------------------------------------------------------------
+
 u08 crc8(u08 *data, u16 size)
 {
     u08 crc;
-    u16 i;
     crc = CRC8INIT;
-    for (i = 0; i < size; ++i)
-        crc = crc8_update(crc, data[i]);
+    // slice-by-4: every byte of the word goes through the table of the bytes left after it
+    for (; size >= 4; size -= 4, data += 4)
+        crc = crc8_table[3][crc ^ data[0]] ^ crc8_table[2][data[1]]
+            ^ crc8_table[1][data[2]] ^ crc8_table[0][data[3]];
+    for (; size; --size)
+        crc = crc8_table[0][crc ^ *data++];
     return crc;
 }
 
 u08 crc8_update(u08 crc, u08 next_byte)
 {
-    u16 i;
-    crc ^= next_byte;
-    for (i = 0; i < 8; ++i)
-		crc = (crc >> 1) ^ ((crc & 1) ? CRC8POLY : 0);
-    return crc;
+    return crc8_table[0][crc ^ next_byte];
 }
 
 u16 crc16(u08 *data, u16 size)
 {
     u16 crc;
-    u16 i;
     crc = CRC16INIT;
-    for (i = 0; i < size; ++i)
-        crc = crc16_update(crc, data[i]);
+    // slice-by-4: the 16 bit register is absorbed by the first two bytes
+    for (; size >= 4; size -= 4, data += 4) {
+        crc ^= data[0] | (data[1] << 8);
+        crc = crc16_table[3][crc & 0xFF] ^ crc16_table[2][crc >> 8]
+            ^ crc16_table[1][data[2]] ^ crc16_table[0][data[3]];
+    }
+    for (; size; --size)
+        crc = (crc >> 8) ^ crc16_table[0][(crc ^ *data++) & 0xFF];
     return crc;
 }
 
 u16 crc16_update(u16 crc, u08 next_byte)
 {
-    u16 i;
-    crc ^= next_byte;
-    for (i = 0; i < 8; ++i)
-		crc = (crc >> 1) ^ ((crc & 1) ? CRC16POLY : 0);
-    return crc;
+    return (crc >> 8) ^ crc16_table[0][(crc ^ next_byte) & 0xFF];
 }
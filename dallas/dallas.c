@@ -12,13 +12,28 @@
 #include <stdio.h>
 #include <termios.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <time.h>
 #endif
 
 
 #include <string.h>
 #include <stdlib.h>
+
+// vector unit is used to decode long reads, ARM9 has none and uses the scalar code,
+// DALLAS_NO_SIMD forces the scalar code, see dallasbench
+#if defined(DALLAS_NO_SIMD)
+#elif defined(__SSE2__)
+#define DALLAS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define DALLAS_NEON
+#include <arm_neon.h>
+#endif
+
 #include "delay.h"
 #include "dallas.h"
+#include "ds2480.h"
 #include "crc.h"
 #include <stdio.h>
 
@@ -27,13 +42,7 @@
 #define cli()
 #define sei()
 
-//----- Global Variables -------------------------------------------------------
-static u08 last_discrep = 0;    // last discrepancy for FindDevices
-static u08 done_flag = 0;        // done flag for FindDevices
-
-static u08 dallas_crc;                    // current crc global variable
-
-#define dallasCRC(i) crc8_update(dallas_crc, (i))
+#define dallasCRC(bus, i) ((bus)->crc = crc8_update((bus)->crc, (i)))
 
 //----- Functions --------------------------------------------------------------
 
@@ -46,7 +55,10 @@ extern "C" {
  * input...................... rom_id - pointer to store the rom id found
  * returns.................... true or false if a device was found
  *-------------------------------------------------------------------------*/
-static u08 dallasFindNextDeviceStatic(dallas_rom_id_T* rom_id);
+static u08 dallasFindNextDeviceStatic(dallas_bus_T *bus, dallas_rom_id_T* rom_id);
+
+// starts the next step of the transaction when the current one is complete
+static u08 dallasStepDone(dallas_bus_T *bus);
 
 
 #define dallasDelayUs    delay_us
@@ -56,110 +68,381 @@ static u08 dallasFindNextDeviceStatic(dallas_rom_id_T* rom_id);
 
 #if defined(_LINUX_) || defined(_LINUX_EMBEDDED_)
 
-#define CHECK_TRUE(f, s) if (!(f)) { snprintf(last_system_error_text, sizeof(last_system_error_text), s, (last_system_error = errno)); return DALLAS_OS_ERROR; }
+#define CHECK_TRUE(f, s) if (!(f)) { snprintf(bus->last_system_error_text, sizeof(bus->last_system_error_text), s, (bus->last_system_error = errno)); return DALLAS_OS_ERROR; }
 
 #define DWORD unsigned int
 #define BOOL unsigned int
 #define TRUE ((unsigned int)-1)
 #define FALSE 0
 
+#define DALLAS_BAUD speed_t
 #define DALLAS_BAUD_RATE_RESET B9600
 #define DALLAS_BAUD_RATE_IO    B115200
+#define DALLAS_BAUD_RATE_OVERDRIVE_RESET B57600
+#if defined(B1000000)
+#define DALLAS_BAUD_RATE_OVERDRIVE_IO    B1000000
+#else
+#define DALLAS_BAUD_RATE_OVERDRIVE_IO    B921600
+#endif
+
+#define DALLAS_PORT_HANDLE fd
+#define DALLAS_PORT_CLOSED -1
+
+// termios of every baud rate used, prepared when the port is opened
+#define DALLAS_PORT_PROFILE_COUNT 4
+
+#define DALLAS_PORT_CONTEXT \
+    int fd; \
+    struct termios options; \
+    struct termios port_profiles[DALLAS_PORT_PROFILE_COUNT]; \
+    u64 deadline; \
+    int last_system_error; \
+    char last_system_error_text[255]; \
+    char formatted_last_system_error_text[512];
+
+#endif // defined(_LINUX_) || defined(_LINUX_EMBEDDED_)
+
+
+#if defined(_WINDOWS_NT_) || defined(_WINDOWS_CE_)
+
+#define DALLAS_BAUD DWORD
+#define DALLAS_BAUD_RATE_RESET CBR_9600
+#define DALLAS_BAUD_RATE_IO    CBR_115200
+#define DALLAS_BAUD_RATE_OVERDRIVE_RESET CBR_57600
+#define DALLAS_BAUD_RATE_OVERDRIVE_IO    1000000
+
+#define DALLAS_PORT_HANDLE hCom
+#define DALLAS_PORT_CLOSED INVALID_HANDLE_VALUE
+
+#define DALLAS_PORT_CONTEXT \
+    HANDLE hCom; \
+    DCB dcb; \
+    COMMTIMEOUTS cto; \
+    u32 step_timeout_us; \
+    char last_system_error_text[255];
+
+#endif // defined(_WINDOWS_NT_) || defined(_WINDOWS_CE_)
+
+#define dallasIsPortOpen(bus) ((bus)->DALLAS_PORT_HANDLE != DALLAS_PORT_CLOSED)
+
+#define DALLAS_SPEED_STANDARD           0
+#define DALLAS_SPEED_OVERDRIVE          1
+
+// steps of a transaction, each one writes bus->io to the port and reads bytes back into it
+#define DALLAS_STEP_IDLE                0
+#define DALLAS_STEP_OVERDRIVE_RESET     1   // UART: standard reset before OVERDRIVE SKIP ROM
+#define DALLAS_STEP_OVERDRIVE_SKIP      2   // OVERDRIVE SKIP ROM, DS2480B sends its reset too
+#define DALLAS_STEP_RESET               3   // UART: reset at the speed of the device
+#define DALLAS_STEP_SLOTS               4   // UART: bytes of the transaction
+#define DALLAS_STEP_PACKET              5   // DS2480B: reset and bytes of the transaction
+
+#define DALLAS_RESET_TRIES              3
+
+// devices of the discrepancy tree kept from the last SEARCH ROM
+#define DALLAS_SEARCH_CACHE_SIZE        64
 
-static int fd;
-struct termios options;
+#define dallasRomBit(rom_id, n)         (((rom_id)->byte[(n) >> 3] >> ((n) & 7)) & 1)
 
-int last_system_error;
-char last_system_error_text[255];
-char formatted_last_system_error_text[512];
+// ROM bit n is taken from the family when only one family is searched,
+// the family byte is walked along its bits and never left
+#define dallasFamilyBit(bus, n)         ((n) < 8 && (bus)->search_family)
 
-char *dallasGetLastSystemErrorText()
+// leaf of the discrepancy tree: the id found by a pass and the bits
+// where the devices sharing its path conflicted
+typedef struct dallas_search_node_S
+{
+    dallas_rom_id_T rom_id;
+    u08 conflicts[8];
+} dallas_search_node_T;
+
+// reset pulse is the low part of reset_pattern written at reset_baud,
+// every bit slot is one byte at io_baud
+typedef struct dallas_speed_profile_S
+{
+    DALLAS_BAUD reset_baud;
+    unsigned char reset_pattern;
+    DALLAS_BAUD io_baud;
+} dallas_speed_profile_T;
+
+struct dallas_bus_S
+{
+    DALLAS_PORT_CONTEXT                     // platform specific port handle and error text
+
+    u08 last_discrep;                       // last discrepancy for FindDevices
+    u08 done_flag;                          // done flag for FindDevices
+    u08 search_command;                     // SEARCH ROM or CONDITIONAL SEARCH of FindDevices
+    u08 search_family;                      // family of FindDevices, 0 - all families
+    u08 crc;                                // current crc of FindDevices
+    u08 search_conflicts[8];                // conflicts seen by the last pass
+    dallas_search_node_T search_cache[DALLAS_SEARCH_CACHE_SIZE];   // tree of the last complete SEARCH ROM
+    u08 search_cache_count;
+    dallas_search_node_T search_found[DALLAS_SEARCH_CACHE_SIZE];   // tree of the SEARCH ROM going on
+    u08 search_found_count;
+
+    const dallas_select_frame_T *select_frame;  // encoded MATCH ROM of the device being accessed
+
+    dallas_rom_id_T resume_rom_id;          // device with RC flag set by the last MATCH ROM
+    u08 resume_valid;                       // RESUME selects resume_rom_id
+
+    dallas_speed_profile_T profiles[2];     // standard and overdrive baud rates
+    u08 speed;                              // DALLAS_SPEED_* of the devices being accessed
+    u08 overdrive;                          // overdrive is enabled and works
+    u08 overdrive_enabled;                  // overdrive is enabled by dallasSetOverdrive()
+
+    u08 adapter;                            // DALLAS_ADAPTER_*
+    ds2480_T ds2480;                        // state of DS2480B adapter
+
+    u08 port_stale;                         // late bytes may wait in the input buffer
+    u32 baud;                               // current baud rate in bits per second
+    u16 timeout_ms;                         // timeout of exchanges beyond their wire time
+    u16 budget_ms;                          // timeout of the transaction being executed
+    u32 baud_switches;                      // baud rate changes since dallasInit
+    u32 accesses;                           // writes to the bus since dallasInit, jobs see others by it
+
+    dallas_transaction_T *transaction;      // transaction being executed step by step
+    u08 step;                               // DALLAS_STEP_*
+    u08 step_tries;                         // reset pulses without presence
+    u08 step_overdrive;                     // the device selected can work at overdrive
+    u08 step_fallback;                      // standard speed is tried after no presence at overdrive
+    u08 step_resume;                        // RESUME may select the device
+    u08 step_skipped;                       // MATCH ROM bytes replaced with RESUME
+    u08 step_rom_byte;                      // transaction byte replaced with RESUME for DS2480B
+    u16 io_size;                            // bytes the step waits for
+    u16 io_done;                            // bytes of the step received
+    unsigned char io[DALLAS_TRANSACTION_SIZE * 8];  // slot bytes or DS2480B packet of the step
+};
+
+
+#if defined(_LINUX_) || defined(_LINUX_EMBEDDED_)
+
+char *dallasGetLastSystemErrorText(dallas_bus_T *bus)
 {
     size_t len;
-    strncpy(formatted_last_system_error_text, last_system_error_text, sizeof formatted_last_system_error_text);
-    len = strlen(formatted_last_system_error_text);
-    strncpy(formatted_last_system_error_text + len, strerror(last_system_error), sizeof formatted_last_system_error_text - len); 
-    return formatted_last_system_error_text;
+    strncpy(bus->formatted_last_system_error_text, bus->last_system_error_text, sizeof bus->formatted_last_system_error_text);
+    len = strlen(bus->formatted_last_system_error_text);
+    strncpy(bus->formatted_last_system_error_text + len, strerror(bus->last_system_error), sizeof bus->formatted_last_system_error_text - len); 
+    return bus->formatted_last_system_error_text;
 }
 
-static BOOL dallasSetBaudRate(speed_t dwBaudRate)
+// switching the baud rate is a single tcsetattr of the prepared profile,
+// the input is flushed only if a previous exchange did not read all of it
+static const speed_t dallas_port_bauds[DALLAS_PORT_PROFILE_COUNT] = {
+    DALLAS_BAUD_RATE_RESET, DALLAS_BAUD_RATE_IO,
+    DALLAS_BAUD_RATE_OVERDRIVE_RESET, DALLAS_BAUD_RATE_OVERDRIVE_IO
+};
+
+static const u32 dallas_port_bits_per_second[DALLAS_PORT_PROFILE_COUNT] = {
+    9600, 115200, 57600,
+#if defined(B1000000)
+    1000000
+#else
+    921600
+#endif
+};
+
+static BOOL dallasSetBaudRate(dallas_bus_T *bus, speed_t dwBaudRate)
 {
-    int result = 0;
-    if (cfgetispeed(&options) != dwBaudRate) {
-        cfsetispeed(&options, dwBaudRate);          // Set Baud Rate
-        cfsetospeed(&options, dwBaudRate);  	
-        result = tcsetattr(fd, TCSANOW, &options);  // Save The Configure
-        last_system_error = errno;
-        tcflush(fd, TCIOFLUSH);                     // Flush the input (read) buffer
+    int i;
+    if (cfgetispeed(&bus->options) == dwBaudRate)
+        return TRUE;
+    for (i = 0; i < DALLAS_PORT_PROFILE_COUNT; i++)
+        if (cfgetispeed(&bus->port_profiles[i]) == dwBaudRate)
+            break;
+    if (i == DALLAS_PORT_PROFILE_COUNT) {
+        bus->last_system_error = EINVAL;
+        return FALSE;
+    }
+    if (tcsetattr(bus->fd, TCSANOW, &bus->port_profiles[i])) {
+        bus->last_system_error = errno;
+        return FALSE;
     }
-    return !result;
+    bus->options = bus->port_profiles[i];
+    bus->baud = dallas_port_bits_per_second[i];
+    bus->baud_switches++;
+    if (bus->port_stale) {
+        tcflush(bus->fd, TCIFLUSH);
+        bus->port_stale = 0;
+    }
+    return TRUE;
 }
 
-static BOOL dallasReadData(u08 * buffer, u08 buffer_size, u08 * actual_size)
+static void dallasPreparePortProfiles(dallas_bus_T *bus)
 {
-    DWORD dwBytesRead;
+    int i;
+    for (i = 0; i < DALLAS_PORT_PROFILE_COUNT; i++) {
+        bus->port_profiles[i] = bus->options;
+        cfsetispeed(&bus->port_profiles[i], dallas_port_bauds[i]);
+        cfsetospeed(&bus->port_profiles[i], dallas_port_bauds[i]);
+    }
+}
+
+// microseconds of monotonic clock
+static u64 dallasClock(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+// waits until the port is ready for events or deadline passes
+// returns FALSE on error, *ready is 0 on timeout
+static BOOL dallasWaitPort(dallas_bus_T *bus, short events, u64 deadline, int *ready)
+{
+    struct pollfd pfd;
+    u64 now = dallasClock();
+    int result;
+
+    pfd.fd = bus->fd;
+    pfd.events = events;
+    // poll() counts milliseconds, the deadline is rounded up,
+    // a passed deadline still takes what is ready already
+    result = poll(&pfd, 1, now >= deadline ? 0 : (int) ((deadline - now + 999) / 1000));
+    if (result < 0 && errno != EINTR) {
+        bus->last_system_error = errno;
+        return FALSE;
+    }
+    *ready = result > 0 || (result < 0 && dallasClock() < deadline);
+    return TRUE;
+}
+
+// reads until buffer_size bytes arrive or timeout_us passes,
+// *actual_size tells how many of them came in time
+static BOOL dallasReadData(dallas_bus_T *bus, u08 * buffer, DWORD buffer_size, DWORD * actual_size, u32 timeout_us)
+{
+    u64 deadline = dallasClock() + timeout_us;
+    DWORD total = 0;
     BOOL result = TRUE;
-    dwBytesRead = read(fd, buffer, buffer_size);
-    if (dwBytesRead == (DWORD)-1) {
-        dwBytesRead = 0;
-        last_system_error = errno;
-        result = FALSE;
+    ssize_t count;
+    int ready;
+
+    while (total < buffer_size) {
+        if (!dallasWaitPort(bus, POLLIN, deadline, &ready)) {
+            result = FALSE;
+            break;
+        }
+        if (!ready)
+            break;
+        count = read(bus->fd, buffer + total, buffer_size - total);
+        if (count > 0) {
+            total += count;
+        } else if (count == 0) {
+            break;      // hang up
+        } else if (count < 0 && errno != EAGAIN && errno != EINTR) {
+            bus->last_system_error = errno;
+            result = FALSE;
+            break;
+        }
     }
     if (actual_size)
-        *actual_size = (u08) dwBytesRead;
+        *actual_size = total;
     return result;
 }
 
-static BOOL dallasWriteData(u08 * buffer, u08 buffer_size)
+// the current step of transaction may wait for its bytes until timeout_us passes
+static void dallasArmDeadline(dallas_bus_T *bus, u32 timeout_us)
 {
-    DWORD dwBytesWritten;
-    dwBytesWritten = write(fd, buffer, buffer_size);
-    if (dwBytesWritten == (DWORD)-1) {
-        last_system_error = errno;
-        return FALSE;
+    bus->deadline = dallasClock() + timeout_us;
+}
+
+// reads bytes of the current step which are received already without waiting,
+// expired is set if the deadline of the step has passed
+static BOOL dallasReadAvailable(dallas_bus_T *bus, u08 * buffer, DWORD buffer_size, DWORD * actual_size, BOOL * expired)
+{
+    BOOL result = dallasReadData(bus, buffer, buffer_size, actual_size, 0);
+    *expired = dallasClock() >= bus->deadline;
+    return result;
+}
+
+// waits until the port has bytes of the current step or its deadline passes
+static void dallasWaitStep(dallas_bus_T *bus)
+{
+    int ready;
+    dallasWaitPort(bus, POLLIN, bus->deadline, &ready);
+}
+
+// writes all bytes unless the output stays full for timeout_us
+static BOOL dallasWriteData(dallas_bus_T *bus, u08 * buffer, DWORD buffer_size, u32 timeout_us)
+{
+    u64 deadline = dallasClock() + timeout_us;
+    ssize_t count;
+    int ready;
+
+    while (buffer_size) {
+        count = write(bus->fd, buffer, buffer_size);
+        if (count > 0) {
+            buffer += count;
+            buffer_size -= count;
+            continue;
+        }
+        if (count < 0 && errno != EAGAIN && errno != EINTR) {
+            bus->last_system_error = errno;
+            return FALSE;
+        }
+        if (!dallasWaitPort(bus, POLLOUT, deadline, &ready))
+            return FALSE;
+        if (!ready) {
+            bus->last_system_error = errno = ETIMEDOUT;
+            return FALSE;
+        }
     }
     return TRUE;
 }
 
-u08 dallasInit(char *PortName)
+static u08 dallasOpenPort(dallas_bus_T *bus, char *PortName)
 {
-    fd = open(PortName, O_RDWR | O_NOCTTY | O_NDELAY);
+    bus->fd = open(PortName, O_RDWR | O_NOCTTY | O_NDELAY);
     CHECK_TRUE(
-        fd != -1,
+        bus->fd != -1,
         "Cannot open COM-port. System error code: 0x%08x\n");
 
-    fcntl(fd, F_SETFL, 0);
+    // the port stays non-blocking, reads wait in poll() until their deadline
+    fcntl(bus->fd, F_SETFL, O_NONBLOCK);
     
     CHECK_TRUE(
-        tcgetattr(fd, &options) != -1, 
+        tcgetattr(bus->fd, &bus->options) != -1, 
         "Cannot get comm state. System error code: 0x%08x\n");
 
 //    close(fd);
 //    CHECK_TRUE(0, "Test error 0: 0x%08x\n");
     
-    cfsetispeed(&options, B9600); // Set Baud Rate
-    cfsetospeed(&options, B9600);
+    cfsetispeed(&bus->options, B9600); // Set Baud Rate
+    cfsetospeed(&bus->options, B9600);
     
-    options.c_cflag &= ~(PARENB | CSIZE | CSTOPB);
-    options.c_cflag |= CS8 | CLOCAL | CREAD;
-    options.c_iflag &= ~(IXON | IXOFF | IXANY);
-    options.c_iflag |=  IGNBRK;
-    options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
-    options.c_oflag &= ~OPOST;
-    options.c_cc[VMIN] = 0;
-    options.c_cc[VTIME] = 1;
+    bus->options.c_cflag &= ~(PARENB | CSIZE | CSTOPB);
+    bus->options.c_cflag |= CS8 | CLOCAL | CREAD;
+    bus->options.c_iflag &= ~(IXON | IXOFF | IXANY);
+    bus->options.c_iflag |=  IGNBRK;
+    bus->options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+    bus->options.c_oflag &= ~OPOST;
+    bus->options.c_cc[VMIN] = 0;
+    bus->options.c_cc[VTIME] = 0;
 
     CHECK_TRUE(
-        tcsetattr(fd, TCSANOW, &options) != -1, 
+        tcsetattr(bus->fd, TCSANOW, &bus->options) != -1, 
         "Cannot set comm state. System error code: 0x%08x\n");
         
-    tcflush(fd, TCIOFLUSH);
+    tcflush(bus->fd, TCIOFLUSH);
+    dallasPreparePortProfiles(bus);
+    bus->baud = 9600;
     return DALLAS_NO_ERROR;
 }
 
-void dallasDeinit()
+void dallasPortBreak(dallas_bus_T *bus)
 {
-    close(fd);
+    tcsendbreak(bus->fd, 0);
+}
+
+void dallasPortFlush(dallas_bus_T *bus)
+{
+    tcflush(bus->fd, TCIFLUSH);
+}
+
+void dallasDeinit(dallas_bus_T *bus)
+{
+    if (dallasIsPortOpen(bus)) {
+        close(bus->fd);
+        bus->fd = DALLAS_PORT_CLOSED;
+    }
 }
 
 #endif // defined(_LINUX_) || defined(_LINUX_EMBEDDED_)
@@ -167,52 +450,88 @@ void dallasDeinit()
 
 #if defined(_WINDOWS_NT_) || defined(_WINDOWS_CE_)
 
-#define DALLAS_BAUD_RATE_RESET CBR_9600
-#define DALLAS_BAUD_RATE_IO    CBR_115200
-
 //#define CHECK_TRUE(f, s) if (!(f)) { rprintf((s), GetLastError()); getchar(); return DALLAS_OS_ERROR; }
-#define CHECK_TRUE(f, s) if (!(f)) { _snprintf(last_system_error_text, sizeof(last_system_error_text), s, GetLastError()); return DALLAS_OS_ERROR; }
-
-static HANDLE hCom;
-static DCB dcb;
-
-char last_system_error_text[255];
+#define CHECK_TRUE(f, s) if (!(f)) { _snprintf(bus->last_system_error_text, sizeof(bus->last_system_error_text), s, GetLastError()); return DALLAS_OS_ERROR; }
 
-char *dallasGetLastSystemErrorText()
+char *dallasGetLastSystemErrorText(dallas_bus_T *bus)
 {
-    size_t len = strlen(last_system_error_text);
+    size_t len = strlen(bus->last_system_error_text);
     wchar_t w_last_system_error_text[255];
     FormatMessage(FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS | FORMAT_MESSAGE_ARGUMENT_ARRAY, 
         0, GetLastError(), 0, w_last_system_error_text, sizeof(w_last_system_error_text), 0);
-    wcstombs(&last_system_error_text[len], w_last_system_error_text, sizeof(last_system_error_text) - len);
-    return last_system_error_text;
+    wcstombs(&bus->last_system_error_text[len], w_last_system_error_text, sizeof(bus->last_system_error_text) - len);
+    return bus->last_system_error_text;
 //  // LINUX
 //  Result := strerror_r(ErrorCode, Buffer, sizeof(Buffer));
 }
 
-static BOOL dallasSetBaudRate(DWORD dwBaudRate)
+// microseconds of monotonic clock
+static u64 dallasClock(void)
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER now;
+    if (!frequency.QuadPart)
+        QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&now);
+    return (u64) (now.QuadPart / frequency.QuadPart * 1000000 + now.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
+static BOOL dallasSetBaudRate(dallas_bus_T *bus, DWORD dwBaudRate)
 {
-    if (dcb.BaudRate != dwBaudRate) {
-        dcb.BaudRate = dwBaudRate;
-        return SetCommState(hCom, &dcb);
+    if (bus->dcb.BaudRate != dwBaudRate) {
+        bus->dcb.BaudRate = dwBaudRate;
+        bus->baud = dwBaudRate;
+        bus->baud_switches++;
+        if (bus->port_stale) {
+            PurgeComm(bus->hCom, PURGE_RXCLEAR);
+            bus->port_stale = 0;
+        }
+        return SetCommState(bus->hCom, &bus->dcb);
     }
     return TRUE;
 }
 
-static BOOL dallasReadData(u08 * buffer, u08 buffer_size, u08 * actual_size)
+// reads until buffer_size bytes arrive or timeout_us passes,
+// port timeouts are changed only when the timeout in milliseconds changes
+static BOOL dallasReadData(dallas_bus_T *bus, u08 * buffer, DWORD buffer_size, DWORD * actual_size, u32 timeout_us)
 {
     DWORD dwBytesRead;
     BOOL result;
-    result = ReadFile(hCom, buffer, buffer_size, &dwBytesRead, NULL);
+    DWORD timeout_ms = (timeout_us + 999) / 1000;
+    if (bus->cto.ReadTotalTimeoutConstant != timeout_ms) {
+        bus->cto.ReadTotalTimeoutConstant = timeout_ms;
+        if (!SetCommTimeouts(bus->hCom, &bus->cto))
+            return FALSE;
+    }
+    result = ReadFile(bus->hCom, buffer, buffer_size, &dwBytesRead, NULL);
     if (actual_size)
-        *actual_size = (u08) dwBytesRead;
+        *actual_size = dwBytesRead;
     return result;
 }
 
-static BOOL dallasWriteData(u08 * buffer, u08 buffer_size)
+// ReadFile blocks, so the step waits for its bytes while reading them
+static void dallasArmDeadline(dallas_bus_T *bus, u32 timeout_us)
+{
+    bus->step_timeout_us = timeout_us;
+}
+
+static BOOL dallasReadAvailable(dallas_bus_T *bus, u08 * buffer, DWORD buffer_size, DWORD * actual_size, BOOL * expired)
+{
+    BOOL result = dallasReadData(bus, buffer, buffer_size, actual_size, bus->step_timeout_us);
+    *expired = *actual_size < buffer_size;
+    return result;
+}
+
+static void dallasWaitStep(dallas_bus_T *bus)
+{
+    (void) bus;
+}
+
+static BOOL dallasWriteData(dallas_bus_T *bus, u08 * buffer, DWORD buffer_size, u32 timeout_us)
 {
     DWORD dwBytesWritten;
-    return WriteFile(hCom, buffer, buffer_size, &dwBytesWritten, NULL);
+    (void) timeout_us;
+    return WriteFile(bus->hCom, buffer, buffer_size, &dwBytesWritten, NULL);
 }
 
 
@@ -233,26 +552,25 @@ if ( wpurl )
 
 #define MAX_PORT_NAME_LENGTH 256
 
-u08 dallasInit(char *PortName)
+static u08 dallasOpenPort(dallas_bus_T *bus, char *PortName)
 {
-    COMMTIMEOUTS cto;
 
     wchar_t wPortName[MAX_PORT_NAME_LENGTH];
     memset(wPortName, 0, sizeof(wPortName));
     MultiByteToWideChar(CP_ACP, 0, PortName, -1, wPortName, sizeof(wPortName));
 
-    hCom = CreateFile(wPortName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0 /*FILE_FLAG_OVERLAPPED*/, NULL);
+    bus->hCom = CreateFile(wPortName, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0 /*FILE_FLAG_OVERLAPPED*/, NULL);
     CHECK_TRUE(
-        hCom != INVALID_HANDLE_VALUE,
+        bus->hCom != INVALID_HANDLE_VALUE,
         "Cannot open COM-port. System error code: 0x%08x\n");
 
     CHECK_TRUE(
-        GetCommState(hCom, &dcb), 
+        GetCommState(bus->hCom, &bus->dcb), 
         "Cannot get comm state. System error code: 0x%08x\n");
-    memset(&dcb, 0, sizeof(dcb));
-    dcb.DCBlength = sizeof(dcb);
-    dcb.ByteSize = 8;
-    dcb.BaudRate = CBR_110;
+    memset(&bus->dcb, 0, sizeof(bus->dcb));
+    bus->dcb.DCBlength = sizeof(bus->dcb);
+    bus->dcb.ByteSize = 8;
+    bus->dcb.BaudRate = CBR_110;
     //BuildCommDCB(L"baud=1200 parity=N data=8 stop=1", &dcb);
     //BuildCommDCB(L"baud=9600 parity=N data=8 stop=1 to=off xon=off odsr=off octs=off dtr=off rts=off idsr=off", &dcb),
     //CHECK_TRUE(
@@ -263,30 +581,47 @@ u08 dallasInit(char *PortName)
     //dcb.StopBits = TWOSTOPBITS;
 //    dcb.fParity = TRUE;
 //    dcb.Parity = MARKPARITY;
-    dcb.BaudRate = CBR_110;
+    bus->dcb.BaudRate = CBR_110;
 //    dcb.StopBits = TWOSTOPBITS;
-    dcb.fDtrControl = DTR_CONTROL_ENABLE;
+    bus->dcb.fDtrControl = DTR_CONTROL_ENABLE;
 
     CHECK_TRUE(
-        GetCommTimeouts(hCom, &cto),
+        GetCommTimeouts(bus->hCom, &bus->cto),
         "Cannot get port timeouts. System error code: 0x%08x\n");
 
-    cto.ReadIntervalTimeout = 100;
-    cto.ReadTotalTimeoutConstant = 100;
-    cto.ReadTotalTimeoutMultiplier = 100;
-    cto.WriteTotalTimeoutConstant = 0;
-    cto.WriteTotalTimeoutMultiplier = 0;
+    // a read ends when all bytes arrive or its total timeout passes
+    bus->cto.ReadIntervalTimeout = 0;
+    bus->cto.ReadTotalTimeoutConstant = DALLAS_DEFAULT_TIMEOUT_MS;
+    bus->cto.ReadTotalTimeoutMultiplier = 0;
+    bus->cto.WriteTotalTimeoutConstant = 0;
+    bus->cto.WriteTotalTimeoutMultiplier = 0;
 
     CHECK_TRUE(
-        SetCommTimeouts(hCom, &cto),
+        SetCommTimeouts(bus->hCom, &bus->cto),
         "Cannot set port timeouts. System error code: 0x%08x\n");
+    bus->baud = bus->dcb.BaudRate;
 
     return DALLAS_NO_ERROR;
 }
 
-void dallasDeinit()
+void dallasDeinit(dallas_bus_T *bus)
+{
+    if (dallasIsPortOpen(bus)) {
+        CloseHandle(bus->hCom);
+        bus->hCom = DALLAS_PORT_CLOSED;
+    }
+}
+
+void dallasPortBreak(dallas_bus_T *bus)
 {
-    CloseHandle(hCom);
+    SetCommBreak(bus->hCom);
+    Sleep(2);
+    ClearCommBreak(bus->hCom);
+}
+
+void dallasPortFlush(dallas_bus_T *bus)
+{
+    PurgeComm(bus->hCom, PURGE_RXCLEAR);
 }
 
 #endif // defined(_WINDOWS_NT_) || defined(_WINDOWS_CE_)
@@ -294,246 +629,699 @@ void dallasDeinit()
 //----------- End of platform specific code ------------
 //------------------------------------------------------
 
+dallas_bus_T *dallasCreateBus(void)
+{
+    dallas_bus_T *bus = (dallas_bus_T *) calloc(1, sizeof(dallas_bus_T));
+    if (bus) {
+        bus->DALLAS_PORT_HANDLE = DALLAS_PORT_CLOSED;
+        // standard reset is 0xF0 at 9600 baud: 521 us low
+        bus->profiles[DALLAS_SPEED_STANDARD].reset_baud = DALLAS_BAUD_RATE_RESET;
+        bus->profiles[DALLAS_SPEED_STANDARD].reset_pattern = 0xF0;
+        bus->profiles[DALLAS_SPEED_STANDARD].io_baud = DALLAS_BAUD_RATE_IO;
+        // overdrive reset is 0xF8 at 57600 baud: 69 us low, slots are 1 us long
+        bus->profiles[DALLAS_SPEED_OVERDRIVE].reset_baud = DALLAS_BAUD_RATE_OVERDRIVE_RESET;
+        bus->profiles[DALLAS_SPEED_OVERDRIVE].reset_pattern = 0xF8;
+        bus->profiles[DALLAS_SPEED_OVERDRIVE].io_baud = DALLAS_BAUD_RATE_OVERDRIVE_IO;
+        bus->baud = 9600;
+        dallasSetTimeout(bus, DALLAS_DEFAULT_TIMEOUT_MS);
+    }
+    return bus;
+}
 
-u08 dallasReset(void)
+void dallasDestroyBus(dallas_bus_T *bus)
 {
-    unsigned char c, i;
+    if (bus) {
+        dallasDeinit(bus);
+        free(bus);
+    }
+}
 
+void dallasSetAdapter(dallas_bus_T *bus, u08 adapter)
+{
+    bus->adapter = adapter;
+}
+
+u08 dallasInit(dallas_bus_T *bus, char *PortName)
+{
+    u08 error;
+
+    DALLAS_CHECK(dallasOpenPort(bus, PortName));
+    bus->speed = DALLAS_SPEED_STANDARD;
+    bus->resume_valid = 0;
+    bus->port_stale = 0;
+    bus->baud_switches = 0;
+    bus->search_cache_count = 0;
+
+    if (bus->adapter == DALLAS_ADAPTER_DS2480B) {
+        error = ds2480Init(bus, &bus->ds2480);
+        if (error != DALLAS_NO_ERROR)
+            dallasDeinit(bus);
+        return error;
+    }
+    return DALLAS_NO_ERROR;
+}
+
+u08 dallasPortSetSpeed(dallas_bus_T *bus, u08 fast)
+{
     CHECK_TRUE(
-        dallasSetBaudRate(DALLAS_BAUD_RATE_RESET) != FALSE,
+        dallasSetBaudRate(bus, fast ? DALLAS_BAUD_RATE_IO : DALLAS_BAUD_RATE_RESET) != FALSE,
         "Cannot set baud rate. System error code: 0x%08x\n");
+    return DALLAS_NO_ERROR;
+}
+
+// time bytes take on the wire at the current baud rate (10 bits each)
+// plus the time the adapter is busy on the bus and the timeout budget
+static u32 dallasExchangeTimeout(dallas_bus_T *bus, u16 bytes, u32 busy_us)
+{
+    return (u32) ((u64) bytes * 10 * 1000000 / bus->baud) + busy_us + bus->budget_ms * 1000UL;
+}
+
+u08 dallasPortExchange(dallas_bus_T *bus, u08 *buffer, u16 write_size, u16 read_size, u32 busy_us)
+{
+    u32 timeout_us = dallasExchangeTimeout(bus, write_size + read_size, busy_us);
+    DWORD bytes_read;
 
-    c = 0xF0;
-    for (i=0; c == 0xF0 && i < 3; ++i) {
+    bus->accesses++;
     CHECK_TRUE(
-        dallasWriteData(&c, 1) != FALSE, 
+        dallasWriteData(bus, buffer, write_size, timeout_us), 
         "Cannot write data to port. System error code: 0x%08x\n");
 
     CHECK_TRUE(
-        dallasReadData(&c, 1, NULL) != FALSE,
+        dallasReadData(bus, buffer, read_size, &bytes_read, timeout_us),
         "Cannot read data from port. System error code: 0x%08x\n");
+    if (bytes_read < read_size) {
+        // the rest may still come, it is dropped before the next baud rate switch
+        bus->port_stale = 1;
+        return DALLAS_DEVICE_ERROR;
     }
 
-    if (c == 0xF0)
-        return DALLAS_NO_PRESENCE;
-
     return DALLAS_NO_ERROR;
 }
 
-u08 dallasWriteBit(u08 bit)
+// writes size bytes of bus->io at baud and waits for read_size bytes back
+static u08 dallasStepStart(dallas_bus_T *bus, u08 step, DALLAS_BAUD baud, u16 size, u16 read_size, u32 busy_us)
 {
-    unsigned char c;
+    u32 timeout_us;
 
+    bus->step = step;
     CHECK_TRUE(
-        dallasSetBaudRate(DALLAS_BAUD_RATE_IO),
+        dallasSetBaudRate(bus, baud) != FALSE,
         "Cannot set baud rate. System error code: 0x%08x\n");
 
-    c = bit ? 0xFF : 0;
-
+    timeout_us = dallasExchangeTimeout(bus, size + read_size, busy_us);
+    bus->accesses++;
     CHECK_TRUE(
-        dallasWriteData(&c, 1), 
+        dallasWriteData(bus, bus->io, size, timeout_us), 
         "Cannot write data to port. System error code: 0x%08x\n");
 
-    CHECK_TRUE(
-        dallasReadData(&c, 1, NULL), 
-        "Cannot read data from port. System error code: 0x%08x\n");
+    bus->io_size = read_size;
+    bus->io_done = 0;
+    if (read_size == 0)
+        return dallasStepDone(bus);
+    dallasArmDeadline(bus, timeout_us);
+    return DALLAS_PENDING;
+}
 
-    return c == 0xFF ? 1 : 0;
+void dallasSetTimeout(dallas_bus_T *bus, u16 timeout_ms)
+{
+    bus->timeout_ms = timeout_ms;
+    bus->budget_ms = timeout_ms;
 }
 
-#define DALLAS_MAX_RETRY_COUNT         	6
-#define DALLAS_BUFFER_SIZE            128
 
-static unsigned char dallas_buffer[DALLAS_BUFFER_SIZE];
-static u08 dallas_buffer_size, dallas_buffer_in_size, dallas_buffer_in_pos, dallas_buffer_out_pos, dallas_buffer_enabled;
+u32 dallasGetBaudSwitchCount(dallas_bus_T *bus)
+{
+    return bus->baud_switches;
+}
 
-u08 dallasWriteBits(u08 * pByte, u08 bit_count)
+void dallasSetOverdrive(dallas_bus_T *bus, u08 enabled)
 {
-    u08 i, j;
-    u08 *pb;
-    unsigned char buffer[DALLAS_BUFFER_SIZE * 8];
-    u08 uBytesRead;
+    bus->overdrive = enabled;
+    bus->overdrive_enabled = enabled;
+}
 
-    if (bit_count <= 0)
-        return 0;
+// a search pass or a verify has found devices, overdrive dropped after no presence is tried again
+static void dallasOverdriveRetry(dallas_bus_T *bus)
+{
+    bus->overdrive = bus->overdrive_enabled;
+}
+
+// reset pulse at the current speed of the bus
+static u08 dallasResetPulse(dallas_bus_T *bus)
+{
+    const dallas_speed_profile_T *profile = &bus->profiles[bus->speed];
+    unsigned char c, i;
+    DWORD bytes_read;
+    u32 timeout_us;
+
+    if (bus->adapter == DALLAS_ADAPTER_DS2480B)
+        return ds2480Exchange(bus, &bus->ds2480, 1, bus->speed == DALLAS_SPEED_OVERDRIVE, 0, 0, 0);
 
     CHECK_TRUE(
-        dallasSetBaudRate(DALLAS_BAUD_RATE_IO),
+        dallasSetBaudRate(bus, profile->reset_baud) != FALSE,
         "Cannot set baud rate. System error code: 0x%08x\n");
 
-    pb = pByte;
-    for (i=0;i<bit_count;i++) {
-        buffer[i] = (*pb & 1 ? 0xFF : 0);
-        *pb >>= 1;
-        if ((i & 7) == 7)
-            pb++;
-    }
-
+    timeout_us = dallasExchangeTimeout(bus, 2, 0);
+    bus->accesses++;
+    c = profile->reset_pattern;
+    for (i=0; c == profile->reset_pattern && i < 3; ++i) {
     CHECK_TRUE(
-        dallasWriteData(&buffer[0], bit_count), 
+        dallasWriteData(bus, &c, 1, timeout_us) != FALSE, 
         "Cannot write data to port. System error code: 0x%08x\n");
 
-    for (i=0,j=0; i<bit_count; i += uBytesRead) {
-        CHECK_TRUE(
-            dallasReadData(&buffer[i], bit_count - i, &uBytesRead),
-            "Cannot read data from port. System error code: 0x%08x\n");
-        if (uBytesRead > 0)
-            j = 0;
-        else if (++j == DALLAS_MAX_RETRY_COUNT)
-            break;        
+    CHECK_TRUE(
+        dallasReadData(bus, &c, 1, &bytes_read, timeout_us) != FALSE,
+        "Cannot read data from port. System error code: 0x%08x\n");
+    if (bytes_read == 0)
+        bus->port_stale = 1;
     }
-    uBytesRead = i;
 
-    if (uBytesRead != bit_count) {
-        // rprintf("bitCount = %d, uBytesRead = %d\n", bit_count, uBytesRead);
-        return 0;
+    if (c == profile->reset_pattern)
+        return DALLAS_NO_PRESENCE;
+
+    return DALLAS_NO_ERROR;
+}
+
+u08 dallasReset(dallas_bus_T *bus)
+{
+    // ROM command following the reset is unknown here, it may clear RC flag
+    bus->resume_valid = 0;
+
+    // standard reset returns devices in overdrive to standard speed
+    bus->speed = DALLAS_SPEED_STANDARD;
+    return dallasResetPulse(bus);
+}
+
+// every bit on the bus is one UART byte at DALLAS_BAUD_RATE_IO, LSB first:
+// 0xFF writes 1 or reads, 0x00 writes 0
+#define DALLAS_SLOT(byte, bit)  ((((byte) >> (bit)) & 1) ? 0xFF : 0x00)
+#define DALLAS_SLOTS_1(b)       { DALLAS_SLOT(b, 0), DALLAS_SLOT(b, 1), DALLAS_SLOT(b, 2), DALLAS_SLOT(b, 3), \
+                                  DALLAS_SLOT(b, 4), DALLAS_SLOT(b, 5), DALLAS_SLOT(b, 6), DALLAS_SLOT(b, 7) }
+#define DALLAS_SLOTS_4(b)       DALLAS_SLOTS_1(b), DALLAS_SLOTS_1(b + 1), DALLAS_SLOTS_1(b + 2), DALLAS_SLOTS_1(b + 3)
+#define DALLAS_SLOTS_16(b)      DALLAS_SLOTS_4(b), DALLAS_SLOTS_4(b + 4), DALLAS_SLOTS_4(b + 8), DALLAS_SLOTS_4(b + 12)
+#define DALLAS_SLOTS_64(b)      DALLAS_SLOTS_16(b), DALLAS_SLOTS_16(b + 16), DALLAS_SLOTS_16(b + 32), DALLAS_SLOTS_16(b + 48)
+
+// slot bytes of every byte value, built at compile time
+static const unsigned char dallas_slot_table[256][8] = {
+    DALLAS_SLOTS_64(0), DALLAS_SLOTS_64(64), DALLAS_SLOTS_64(128), DALLAS_SLOTS_64(192)
+};
+
+// encodes bits of data into slot bytes for UART
+static void dallasEncodeSlots(const u08 *data, u16 bit_count, unsigned char *slots)
+{
+    u16 i;
+    for (i = 0; i + 8 <= bit_count; i += 8)
+        memcpy(&slots[i], dallas_slot_table[data[i >> 3]], 8);
+    if (i < bit_count)
+        memcpy(&slots[i], dallas_slot_table[data[i >> 3]], bit_count - i);
+}
+
+// decodes 8 slot bytes into one byte, without loop and shifts through memory
+// so ARM9 keeps the result in register and uses conditional instructions
+static u08 dallasDecodeSlotByte(const unsigned char *slots)
+{
+    return (slots[0] == 0xFF)
+        | (slots[1] == 0xFF) << 1
+        | (slots[2] == 0xFF) << 2
+        | (slots[3] == 0xFF) << 3
+        | (slots[4] == 0xFF) << 4
+        | (slots[5] == 0xFF) << 5
+        | (slots[6] == 0xFF) << 6
+        | (slots[7] == 0xFF) << 7;
+}
+
+// decodes slot bytes received from UART into bits of data
+// a slot is read as 1 only if nobody pulled the bus low during the slot
+static void dallasDecodeSlots(const unsigned char *slots, u16 bit_count, u08 *data)
+{
+    u16 i = 0;
+
+#if defined(DALLAS_SSE2)
+    // 16 slots are compared at once, movemask packs them into two bytes
+    const __m128i ones = _mm_set1_epi8((char) 0xFF);
+    for (; i + 16 <= bit_count; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *) &slots[i]), ones));
+        data[i >> 3] = (u08) mask;
+        data[(i >> 3) + 1] = (u08) (mask >> 8);
     }
+#elif defined(DALLAS_NEON)
+    // NEON has no movemask: matched lanes are weighted by their bit and summed pairwise
+    static const u08 weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    const uint8x16_t bits = vld1q_u8(weights);
+    for (; i + 16 <= bit_count; i += 16) {
+        uint8x16_t mask = vandq_u8(vceqq_u8(vld1q_u8(&slots[i]), vdupq_n_u8(0xFF)), bits);
+        uint8x8_t sum = vpadd_u8(vget_low_u8(mask), vget_high_u8(mask));
+        sum = vpadd_u8(sum, sum);
+        sum = vpadd_u8(sum, sum);
+        data[i >> 3] = vget_lane_u8(sum, 0);
+        data[(i >> 3) + 1] = vget_lane_u8(sum, 1);
+    }
+#endif
 
-    pb = pByte - 1;
-    for (i=0;i<bit_count;i++) {
-        if ((i & 7) == 0)
-            *++pb = 0;
-        *pb >>= 1;
-        *pb |= (buffer[i] == 0xFF ? 0x80 : 0);
+    for (; i + 8 <= bit_count; i += 8)
+        data[i >> 3] = dallasDecodeSlotByte(&slots[i]);
+
+    if (i < bit_count) {
+        data[i >> 3] = 0;
+        for (; i < bit_count; i++)
+            if (slots[i] == 0xFF)
+                data[i >> 3] |= 1 << (i & 7);
     }
+}
 
-    if (bit_count & 7)
-        *pb >>= 8 - (bit_count & 7);
+// writes slot bytes to the bus with a single write and reads the answer back into the same buffer
+static u08 dallasExchangeSlots(dallas_bus_T *bus, unsigned char *slots, DWORD count)
+{
+    CHECK_TRUE(
+        dallasSetBaudRate(bus, bus->profiles[bus->speed].io_baud),
+        "Cannot set baud rate. System error code: 0x%08x\n");
 
-    return 0;
+    return dallasPortExchange(bus, slots, (u16) count, (u16) count, 0);
 }
 
-u08 dallasWriteByteUnbuffered(u08 byte, u08 bit_count)
+// writes bit_count bits of data and replaces them with the bits read from the bus
+static u08 dallasWriteBits(dallas_bus_T *bus, u08 *data, u16 bit_count)
 {
-    dallasWriteBits(&byte, bit_count);
+    unsigned char slots[DALLAS_TRANSACTION_SIZE * 8];
+
+    if (bit_count == 0)
+        return DALLAS_NO_ERROR;
+    if (bus->adapter == DALLAS_ADAPTER_DS2480B)
+        return ds2480Exchange(bus, &bus->ds2480, 0, bus->speed == DALLAS_SPEED_OVERDRIVE, data, bit_count, 0);
+    if (bit_count > sizeof(slots))
+        return DALLAS_OVERFLOW_ERROR;
+
+    dallasEncodeSlots(data, bit_count, slots);
+    DALLAS_CHECK(dallasExchangeSlots(bus, slots, bit_count));
+    dallasDecodeSlots(slots, bit_count, data);
+
+    return DALLAS_NO_ERROR;
+}
+
+u08 dallasWriteBit(dallas_bus_T *bus, u08 bit)
+{
+    u08 data = bit ? 1 : 0;
+    if (dallasWriteBits(bus, &data, 1) != DALLAS_NO_ERROR)
+        return 0;
+    return data;
+}
+
+u08 dallasWriteByte(dallas_bus_T *bus, u08 byte)
+{
+    dallasWriteBits(bus, &byte, 8);
     return byte;
 }
 
-void dallasFlushBuffer()
+u08 dallasReadByte(dallas_bus_T *bus)
 {
-    if (dallas_buffer_out_pos < dallas_buffer_size)
-        dallasWriteBits(&dallas_buffer[dallas_buffer_out_pos], (dallas_buffer_size - dallas_buffer_out_pos) * 8);
-    if (!dallas_buffer_in_size)
-        dallas_buffer_size = 0;
-    dallas_buffer_out_pos = dallas_buffer_size;
+    return dallasWriteByte(bus, 0xFF);
 }
 
-void dallasBufferEnabled(u08 isEnabled)
+// families having RESUME command, DS2450 and DS18B20 have none
+static u08 dallasResumeSupported(u08 family)
 {
-#ifdef _DALLAS_BUFFER_ENABLED_
-    if (dallas_buffer_enabled != isEnabled && dallas_buffer_enabled) {
-        dallasFlushBuffer();
-        dallas_buffer_size = 0;
-        dallas_buffer_out_pos = 0;
-        dallas_buffer_in_pos = 0;
-        dallas_buffer_in_size = 0;
+    switch (family) {
+    case 0x29:  // DS2408
+    case 0x3A:  // DS2413
+    case 0x2D:  // DS2431
+    case 0x42:  // DS28EA00
+        return 1;
     }
-    dallas_buffer_enabled = isEnabled;
-#endif
+    return 0;
 }
 
-u08 dallasWriteByte(u08 byte)
+// families able to work at overdrive speed, DS18B20 has standard speed only
+u08 dallasOverdriveSupported(u08 family)
 {
-    if (dallas_buffer_enabled && dallas_buffer_size < DALLAS_BUFFER_SIZE) {
-        dallas_buffer[dallas_buffer_size++] = byte;
-        if (dallas_buffer_size == DALLAS_BUFFER_SIZE)
-            dallasFlushBuffer();
+    switch (family) {
+    case 0x20:  // DS2450
+    case 0x29:  // DS2408
+    case 0x3A:  // DS2413
+    case 0x2D:  // DS2431
+    case 0x42:  // DS28EA00
+        return 1;
     }
-    else
-        dallasWriteBits(&byte, 8);
-    return byte;
+    return 0;
+}
+
+void dallasPrepareSelectFrame(dallas_select_frame_T *frame, dallas_rom_id_T *rom_id)
+{
+    u08 data[9];
+    data[0] = DALLAS_MATCH_ROM;
+    memcpy(&data[1], rom_id->byte, 8);
+    dallasEncodeSlots(data, sizeof(frame->encoded), frame->encoded);
+    frame->rom_id = *rom_id;
+}
+
+void dallasSetSelectFrame(dallas_bus_T *bus, const dallas_select_frame_T *frame)
+{
+    bus->select_frame = frame;
+}
+
+void dallasTransactionInit(dallas_transaction_T *transaction)
+{
+    transaction->reset = 0;
+    transaction->size = 0;
+    transaction->overflow = 0;
+    transaction->select_size = 0;
+    transaction->read_index = DALLAS_TRANSACTION_SIZE;
+    transaction->pullup = 0;
+    transaction->timeout_ms = 0;
 }
 
-void dallasBufferRead(u08 size)
+void dallasTransactionSelect(dallas_transaction_T *transaction, dallas_rom_id_T *rom_id)
 {
     u08 i;
-    if (!dallas_buffer_enabled)
-        return;
-    if (size > DALLAS_BUFFER_SIZE)
-        size = DALLAS_BUFFER_SIZE;
-    dallas_buffer_in_size = 0;
-    if (dallas_buffer_size + size > DALLAS_BUFFER_SIZE)
-        dallasFlushBuffer();
-    dallas_buffer_in_pos = dallas_buffer_size;
-    dallas_buffer_in_size = size;
-    for (i = 0; i < size; ++i)
-        dallasWriteByte(0xFF);
-    dallasFlushBuffer();
+
+    transaction->reset = 1;
+    if (rom_id) {
+        dallasTransactionWrite(transaction, DALLAS_MATCH_ROM);
+        for (i = 0; i < 8; i++)
+            dallasTransactionWrite(transaction, rom_id->byte[i]);
+    }
+    else
+        dallasTransactionWrite(transaction, DALLAS_SKIP_ROM);
+    transaction->select_size = transaction->size;
+}
+
+void dallasTransactionWrite(dallas_transaction_T *transaction, u08 byte)
+{
+    if (transaction->size < DALLAS_TRANSACTION_SIZE)
+        transaction->data[transaction->size++] = byte;
+    else
+        transaction->overflow = 1;
 }
 
-u08 dallasReadByte()
+u08 dallasTransactionRead(dallas_transaction_T *transaction, u08 size)
 {
-    u08 b = (dallas_buffer_in_pos < dallas_buffer_size) 
-        ? dallas_buffer[dallas_buffer_in_pos++] 
-        : dallasWriteByte(0xFF);
-    if (dallas_buffer_in_pos > 0 && dallas_buffer_in_pos == dallas_buffer_size) {
-        dallas_buffer_size = 0;
-        dallas_buffer_out_pos = 0;
-        dallas_buffer_in_pos = 0;
-        dallas_buffer_in_size = 0;
+    u08 index = transaction->size;
+    if (index < transaction->read_index)
+        transaction->read_index = index;
+    while (size--)
+        dallasTransactionWrite(transaction, 0xFF);
+    return index;
+}
+
+// remembers the device left selected by the transaction for RESUME
+static void dallasTransactionDone(dallas_bus_T *bus, dallas_transaction_T *transaction, u08 resume)
+{
+    if (transaction->select_size == 9 && dallasResumeSupported(transaction->data[1])) {
+        memcpy(bus->resume_rom_id.byte, &transaction->data[1], 8);
+        bus->resume_valid = 1;
     }
-    return b;
+    else if (!transaction->reset)
+        bus->resume_valid = resume;     // the same device is still being accessed
 }
 
-u08 dallasReadSelectedRAM(u16 addr, u08 len, u08 *data)
+// reset pulse of the current step at the speed of the bus
+static u08 dallasStepReset(dallas_bus_T *bus, u08 step)
 {
-    u08 i, j;
-    u16 crc = 0;
+    const dallas_speed_profile_T *profile = &bus->profiles[bus->speed];
 
-    // first make sure we actually have something to do
-    if (data == NULL)
-        return DALLAS_NULL_POINTER;
-    if (len == 0)
-        return DALLAS_ZERO_LEN;
+    bus->io[0] = profile->reset_pattern;
+    return dallasStepStart(bus, step, profile->reset_baud, 1, 1, 0);
+}
 
-    // enter read mode
-    dallasWriteByte(DALLAS_READ_MEMORY);
-    crc = crc16_update(crc, DALLAS_READ_MEMORY);
-    
-    // write address one byte at a time
-    dallasWriteByte(addr & 0x00FF);
-    dallasWriteByte(addr >> 8);
-    crc = crc16_update(crc, addr & 0x00FF);
-    crc = crc16_update(crc, addr >> 8);
-    
-    dallasBufferRead(10 - (addr & 7));
+// DS2480B packet of the current step
+static u08 dallasStepPacket(dallas_bus_T *bus, u08 step, u08 reset, const u08 *data, u16 bit_count, u08 pullup)
+{
+    u16 size, read_size;
+    u32 busy_us;
 
-    // read data from device 1 byte at a time
-    for (i = 0, j = addr & 7; i < len; i++)
-    {
-        data[i] = dallasReadByte();
-        crc = crc16_update(crc, data[i]);
-        j++;
-        j &= 7;
-        if (!j)
-        {
-	//		wchar_t buf[255];
-	//		u08 b1 = dallasReadByte(), b2 = dallasReadByte();
-
-	//		wsprintf(buf, L"%02x  %02x %02x  %02x %02x %02x %02x %02x %02x %02x %02x  %02x %02x  %04x", 
-	//			DALLAS_READ_MEMORY, addr & 0x00FF, addr >> 8, 
-	//			data[0], data[1], data[2], data[3], data[4], data[5], data[6], data[7], 
-	//			b1, b2, crc);
-	//		MessageBox(0, buf, L"CRC error", MB_OK);
-            crc = ~crc;
-            crc ^= dallasReadByte();
-            crc ^= dallasReadByte() << 8;
-			//crc ^= b1;
-            //crc ^= b2 << 8;
-            if (crc) {
-                dallasBufferEnabled(0);
-                return DALLAS_CRC_ERROR;
+    DALLAS_CHECK(ds2480Prepare(&bus->ds2480, reset, bus->speed == DALLAS_SPEED_OVERDRIVE, data, bit_count, pullup,
+        bus->io, &size, &read_size, &busy_us));
+    return dallasStepStart(bus, step, DALLAS_BAUD_RATE_IO, size, read_size, busy_us);
+}
+
+// bytes of the transaction after its reset
+static u08 dallasStepData(dallas_bus_T *bus)
+{
+    dallas_transaction_T *transaction = bus->transaction;
+    const dallas_select_frame_T *frame = bus->select_frame;
+    u08 match = transaction->select_size == 9;
+    u16 bit_count = transaction->size * 8;
+    u16 index = 0;
+    u08 error;
+
+    bus->step_skipped = 0;
+    if (match && bus->step_resume && !memcmp(&transaction->data[1], bus->resume_rom_id.byte, 8))
+        bus->step_skipped = 8;
+
+    if (bus->adapter == DALLAS_ADAPTER_DS2480B) {
+        // DS2480B gets reset, bytes and strong pull-up of the transaction in a single packet,
+        // RESUME takes place of the last ROM id byte while the packet is built
+        u08 skipped = bus->step_skipped;
+        bus->step_rom_byte = transaction->data[skipped];
+        if (skipped)
+            transaction->data[skipped] = DALLAS_RESUME;
+        error = dallasStepPacket(bus, DALLAS_STEP_PACKET, transaction->reset, &transaction->data[skipped],
+            (transaction->size - skipped) * 8, transaction->pullup);
+        transaction->data[skipped] = bus->step_rom_byte;
+        return error;
+    }
+
+    if (bit_count == 0)
+        return DALLAS_NO_ERROR;
+
+    if (bus->step_skipped) {
+        // the device is still selected by its RC flag, RESUME replaces MATCH ROM with ROM id
+        u08 command = DALLAS_RESUME;
+        dallasEncodeSlots(&command, 8, bus->io);
+        index = 9;
+    }
+    else if (match && frame && !memcmp(&transaction->data[1], frame->rom_id.byte, 8)) {
+        // MATCH ROM of the device being accessed is copied already encoded
+        memcpy(bus->io, frame->encoded, sizeof(frame->encoded));
+        index = 9;
+    }
+    dallasEncodeSlots(&transaction->data[index], bit_count - index * 8, &bus->io[(index - bus->step_skipped) * 8]);
+
+    bit_count -= bus->step_skipped * 8;
+    return dallasStepStart(bus, DALLAS_STEP_SLOTS, bus->profiles[bus->speed].io_baud, bit_count, bit_count, 0);
+}
+
+// the first step of the transaction
+static u08 dallasStepFirst(dallas_bus_T *bus)
+{
+    dallas_transaction_T *transaction = bus->transaction;
+    u08 command = DALLAS_OVERDRIVE_SKIP_ROM;
+
+    if (!transaction->reset)
+        return dallasStepData(bus);
+
+    if (!bus->step_overdrive || !bus->overdrive) {
+        bus->speed = DALLAS_SPEED_STANDARD;
+    }
+    else if (bus->speed != DALLAS_SPEED_OVERDRIVE) {
+        // OVERDRIVE SKIP ROM switches all capable devices to overdrive at once,
+        // the others wait for the next standard reset
+        bus->step_resume = 0;
+        if (bus->adapter == DALLAS_ADAPTER_DS2480B)
+            return dallasStepPacket(bus, DALLAS_STEP_OVERDRIVE_SKIP, 1, &command, 8, 0);
+        return dallasStepReset(bus, DALLAS_STEP_OVERDRIVE_RESET);
+    }
+
+    if (bus->adapter == DALLAS_ADAPTER_DS2480B)
+        return dallasStepData(bus);
+    return dallasStepReset(bus, DALLAS_STEP_RESET);
+}
+
+// all bytes of the current step are received, starts the next one
+static u08 dallasStepDone(dallas_bus_T *bus)
+{
+    dallas_transaction_T *transaction = bus->transaction;
+    const dallas_speed_profile_T *profile = &bus->profiles[bus->speed];
+    u08 command = DALLAS_OVERDRIVE_SKIP_ROM;
+    u08 skipped = bus->step_skipped;
+    u16 index;
+    u08 error;
+
+    switch (bus->step) {
+    case DALLAS_STEP_OVERDRIVE_RESET:
+    case DALLAS_STEP_RESET:
+        if (bus->io[0] == profile->reset_pattern) {
+            if (++bus->step_tries < DALLAS_RESET_TRIES)
+                return dallasStepReset(bus, bus->step);
+            if (bus->step == DALLAS_STEP_RESET && bus->speed == DALLAS_SPEED_OVERDRIVE) {
+                // presence at standard speed shows the port or the devices cannot work at overdrive
+                bus->step_fallback = 1;
+                bus->speed = DALLAS_SPEED_STANDARD;
+                bus->step_tries = 0;
+                return dallasStepReset(bus, DALLAS_STEP_RESET);
             }
-            dallasBufferRead((len - i - 1 < 8) ? (len - i - 1) : 10);
+            return DALLAS_NO_PRESENCE;
         }
+        bus->step_tries = 0;
+        if (bus->step == DALLAS_STEP_RESET) {
+            // overdrive is not tried again until a search or a verify succeeds
+            if (bus->step_fallback)
+                bus->overdrive = 0;
+            return dallasStepData(bus);
+        }
+        dallasEncodeSlots(&command, 8, bus->io);
+        return dallasStepStart(bus, DALLAS_STEP_OVERDRIVE_SKIP, profile->io_baud, 8, 8, 0);
+
+    case DALLAS_STEP_OVERDRIVE_SKIP:
+        bus->speed = DALLAS_SPEED_OVERDRIVE;
+        if (bus->adapter == DALLAS_ADAPTER_DS2480B) {
+            DALLAS_CHECK(ds2480Complete(&bus->ds2480, 1, bus->io, &command, 8, 0));
+            return dallasStepData(bus);
+        }
+        return dallasStepReset(bus, DALLAS_STEP_RESET);
+
+    case DALLAS_STEP_SLOTS:
+        // only read bytes are decoded, written bytes keep their values
+        if (transaction->read_index < transaction->size) {
+            index = transaction->read_index;
+            dallasDecodeSlots(&bus->io[(index - skipped) * 8], (transaction->size - index) * 8, &transaction->data[index]);
+        }
+        dallasTransactionDone(bus, transaction, bus->step_resume);
+        return DALLAS_NO_ERROR;
+
+    case DALLAS_STEP_PACKET:
+        error = ds2480Complete(&bus->ds2480, transaction->reset, bus->io, &transaction->data[skipped],
+            (transaction->size - skipped) * 8, transaction->pullup);
+        transaction->data[skipped] = bus->step_rom_byte;
+        if (error == DALLAS_NO_PRESENCE && transaction->reset && bus->speed == DALLAS_SPEED_OVERDRIVE) {
+            // the devices do not answer at overdrive, the transaction is repeated like the reset
+            // on UART adapter, then at standard speed
+            bus->step_resume = 0;
+            if (++bus->step_tries < DALLAS_RESET_TRIES)
+                return dallasStepData(bus);
+            bus->step_fallback = 1;
+            bus->speed = DALLAS_SPEED_STANDARD;
+            return dallasStepData(bus);
+        }
+        if (error != DALLAS_NO_ERROR)
+            return error;
+        // overdrive is not tried again until a search or a verify succeeds
+        if (bus->step_fallback)
+            bus->overdrive = 0;
+        dallasTransactionDone(bus, transaction, bus->step_resume);
+        return DALLAS_NO_ERROR;
+    }
+    return DALLAS_DEVICE_ERROR;
+}
+
+// reads bytes of the current step which came so far
+static u08 dallasStepContinue(dallas_bus_T *bus)
+{
+    DWORD bytes_read;
+    BOOL expired;
+
+    CHECK_TRUE(
+        dallasReadAvailable(bus, &bus->io[bus->io_done], bus->io_size - bus->io_done, &bytes_read, &expired),
+        "Cannot read data from port. System error code: 0x%08x\n");
+    bus->io_done += (u16) bytes_read;
+    if (bus->io_done == bus->io_size)
+        return dallasStepDone(bus);
+    if (!expired)
+        return DALLAS_PENDING;
+
+    // the rest may still come, it is dropped before the next baud rate switch
+    bus->port_stale = 1;
+    if (bus->step == DALLAS_STEP_OVERDRIVE_RESET || bus->step == DALLAS_STEP_RESET) {
+        // lost echo of the reset pulse is taken as missing presence
+        bus->io[0] = bus->profiles[bus->speed].reset_pattern;
+        return dallasStepDone(bus);
+    }
+    return DALLAS_DEVICE_ERROR;
+}
+
+// the transaction is over, the bus is ready for the next one
+static u08 dallasStepFinish(dallas_bus_T *bus, u08 error)
+{
+    if (error != DALLAS_PENDING) {
+        bus->step = DALLAS_STEP_IDLE;
+        bus->transaction = 0;
+        bus->budget_ms = bus->timeout_ms;
+    }
+    return error;
+}
+
+u08 dallasTransactionStart(dallas_bus_T *bus, dallas_transaction_T *transaction)
+{
+    // an error leaves RC flag of the devices unknown
+    bus->step_resume = bus->resume_valid;
+    bus->resume_valid = 0;
+
+    if (transaction->overflow)
+        return DALLAS_OVERFLOW_ERROR;
+
+    bus->transaction = transaction;
+    bus->budget_ms = transaction->timeout_ms ? transaction->timeout_ms : bus->timeout_ms;
+    bus->step_overdrive = transaction->select_size == 9 && dallasOverdriveSupported(transaction->data[1]);
+    bus->step_tries = 0;
+    bus->step_fallback = 0;
+    return dallasStepFinish(bus, dallasStepFirst(bus));
+}
+
+u08 dallasTransactionContinue(dallas_bus_T *bus)
+{
+    if (bus->step == DALLAS_STEP_IDLE)
+        return DALLAS_NO_ERROR;
+    return dallasStepFinish(bus, dallasStepContinue(bus));
+}
+
+u08 dallasTransactionExecute(dallas_bus_T *bus, dallas_transaction_T *transaction)
+{
+    u08 error = dallasTransactionStart(bus, transaction);
+    while (error == DALLAS_PENDING) {
+        dallasWaitStep(bus);
+        error = dallasTransactionContinue(bus);
+    }
+    return error;
+}
+
+u08 dallasTransactionCheckCRC16(dallas_transaction_T *transaction, u08 index, u08 size)
+{
+    u16 crc = crc16(&transaction->data[index], size);
+    crc = ~crc;
+    crc ^= transaction->data[index + size];
+    crc ^= transaction->data[index + size + 1] << 8;
+    return crc ? DALLAS_CRC_ERROR : DALLAS_NO_ERROR;
+}
+
+void dallasTransactionReadRAM(dallas_transaction_T *transaction, dallas_rom_id_T* rom_id, u16 addr, u08 len)
+{
+    u08 i, page_size;
+
+    // reset the bus, request the device and enter read mode
+    dallasTransactionInit(transaction);
+    dallasTransactionSelect(transaction, rom_id);
+    dallasTransactionWrite(transaction, DALLAS_READ_MEMORY);
+    dallasTransactionWrite(transaction, addr & 0x00FF);
+    dallasTransactionWrite(transaction, addr >> 8);
+
+    // device sends CRC16 at the end of every 8 bytes page,
+    // so pages are read up to the end to check all the data
+    for (i = 0; i < len; i += page_size) {
+        page_size = 8 - ((addr + i) & 7);
+        dallasTransactionRead(transaction, page_size + 2);
+    }
+}
+
+u08 dallasTransactionReadRAMResult(dallas_transaction_T *transaction, u16 addr, u08 len, u08 *data)
+{
+    u08 i, index, size, page_size;
+
+    // CRC of the first page covers command and address, next ones cover only data
+    index = transaction->select_size;
+    size = 3;
+    for (i = 0; i < len; i += page_size) {
+        page_size = 8 - ((addr + i) & 7);
+        DALLAS_CHECK(dallasTransactionCheckCRC16(transaction, index, size + page_size));
+        memcpy(&data[i], &transaction->data[index + size], (len - i < page_size) ? (len - i) : page_size);
+        index += size + page_size + 2;
+        size = 0;
     }
 
     return DALLAS_NO_ERROR;
 }
 
-u08 dallasReadRAM(dallas_rom_id_T* rom_id, u16 addr, u08 len, u08 *data)
+u08 dallasReadRAM(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 addr, u08 len, u08 *data)
 {
-    u08 result;
+    dallas_transaction_T transaction;
 
     // first make sure we actually have something to do
     if (data == NULL)
@@ -541,21 +1329,15 @@ u08 dallasReadRAM(dallas_rom_id_T* rom_id, u16 addr, u08 len, u08 *data)
     if (len == 0)
         return DALLAS_ZERO_LEN;
 
-    dallasBufferEnabled(1);
-
-    // reset the bus and request the device
-    DALLAS_CHECK(dallasMatchROM(rom_id));
-
-    result = dallasReadSelectedRAM(addr, len, data);
-
-    dallasBufferEnabled(0);
-
-    return result;
+    dallasTransactionReadRAM(&transaction, rom_id, addr, len);
+    DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+    return dallasTransactionReadRAMResult(&transaction, addr, len, data);
 }
 
-u08 dallasWriteRAM(dallas_rom_id_T* rom_id, u16 addr, u08 len, u08* data)
+u08 dallasWriteRAM(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 addr, u08 len, u08* data)
 {
-    u08 i;
+    dallas_transaction_T transaction;
+    u08 i, index;
     u16 crc = 0;
 
     // first make sure we actually have something to do
@@ -564,106 +1346,246 @@ u08 dallasWriteRAM(dallas_rom_id_T* rom_id, u16 addr, u08 len, u08* data)
     if (len == 0)
         return DALLAS_ZERO_LEN;
 
-    dallasBufferEnabled(1);
+    // reset the bus, request the device and enter write mode
+    dallasTransactionInit(&transaction);
+    dallasTransactionSelect(&transaction, rom_id);
+    index = transaction.size;
+    dallasTransactionWrite(&transaction, DALLAS_WRITE_MEMORY);
+    dallasTransactionWrite(&transaction, addr & 0x00FF);
+    dallasTransactionWrite(&transaction, addr >> 8);
+
+    // device answers every byte with CRC16 and the byte read back
+    for (i = 0; i < len; i++) {
+        dallasTransactionWrite(&transaction, data[i]);
+        dallasTransactionRead(&transaction, 3);
+    }
 
-    // reset the bus and request the device
-    DALLAS_CHECK(dallasMatchROM(rom_id));
-    
-    // enter write mode
-    dallasWriteByte(DALLAS_WRITE_MEMORY);
-    crc = crc16_update(crc, DALLAS_WRITE_MEMORY);
-
-    // write address one byte at a time
-    dallasWriteByte(addr & 0x00FF);
-    dallasWriteByte(addr >> 8);
-    crc = crc16_update(crc, addr & 0x00FF);
-    crc = crc16_update(crc, addr >> 8);
-
-    // write data one byte at a time
-    for(i=0;i<len;crc = addr + ++i)
-    {
-        dallasWriteByte(data[i]);
-        crc = crc16_update(crc, data[i]);
-        
-        dallasBufferRead(3);
+    DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+
+    // CRC of the first byte covers command and address,
+    // CRC of the next ones is started with the incremented address
+    crc = crc16_update(crc, transaction.data[index++]);
+    crc = crc16_update(crc, transaction.data[index++]);
+    crc = crc16_update(crc, transaction.data[index++]);
+    for (i = 0; i < len; crc = addr + ++i) {
+        crc = crc16_update(crc, transaction.data[index++]);
 
         // verify crc
         crc = ~crc;
-        crc ^= dallasReadByte();
-        crc ^= dallasReadByte() << 8;
+        crc ^= transaction.data[index++];
+        crc ^= transaction.data[index++] << 8;
         if (crc)
-        {
-            dallasBufferEnabled(0);
             return DALLAS_CRC_ERROR;
-        }
 
         // verify the data
-        if (dallasReadByte() != data[i]) {
-            dallasBufferEnabled(0);
+        if (transaction.data[index++] != data[i])
             return DALLAS_VERIFY_ERROR;
-        }
     }
 
-    dallasBufferEnabled(0);
     return DALLAS_NO_ERROR;
 }
 
-void dallasWaitUntilDone(void)
+void dallasWaitUntilDone(dallas_bus_T *bus)
 {
+    (void) bus;
     // wait until we recieve a one
     //while(!dallasReadBit());
 
-    delay_ms(6);	// for ds2450: channels * bits * 80 us + 180 us = 4 * 16 * 80 + 160 = 5280 us
+    delay_ms(DALLAS_CONVERSION_US / 1000);
 }
 
-u08 dallasReadROM(dallas_rom_id_T* rom_id)
-{
-    u08 i;
+// states of dallasJobWaitConversion()
+#define DALLAS_CONVERSION_STARTED   0
+#define DALLAS_CONVERSION_WAITING   1
+#define DALLAS_CONVERSION_POLLING   2
+#define DALLAS_CONVERSION_BUSY      3
 
-    // reset the 1-wire bus and look for presence
-    DALLAS_CHECK(dallasReset());
-    
-    // send READ ROM command
-    dallasWriteByte(DALLAS_READ_ROM);
+u64 dallasGetClock(void)
+{
+    return dallasClock();
+}
 
-    // get the device's ID 1 byte at a time
-    for(i=0;i<8;i++)
-        rom_id->byte[i] = dallasReadByte();
+void dallasJobInit(dallas_job_T *job, u08 (*step)(dallas_job_T *job), dallas_rom_id_T *rom_id, void *result)
+{
+    job->step = step;
+    job->state = 0;
+    job->error = DALLAS_NO_ERROR;
+    job->flags = 0;
+    job->hold_bus = 0;
+    job->param = 0;
+    job->wait_us = 0;
+    job->conversion_us = DALLAS_CONVERSION_US;
+    job->expected_us = 0;
+    job->measured_us = 0;
+    job->poll_us = 0;
+    job->conversion_state = DALLAS_CONVERSION_STARTED;
+    job->session = 0;
+    job->bus_accesses = 0;
+    job->start_time = 0;
+    job->wake_time = 0;
+    job->rom_id = rom_id;
+    job->result = result;
+    dallasTransactionInit(&job->transaction);
+}
 
-    return DALLAS_NO_ERROR;
+u08 dallasJobRun(dallas_bus_T *bus, dallas_job_T *job)
+{
+    u08 error;
+
+    if (!job->step)
+        return DALLAS_NO_ERROR;
+    if (dallasJobTimeLeft(job))
+        return DALLAS_PENDING;
+
+    for (;;) {
+        job->wait_us = 0;
+        job->session = bus->accesses == job->bus_accesses;
+        error = job->step(job);
+        if (error != DALLAS_PENDING) {
+            job->step = 0;
+            return error;
+        }
+        if (job->wait_us) {
+            // strong pull-up feeding parasite powered devices ends with the next bus access
+            job->hold_bus = job->transaction.pullup && bus->adapter == DALLAS_ADAPTER_DS2480B;
+            job->wake_time = dallasClock() + job->wait_us;
+            return DALLAS_PENDING;
+        }
+        job->hold_bus = 0;
+        job->error = dallasTransactionExecute(bus, &job->transaction);
+        job->bus_accesses = bus->accesses;
+    }
 }
 
-u08 dallasMatchROM(dallas_rom_id_T* rom_id)
+u32 dallasJobTimeLeft(dallas_job_T *job)
 {
-    u08 i;
+    u64 now;
+
+    if (!job->step)
+        return 0;
+    now = dallasClock();
+    if (now >= job->wake_time)
+        return 0;
+    return (u32) (job->wake_time - now);
+}
 
-    // reset the 1-wire and look for presence
-    DALLAS_CHECK(dallasReset());
+// the longest wait for a conversion without read slot polls
+static u32 dallasJobConversionDeadline(dallas_job_T *job)
+{
+    u32 deadline = job->expected_us + job->expected_us / 8;
+    if (!(job->flags & DALLAS_JOB_POLL_DONE) || !job->expected_us || deadline > job->conversion_us)
+        return job->conversion_us;
+    return deadline;
+}
 
-    if (rom_id)
-    {
-        // send MATCH ROM command
-        dallasWriteByte(DALLAS_MATCH_ROM);
-    
-        // write id one byte at a time
-        for(i=0;i<8;i++)
-            dallasWriteByte(rom_id->byte[i]);
+u08 dallasJobWaitConversion(dallas_job_T *job)
+{
+    u64 now = dallasClock();
+    u32 elapsed = (u32) (now - job->start_time);
+    u08 polling = (job->flags & DALLAS_JOB_POLL_DONE) && !job->hold_bus;
+
+    switch (job->conversion_state) {
+    case DALLAS_CONVERSION_STARTED:
+        job->start_time = now;
+        job->measured_us = 0;
+        job->poll_us = job->conversion_us / 64 + 1;
+        job->conversion_state = DALLAS_CONVERSION_WAITING;
+        if (job->flags & DALLAS_JOB_POLL_DONE)
+            job->wait_us = job->expected_us ? job->expected_us - job->expected_us / 8 : job->conversion_us / 8;
+        else
+            job->wait_us = job->conversion_us;
+        if (!job->wait_us)
+            job->wait_us = 1;
+        return DALLAS_PENDING;
+
+    case DALLAS_CONVERSION_POLLING:
+        DALLAS_CHECK(job->error);
+        // measured_us holds the time the poll was queued at
+        if (job->transaction.data[job->transaction.read_index])
+            break;
+        job->measured_us = 0;
+        if (elapsed >= job->conversion_us)
+            break;
+        // still busy, the next poll comes later
+        job->wait_us = job->conversion_us - elapsed;
+        if (job->wait_us > job->poll_us)
+            job->wait_us = job->poll_us;
+        // the interval doubles up to 1/8 of the longest conversion, the time measured
+        // next is not worse than that
+        if (job->poll_us < job->conversion_us / 8)
+            job->poll_us *= 2;
+        job->conversion_state = DALLAS_CONVERSION_BUSY;
+        return DALLAS_PENDING;
+
+    default:
+        if (polling && job->session && elapsed < job->conversion_us) {
+            // read slots without reset are answered by the converting devices,
+            // the first poll late after the deadline measures nothing
+            dallasTransactionInit(&job->transaction);
+            dallasTransactionRead(&job->transaction, 1);
+            if (job->conversion_state == DALLAS_CONVERSION_BUSY || elapsed < dallasJobConversionDeadline(job))
+                job->measured_us = elapsed;
+            job->conversion_state = DALLAS_CONVERSION_POLLING;
+            return DALLAS_PENDING;
+        }
+        if (elapsed < dallasJobConversionDeadline(job)) {
+            job->wait_us = dallasJobConversionDeadline(job) - elapsed;
+            return DALLAS_PENDING;
+        }
+        break;
     }
-    else
-        // send SKIP ROM command
-        dallasWriteByte(DALLAS_SKIP_ROM);
 
+    job->conversion_state = DALLAS_CONVERSION_STARTED;
     return DALLAS_NO_ERROR;
 }
 
+u08 dallasJobExecute(dallas_bus_T *bus, dallas_job_T *job)
+{
+    u08 error = dallasJobRun(bus, job);
+    u32 left;
+    while (error == DALLAS_PENDING) {
+        // read slot polls measure conversions to a fraction of millisecond
+        left = dallasJobTimeLeft(job);
+        delay_ms(left / 1000);
+        delay_us(left % 1000);
+        error = dallasJobRun(bus, job);
+    }
+    return error;
+}
 
-u08 dallasCommand(dallas_rom_id_T* rom_id, u08 command)
+u08 dallasReadROM(dallas_bus_T *bus, dallas_rom_id_T* rom_id)
 {
-    DALLAS_CHECK(dallasMatchROM(rom_id));
-    dallasWriteByte(command);
+    dallas_transaction_T transaction;
+    u08 index;
+
+    // reset the 1-wire bus, send READ ROM command and get the device's ID
+    dallasTransactionInit(&transaction);
+    transaction.reset = 1;
+    dallasTransactionWrite(&transaction, DALLAS_READ_ROM);
+    index = dallasTransactionRead(&transaction, 8);
+    DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+
+    memcpy(rom_id->byte, &transaction.data[index], 8);
+
     return DALLAS_NO_ERROR;
 }
 
+u08 dallasMatchROM(dallas_bus_T *bus, dallas_rom_id_T* rom_id)
+{
+    return dallasCommand(bus, rom_id, 0);
+}
+
+u08 dallasCommand(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 command)
+{
+    dallas_transaction_T transaction;
+
+    dallasTransactionInit(&transaction);
+    dallasTransactionSelect(&transaction, rom_id);
+    if (command)
+        dallasTransactionWrite(&transaction, command);
+    return dallasTransactionExecute(bus, &transaction);
+}
+
 //void dallasPrintROM(dallas_rom_id_T* rom_id)
 //{
 //    // print out the rom in the format: xx-xxxxxxxxxxxx-xx
@@ -674,59 +1596,276 @@ u08 dallasCommand(dallas_rom_id_T* rom_id, u08 command)
 
 u08 dallasAddressCheck(dallas_rom_id_T* rom_id, u08 family)
 {
-    u08 i;
-
     if (rom_id) {
-        dallas_crc = 0;
-        for(i=0;i<8;i++)
-            dallasCRC(rom_id->byte[i]);
-
-        if (dallas_crc || rom_id->byte[DALLAS_FAMILY_IDX] != family)
+        if (crc8(rom_id->byte, 8) || rom_id->byte[DALLAS_FAMILY_IDX] != family)
             return DALLAS_ADDRESS_ERROR;
     }
 
     return DALLAS_NO_ERROR;
 }
 
-u08 dallasFindDevices(dallas_rom_id_T rom_id[], u08 *count)
+u08 dallasFindDevices(dallas_bus_T *bus, dallas_rom_id_T rom_id[], u08 *count)
 {
     u08 error, num_found = 0;
     dallas_rom_id_T id;
 
-    dallasFindInit();
-    while (num_found < *count && dallasFindNextDevice(&id, &error))
+    dallasFindInit(bus);
+    while (num_found < *count && dallasFindNextDevice(bus, &id, &error))
         memcpy(&rom_id[num_found++], &id, 8);
 
     *count = num_found;
     return error;
 }
 
-void dallasFindInit()
+void dallasFindInit(dallas_bus_T *bus)
 {
     // reset the rom search last discrepancy global
-    last_discrep = 0;
-    done_flag = FALSE;
+    bus->last_discrep = 0;
+    bus->done_flag = FALSE;
+    bus->search_command = DALLAS_SEARCH_ROM;
+    bus->search_family = 0;
 }
 
-int dallasFindNextDevice(dallas_rom_id_T *rom_id, u08 *error)
+void dallasFindConditionalInit(dallas_bus_T *bus)
+{
+    dallasFindInit(bus);
+    bus->search_command = DALLAS_CONDITIONAL_SEARCH;
+}
+
+void dallasFindFamilyInit(dallas_bus_T *bus, u08 family)
+{
+    dallasFindInit(bus);
+    bus->search_family = family;
+}
+
+// a pass along a device of the last complete SEARCH ROM goes out in one exchange,
+// its read slots must show the conflicts recorded then, otherwise the tree has changed
+// on the path and DALLAS_VERIFY_ERROR makes the caller search bit by bit
+static u08 dallasFindNextDevicePredicted(dallas_bus_T *bus, dallas_rom_id_T *rom_id)
+{
+    const dallas_search_node_T *node = 0;
+    u08 slots[(8 + 64 * 3 + 7) / 8];
+    u08 i, n, bit, conflict, two_bits;
+    u08 discrep_marker = 0;
+    u16 index;
+
+    // the next device is the first one of the tree taking ones at the last discrepancy
+    for (i = 0; i < bus->search_cache_count && !node; i++) {
+        node = &bus->search_cache[i];
+        if (bus->search_family && node->rom_id.byte[DALLAS_FAMILY_IDX] != bus->search_family)
+            node = 0;
+        for (n = 0; n + 1 < bus->last_discrep && node; n++) {
+            if (dallasRomBit(&node->rom_id, n) != dallasRomBit(rom_id, n))
+                node = 0;
+        }
+        if (node && bus->last_discrep && !dallasRomBit(&node->rom_id, bus->last_discrep - 1))
+            node = 0;
+    }
+    if (!node)
+        return DALLAS_VERIFY_ERROR;
+
+    DALLAS_CHECK(dallasReset(bus));
+
+    // SEARCH ROM with all 64 read-read-write triplets, the read slots are ones
+    memset(slots, 0xFF, sizeof(slots));
+    slots[0] = DALLAS_SEARCH_ROM;
+    for (n = 0; n < 64; n++) {
+        index = 8 + n * 3 + 2;
+        if (!dallasRomBit(&node->rom_id, n))
+            slots[index >> 3] &= ~(1 << (index & 7));
+    }
+    DALLAS_CHECK(dallasWriteBits(bus, slots, 8 + 64 * 3));
+
+    for (n = 0; n < 64; n++) {
+        index = 8 + n * 3;
+        two_bits = ((slots[index >> 3] >> (index & 7)) & 1) | (((slots[(index + 1) >> 3] >> ((index + 1) & 7)) & 1) << 1);
+        bit = dallasRomBit(&node->rom_id, n);
+        conflict = (node->conflicts[n >> 3] >> (n & 7)) & 1;
+        if (conflict ? two_bits != 0 : two_bits != (bit ? 1 : 2))
+            return DALLAS_VERIFY_ERROR;
+        if (conflict && !bit && !dallasFamilyBit(bus, n))
+            discrep_marker = n + 1;
+    }
+
+    *rom_id = node->rom_id;
+    memcpy(bus->search_conflicts, node->conflicts, sizeof(bus->search_conflicts));
+    bus->last_discrep = discrep_marker;
+    bus->done_flag = (bus->last_discrep == 0);
+    return DALLAS_NO_ERROR;
+}
+
+// devices in the order of the passes finding them, the first bit differing is 0 on the earlier one
+static int dallasSearchOrder(const dallas_rom_id_T *a, const dallas_rom_id_T *b)
+{
+    u08 n;
+
+    for (n = 0; n < 64; n++) {
+        if (dallasRomBit(a, n) != dallasRomBit(b, n))
+            return dallasRomBit(a, n) ? 1 : -1;
+    }
+    return 0;
+}
+
+// the complete search replaces the cached tree, the search of one family
+// replaces only the devices of that family
+static void dallasFindStore(dallas_bus_T *bus)
+{
+    dallas_search_node_T merged[DALLAS_SEARCH_CACHE_SIZE];
+    u08 i = 0, j = 0, count = 0;
+
+    if (!bus->search_family) {
+        memcpy(bus->search_cache, bus->search_found, bus->search_found_count * sizeof(dallas_search_node_T));
+        bus->search_cache_count = bus->search_found_count;
+        return;
+    }
+
+    while (count < DALLAS_SEARCH_CACHE_SIZE && (i < bus->search_cache_count || j < bus->search_found_count)) {
+        if (i < bus->search_cache_count && bus->search_cache[i].rom_id.byte[DALLAS_FAMILY_IDX] == bus->search_family)
+            i++;
+        else if (j >= bus->search_found_count
+                 || (i < bus->search_cache_count && dallasSearchOrder(&bus->search_cache[i].rom_id, &bus->search_found[j].rom_id) < 0))
+            merged[count++] = bus->search_cache[i++];
+        else
+            merged[count++] = bus->search_found[j++];
+    }
+    memcpy(bus->search_cache, merged, count * sizeof(dallas_search_node_T));
+    bus->search_cache_count = count;
+}
+
+// the passes of SEARCH ROM build the tree, it is stored when the search is complete
+static void dallasFindRecord(dallas_bus_T *bus, u08 is_first_device, u08 error, const dallas_rom_id_T *rom_id)
+{
+    dallas_search_node_T *node;
+
+    if (is_first_device)
+        bus->search_found_count = 0;
+    if (error != DALLAS_NO_ERROR) {
+        // the bus is empty or there is no device of the family
+        if (is_first_device && (error == DALLAS_NO_PRESENCE || (error == DALLAS_DEVICE_ERROR && bus->search_family)))
+            dallasFindStore(bus);
+        return;
+    }
+
+    if (bus->search_found_count < DALLAS_SEARCH_CACHE_SIZE) {
+        node = &bus->search_found[bus->search_found_count++];
+        node->rom_id = *rom_id;
+        memcpy(node->conflicts, bus->search_conflicts, sizeof(node->conflicts));
+    }
+    if (bus->done_flag)
+        dallasFindStore(bus);
+}
+
+void dallasFindSave(dallas_bus_T *bus, dallas_search_T *search)
+{
+    search->last_discrep = bus->last_discrep;
+    search->done_flag = bus->done_flag ? 1 : 0;
+    search->command = bus->search_command;
+    search->family = bus->search_family;
+}
+
+void dallasFindRestore(dallas_bus_T *bus, const dallas_search_T *search)
+{
+    bus->last_discrep = search->last_discrep;
+    bus->done_flag = search->done_flag ? TRUE : FALSE;
+    bus->search_command = search->command;
+    bus->search_family = search->family;
+}
+
+int dallasFindNextDevice(dallas_bus_T *bus, dallas_rom_id_T *rom_id, u08 *error)
 {
     u08 err;
-    u08 is_first_device = (last_discrep == 0);
+    u08 is_first_device = (bus->last_discrep == 0);
 
-    if (done_flag) {
+    if (bus->done_flag) {
         if (error)
             *error = DALLAS_NO_ERROR;
         return 0;
     }
 
-    err = dallasFindNextDeviceStatic(rom_id);
+    // passes of SEARCH ROM along the tree of the last one take one exchange each,
+    // the tree is searched bit by bit where it has changed
+    err = DALLAS_VERIFY_ERROR;
+    if (bus->search_command == DALLAS_SEARCH_ROM && bus->adapter != DALLAS_ADAPTER_DS2480B)
+        err = dallasFindNextDevicePredicted(bus, rom_id);
+    if (err == DALLAS_VERIFY_ERROR)
+        err = dallasFindNextDeviceStatic(bus, rom_id);
+    if (bus->search_command == DALLAS_SEARCH_ROM)
+        dallasFindRecord(bus, is_first_device, err, rom_id);
+    // devices present may all leave the conditional search or the family searched, it finds nothing then
+    if (is_first_device && err == DALLAS_DEVICE_ERROR && (bus->search_command == DALLAS_CONDITIONAL_SEARCH || bus->search_family))
+        err = DALLAS_NO_PRESENCE;
+    if (err == DALLAS_NO_ERROR && bus->done_flag)
+        dallasOverdriveRetry(bus);
     if (error)
         *error = (is_first_device && err == DALLAS_NO_PRESENCE) ? DALLAS_NO_ERROR : err;  // bus can be empty, it is not error for caller
 
     return err == DALLAS_NO_ERROR;
 }
 
-static u08 dallasFindNextDeviceStatic(dallas_rom_id_T *rom_id)
+// the whole ROM id is found by DS2480B search accelerator in one exchange
+static u08 dallasFindNextDeviceAccelerated(dallas_bus_T *bus, dallas_rom_id_T *rom_id)
+{
+    u08 path[16];
+    u08 bit_index;
+    u08 discrep_marker = 0;
+    u08 n, bit;
+
+    // search runs at standard speed like dallasReset()
+    bus->resume_valid = 0;
+    bus->speed = DALLAS_SPEED_STANDARD;
+
+    // direction taken on each discrepancy is the same as in dallasFindNextDeviceStatic()
+    memset(path, 0, sizeof(path));
+    for (bit_index = 1; bit_index <= 64; bit_index++) {
+        n = bit_index - 1;
+        if (dallasFamilyBit(bus, n))
+            bit = (bus->search_family >> n) & 1;
+        else if (bit_index < bus->last_discrep)
+            bit = (rom_id->byte[n >> 3] >> (n & 7)) & 1;
+        else
+            bit = (bit_index == bus->last_discrep);
+        path[n >> 2] |= bit << ((n & 3) * 2 + 1);
+    }
+
+    DALLAS_CHECK(ds2480Search(bus, &bus->ds2480, 0, bus->search_command, path));
+
+    memset(rom_id->byte, 0, 8);
+    memset(bus->search_conflicts, 0, sizeof(bus->search_conflicts));
+    for (bit_index = 1; bit_index <= 64; bit_index++) {
+        n = bit_index - 1;
+        bit = (path[n >> 2] >> ((n & 3) * 2 + 1)) & 1;
+        rom_id->byte[n >> 3] |= bit << (n & 7);
+        if ((path[n >> 2] >> ((n & 3) * 2)) & 1) {
+            bus->search_conflicts[n >> 3] |= 1 << (n & 7);
+            // if 0 was picked on discrepancy then record its position
+            if (!bit && !dallasFamilyBit(bus, n))
+                discrep_marker = bit_index;
+        }
+    }
+
+    // there are no devices on the 1-wire, all bits are read as ones
+    if (rom_id->id == 0xFFFFFFFFFFFFFFFFULL)
+        return DALLAS_DEVICE_ERROR;
+
+    // the devices of the family have left, the accelerator follows other devices without conflict
+    if (bus->search_family && rom_id->byte[DALLAS_FAMILY_IDX] != bus->search_family)
+        return DALLAS_DEVICE_ERROR;
+
+    if (crc8(rom_id->byte, 8))
+    {
+        // search was unsuccessful - reset the last discrepancy to 0 and return false
+        bus->last_discrep = 0;
+        return DALLAS_CRC_ERROR;
+    }
+
+    // search was successful, so set last_discrep and done_flag
+    bus->last_discrep = discrep_marker;
+    bus->done_flag = (bus->last_discrep==0);
+
+    return DALLAS_NO_ERROR;
+}
+
+static u08 dallasFindNextDeviceStatic(dallas_bus_T *bus, dallas_rom_id_T *rom_id)
 {
     u08 bit;
     u08 i = 0;
@@ -734,15 +1873,23 @@ static u08 dallasFindNextDeviceStatic(dallas_rom_id_T *rom_id)
     u08 byte_index = 0;
     u08 bit_mask = 1;
     u08 discrep_marker = 0;
-    u08 two_bits = 0x80;
+    u08 two_bits;
+    u08 search[2];
     
+    if (bus->adapter == DALLAS_ADAPTER_DS2480B)
+        return dallasFindNextDeviceAccelerated(bus, rom_id);
+
     // reset the CRC
-    dallas_crc = 0;
+    bus->crc = 0;
+    memset(bus->search_conflicts, 0, sizeof(bus->search_conflicts));
 
-    DALLAS_CHECK(dallasReset());
+    DALLAS_CHECK(dallasReset(bus));
 
-    // send search ROM command
-    dallasWriteByte(DALLAS_SEARCH_ROM);
+    // send search command together with the first two read slots
+    search[0] = bus->search_command;
+    search[1] = 0x03;
+    DALLAS_CHECK(dallasWriteBits(bus, search, 10));
+    two_bits = search[1];
 
     // loop until through all 8 ROM bytes
     while(byte_index<8)
@@ -752,9 +1899,6 @@ static u08 dallasFindNextDeviceStatic(dallas_rom_id_T *rom_id)
         //    01 - all devices have a 0 in this position
         //    10 - all devices ahve a 1 in this position
         //    11 - there are no devices connected to bus
-        if (two_bits & 0x80) {
-            two_bits = dallasWriteByteUnbuffered(0xFF, 2);
-        }
         i = 0;
         if (two_bits & 1)
             i = 2;                // store the msb if 1
@@ -773,19 +1917,27 @@ static u08 dallasFindNextDeviceStatic(dallas_rom_id_T *rom_id)
                 // all devices coupled have 0 or 1
                 // shift 1 to determine if the msb is 0 or 1
                 bit = i>>1;
+
+                // there are no devices of the family searched
+                if (dallasFamilyBit(bus, bit_index - 1) && bit != ((bus->search_family & bit_mask) > 0))
+                    return DALLAS_DEVICE_ERROR;
             }
             else
             {
+                // the family searched is taken, other families are never returned to
+                if (dallasFamilyBit(bus, bit_index - 1))
+                    bit = ((bus->search_family & bit_mask) > 0);
                 // if this discrepancy is before the last discrepancy on a
                 // previous FindNextDevice then pick the same as last time
-                if (bit_index<last_discrep)
+                else if (bit_index<bus->last_discrep)
                     bit = ((rom_id->byte[byte_index] & bit_mask) > 0);
                 else
-                    bit = (bit_index==last_discrep);
+                    bit = (bit_index==bus->last_discrep);
                 
                 // if 0 was picked then record position with bit mask
-                if (!bit)
+                if (!bit && !dallasFamilyBit(bus, bit_index - 1))
                     discrep_marker = bit_index;
+                bus->search_conflicts[byte_index] |= bit_mask;
             }
 
             // isolate bit in rom_id->byte[byte_index] with bit mask
@@ -802,33 +1954,90 @@ static u08 dallasFindNextDeviceStatic(dallas_rom_id_T *rom_id)
             {
                 // if the mask is 0 then go to new ROM
                 // accumulate the CRC and incriment the byte index and bit mask
-                dallasCRC(rom_id->byte[byte_index]);
+                dallasCRC(bus, rom_id->byte[byte_index]);
                 byte_index++;
                 bit_mask++;
             }
-            // ROM search write
-            if (byte_index < 8)
-                two_bits = dallasWriteByteUnbuffered(bit | 6, 3) >> 1;
+            // ROM search write together with two read slots of the next bit
+            if (byte_index < 8) {
+                two_bits = bit | 6;
+                DALLAS_CHECK(dallasWriteBits(bus, &two_bits, 3));
+                two_bits >>= 1;
+            }
             else
-                dallasWriteBit(bit);
+                DALLAS_CHECK(dallasWriteBits(bus, &bit, 1));
         }
     }
 
-    if (dallas_crc)
+    if (bus->crc)
     {
         // search was unsuccessful - reset the last discrepancy to 0 and return false
-        last_discrep = 0;
+        bus->last_discrep = 0;
         return DALLAS_CRC_ERROR;
     }
 
     // search was successful, so set last_discrep and done_flag
-    last_discrep = discrep_marker;
-    done_flag = (last_discrep==0);
+    bus->last_discrep = discrep_marker;
+    bus->done_flag = (bus->last_discrep==0);
+
+    return DALLAS_NO_ERROR;
+}
+
+u08 dallasVerifyDevice(dallas_bus_T *bus, dallas_rom_id_T *rom_id)
+{
+    dallas_rom_id_T found = *rom_id;
+    dallas_search_T search;
+    u08 conflicts[8];
+    u08 slots[(8 + 64 * 3 + 7) / 8];
+    u08 n, bit, two_bits;
+    u16 index;
+    u08 error;
+
+    if (bus->adapter == DALLAS_ADAPTER_DS2480B) {
+        // the accelerator takes the direction of the id on every discrepancy,
+        // the search going on continues afterwards like on the UART adapter
+        dallasFindSave(bus, &search);
+        memcpy(conflicts, bus->search_conflicts, sizeof(conflicts));
+        dallasFindInit(bus);
+        bus->last_discrep = 65;
+        error = dallasFindNextDeviceAccelerated(bus, &found);
+        dallasFindRestore(bus, &search);
+        memcpy(bus->search_conflicts, conflicts, sizeof(conflicts));
+        if (error == DALLAS_NO_ERROR && found.id != rom_id->id)
+            error = DALLAS_DEVICE_ERROR;
+        if (error == DALLAS_NO_ERROR)
+            dallasOverdriveRetry(bus);
+        return error;
+    }
+
+    DALLAS_CHECK(dallasReset(bus));
+
+    // the path is known, so SEARCH ROM with all 64 read-read-write triplets
+    // goes out in one exchange, the read slots are ones
+    memset(slots, 0xFF, sizeof(slots));
+    slots[0] = DALLAS_SEARCH_ROM;
+    for (n = 0; n < 64; n++) {
+        index = 8 + n * 3 + 2;
+        if (!((rom_id->byte[n >> 3] >> (n & 7)) & 1))
+            slots[index >> 3] &= ~(1 << (index & 7));
+    }
+    DALLAS_CHECK(dallasWriteBits(bus, slots, 8 + 64 * 3));
+
+    // the device takes part in every bit: either its bit is read with the complement,
+    // or the other devices conflict with it, all ones or the opposite bit mean it left
+    for (n = 0; n < 64; n++) {
+        index = 8 + n * 3;
+        two_bits = ((slots[index >> 3] >> (index & 7)) & 1) | (((slots[(index + 1) >> 3] >> ((index + 1) & 7)) & 1) << 1);
+        bit = (rom_id->byte[n >> 3] >> (n & 7)) & 1;
+        if (two_bits == 3 || (two_bits != 0 && (two_bits & 1) != bit))
+            return DALLAS_DEVICE_ERROR;
+    }
 
+    dallasOverdriveRetry(bus);
     return DALLAS_NO_ERROR;
 }
 
-char *dallasGetErrorText(u08 error)
+char *dallasGetErrorText(dallas_bus_T *bus, u08 error)
 {
     switch (error)
     {
@@ -856,8 +2065,12 @@ char *dallasGetErrorText(u08 error)
             return "Bus error, check pullup";
         case DALLAS_RESOLUTION_ERROR:
             return "resolution out of range";
+        case DALLAS_OVERFLOW_ERROR:
+            return "Transaction is too long";
+        case DALLAS_PENDING:
+            return "Transaction is in progress";
         case DALLAS_OS_ERROR:
-            return dallasGetLastSystemErrorText();
+            return dallasGetLastSystemErrorText(bus);
         default:
             return "Unknown";
     }
@@ -38,6 +38,8 @@
 													// - Other master transmitting (Dallas is not multi-master)
 													// - Device failure
 #define DALLAS_OS_ERROR				'O'			// OS error
+#define DALLAS_OVERFLOW_ERROR		'o'			// transaction does not fit into DALLAS_TRANSACTION_SIZE
+#define DALLAS_PENDING				'w'			// transaction waits for the port, see dallasTransactionStart()
 
 // ds2450 and ds18b20 errors
 // defined here to work with PrintError
@@ -52,17 +54,42 @@
 #define DALLAS_SKIP_ROM				0xCC
 #define DALLAS_SEARCH_ROM			0xF0
 #define DALLAS_CONDITIONAL_SEARCH	0xEC
+#define DALLAS_RESUME				0xA5
+#define DALLAS_OVERDRIVE_SKIP_ROM	0x3C
+#define DALLAS_OVERDRIVE_MATCH_ROM	0x69
 #define DALLAS_READ_MEMORY			0xAA
 #define DALLAS_WRITE_MEMORY			0x55
 
+// line drivers of the bus
+#define DALLAS_ADAPTER_UART			0			// UART bit slots, DS9097 style
+#define DALLAS_ADAPTER_DS2480B		1			// DS2480B (DS9097U) serial 1-Wire line driver
 
-#define DALLAS_CHECK(x) { u08 error; error = (x); if (error != DALLAS_NO_ERROR) { dallasBufferEnabled(0); return error; } }
-#define DALLAS_CHECK_WITH_DUMP(x) { u08 error; error = (x); if (error != DALLAS_NO_ERROR) { dallasPrintError(error); dallasBufferEnabled(0); return error; } }
+// maximal number of bytes in one transaction
+#define DALLAS_TRANSACTION_SIZE		128
 
-// #define _DALLAS_BUFFER_ENABLED_
+// time allowed for an exchange beyond the time its bytes take on the wire,
+// covers latency of USB serial adapters
+#define DALLAS_DEFAULT_TIMEOUT_MS	20
+
+// time the drivers wait for a conversion, tuned for DS2450:
+// channels * bits * 80 us + 160 us = 4 * 16 * 80 + 160 = 5280 us
+#define DALLAS_CONVERSION_US		6000
+
+// dallas_job_T flags
+#define DALLAS_JOB_START_ALL		0x01		// conversion is started on all devices of the bus by SKIP ROM
+#define DALLAS_JOB_POLL_DONE		0x02		// end of conversion is detected by read slots, externally powered devices only
+#define DALLAS_JOB_PARASITE_POWER	0x04		// strong pull-up feeds the conversion, some device may be parasite powered
+
+#define DALLAS_CHECK(x) { u08 error; error = (x); if (error != DALLAS_NO_ERROR) return error; }
+#define DALLAS_CHECK_WITH_DUMP(x) { u08 error; error = (x); if (error != DALLAS_NO_ERROR) { dallasPrintError(error); return error; } }
 
 //----- Typedefs --------------------------------------------------------------
 
+// opaque bus context, one per serial port
+// holds the port handle, the line settings and the search state,
+// so several buses can be driven from different threads at the same time
+typedef struct dallas_bus_S dallas_bus_T;
+
 // typedef for the rom IDs
 // done so we can access the entire id or each individual byte
 typedef union dallas_rom_id_U
@@ -71,80 +98,265 @@ typedef union dallas_rom_id_U
 	u08 byte[8];
 } dallas_rom_id_T;
 
+// position of a search between dallasFindNextDevice() calls, see dallasFindSave(),
+// the pass is complete when done_flag is set
+typedef struct dallas_search_S
+{
+	u08 last_discrep;						// bit where the next pass turns to ones
+	u08 done_flag;							// the last device has been found
+	u08 command;							// SEARCH ROM or CONDITIONAL SEARCH
+	u08 family;								// family searched, 0 - all families
+} dallas_search_T;
+
+// 1-wire transaction: optional reset followed by bytes written to the bus
+// in a single write, the bytes queued as read slots are replaced with
+// the data received from the bus after execution
+typedef struct dallas_transaction_S
+{
+	u08 reset;								// transaction starts with reset pulse
+	u08 size;								// number of queued bytes
+	u08 overflow;							// more than DALLAS_TRANSACTION_SIZE bytes were queued
+	u08 select_size;						// number of first bytes selecting device
+	u08 read_index;							// index of the first read byte
+	u08 pullup;								// strong pull-up after the last byte, DS2480B only
+	u16 timeout_ms;							// time allowed beyond the wire time, 0 - dallasSetTimeout() value
+	u08 data[DALLAS_TRANSACTION_SIZE];
+} dallas_transaction_T;
+
+// MATCH ROM command with ROM id already encoded into UART slots,
+// it is prepared once per device and copied into transactions selecting it
+typedef struct dallas_select_frame_S
+{
+	dallas_rom_id_T rom_id;
+	unsigned char encoded[9 * 8];
+} dallas_select_frame_T;
+
+// resumable device operation: the driver makes it a chain of transactions and waits
+// for conversions, so the caller may serve other devices while the job waits
+// step() is called with the result of the transaction it queued last in error and
+// returns DALLAS_PENDING with the next transaction queued or with wait_us set,
+// or the result of the job
+typedef struct dallas_job_S
+{
+	u08 (*step)(struct dallas_job_S *job);	// driver function making the next step, 0 - empty job
+	u08 state;								// driver state, 0 - not started
+	u08 error;								// result of the last transaction
+	u08 flags;								// DALLAS_JOB_*
+	u08 hold_bus;							// the wait must not be disturbed by other transactions
+	u08 param;								// driver parameter
+	u32 wait_us;							// the step asks to wait this long before the next one
+	u32 conversion_us;						// longest time the driver waits for the conversion
+	u32 expected_us;						// conversion time learned from measured_us before, 0 - unknown
+	u32 measured_us;						// conversion time detected by read slots, 0 - not detected
+	u32 poll_us;							// interval of the next read slot poll
+	u08 conversion_state;					// state of dallasJobWaitConversion()
+	u08 session;							// no other job accessed the bus since the last transaction of the job
+	u32 bus_accesses;						// accesses of the bus counted after the last transaction of the job
+	u64 start_time;							// dallasGetClock() time the conversion started
+	u64 wake_time;							// dallasGetClock() time of the next step
+	dallas_rom_id_T *rom_id;				// selected device, 0 - SKIP ROM
+	void *result;							// where the driver stores the result
+	dallas_transaction_T transaction;
+} dallas_job_T;
+
 //----- Functions ---------------------------------------------------------------
 
 #ifdef	__cplusplus
 extern "C" {
 #endif
 
+// dallasCreateBus()
+//     allocates a new bus context
+//     returns 0 if there is not enough memory
+dallas_bus_T *dallasCreateBus(void);
+
+// dallasDestroyBus()
+//     closes the port if it is still open and frees the bus context
+void dallasDestroyBus(dallas_bus_T *bus);
+
+// dallasSetAdapter()
+//     selects the line driver, DALLAS_ADAPTER_UART by default,
+//     takes effect on the next dallasInit()
+void dallasSetAdapter(dallas_bus_T *bus, u08 adapter);
+
 // dallasInit()
-//     Initializes the Dallas 1-wire Bus
-//     Currently this function does nothing
-u08 dallasInit(char*);
+//     Opens the given serial port and initializes the Dallas 1-wire Bus on it
+u08 dallasInit(dallas_bus_T *bus, char*);
+
+void dallasDeinit(dallas_bus_T *bus);
+
+// dallasSetTimeout()
+//     sets time allowed for every exchange with the port beyond the time its bytes
+//     take on the wire, a missing answer costs this much instead of blocking reads
+void dallasSetTimeout(dallas_bus_T *bus, u16 timeout_ms);
+
+// dallasSetOverdrive()
+//     enables overdrive speed for transactions selecting devices which support it,
+//     the bus falls back to standard speed when the devices answer at standard speed only,
+//     overdrive is tried again after the next successful search pass or verify
+void dallasSetOverdrive(dallas_bus_T *bus, u08 enabled);
+
+// dallasOverdriveSupported()
+//     returns true if devices of the family work at overdrive speed
+u08 dallasOverdriveSupported(u08 family);
 
-void dallasDeinit(void);
+// dallasGetBaudSwitchCount()
+//     returns the number of baud rate changes of the port since dallasInit(),
+//     every standard transaction on UART adapter costs two of them
+u32 dallasGetBaudSwitchCount(dallas_bus_T *bus);
 
 // dallasReset()
-//     performs a reset on the 1-wire bus
+//     performs a reset at standard speed on the 1-wire bus
 //     returns DALLAS_NO_ERROR, DALLAS_NO_PRESENCE or DALLAS_BUS_ERROR
-u08  dallasReset(void);
+u08  dallasReset(dallas_bus_T *bus);
 
 // dallasReadBit()
 //     reads a bit from the 1-wire bus and returns this bit
 //     note: global interupts are not disabled in this function
 //           if using this function, use cli() and sei() before and after
-#define dallasReadBit()		(dallasWriteBit(1))
+#define dallasReadBit(bus)		(dallasWriteBit((bus), 1))
 
 // dallasWriteBit()
 //     writes the passed in bit to the 1-wire bus
 //     note: global interupts are not disabled in this function
 //           if using this function, use cli() and sei() before and after
-u08 dallasWriteBit(u08 bit);
+u08 dallasWriteBit(dallas_bus_T *bus, u08 bit);
 
 // dallasReadByte()
 //     reads a byte from the 1-wire bus and returns this byte
 //     note: global interupts are disabled in this function
 //#define dallasReadByte()	(dallasWriteByte(0xFF))
-u08 dallasReadByte(void);
-
-void dallasBufferEnabled(u08 isEnabled);
-void dallasBufferRead(u08 size);
+u08 dallasReadByte(dallas_bus_T *bus);
 
 // dallasWriteByte()
 //     writes the passed in byte to the 1-wire bus
 //     note: global interupts are disabled in this function.
-u08 dallasWriteByte(u08 byte);
+u08 dallasWriteByte(dallas_bus_T *bus, u08 byte);
+
+// dallasPrepareSelectFrame()
+//     encodes MATCH ROM of the specified device into the frame
+void dallasPrepareSelectFrame(dallas_select_frame_T *frame, dallas_rom_id_T *rom_id);
+
+// dallasSetSelectFrame()
+//     sets the frame to be used by transactions selecting its device,
+//     other devices and frame 0 are encoded on every transaction
+void dallasSetSelectFrame(dallas_bus_T *bus, const dallas_select_frame_T *frame);
+
+// dallasTransactionInit()
+//     empties the transaction
+void dallasTransactionInit(dallas_transaction_T *transaction);
+
+// dallasTransactionSelect()
+//     queues reset and MATCH ROM of the specified device,
+//     or SKIP ROM if rom_id is 0
+void dallasTransactionSelect(dallas_transaction_T *transaction, dallas_rom_id_T *rom_id);
+
+// dallasTransactionWrite()
+//     queues the byte to be written to the bus
+void dallasTransactionWrite(dallas_transaction_T *transaction, u08 byte);
+
+// dallasTransactionRead()
+//     queues the read slots for size bytes
+//     returns index of the first read byte in transaction data
+u08 dallasTransactionRead(dallas_transaction_T *transaction, u08 size);
+
+// dallasTransactionExecute()
+//     performs the reset if it is queued and then sends all the bytes
+//     as one write to the port and receives the answer with one read
+//     returns any error that occured or DALLAS_NO_ERROR
+u08 dallasTransactionExecute(dallas_bus_T *bus, dallas_transaction_T *transaction);
+
+// dallasTransactionStart()
+//     starts the transaction without waiting for the port, the transaction
+//     must stay in place until it is complete and the bus takes no other calls
+//     returns DALLAS_PENDING if the answer is awaited, the result of the transaction otherwise
+u08 dallasTransactionStart(dallas_bus_T *bus, dallas_transaction_T *transaction);
+
+// dallasTransactionContinue()
+//     reads the answer which came so far and starts the next step of the transaction,
+//     call it when the port is readable or the deadline of the step has passed
+//     returns DALLAS_PENDING or the result of the transaction
+u08 dallasTransactionContinue(dallas_bus_T *bus);
+
+// dallasTransactionCheckCRC16()
+//     checks the inverted CRC16 sent by device after size bytes at index
+//     returns DALLAS_CRC_ERROR or DALLAS_NO_ERROR
+u08 dallasTransactionCheckCRC16(dallas_transaction_T *transaction, u08 index, u08 size);
 
 // dallasReadRAM()
 //     reads the RAM from the specified device, at the specified RAM address
 //     for the specified length.  Data is stored into data variable
-u08  dallasReadRAM(dallas_rom_id_T* rom_id, u16 addr, u08 len, u08 *data);
+u08  dallasReadRAM(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 addr, u08 len, u08 *data);
 
 // dallasWriteRAM()
 //     writes the specified data for the specified length to the RAM
 //     located at the specified address of the specified device
-u08  dallasWriteRAM(dallas_rom_id_T* rom_id, u16 address, u08 len, u08* data);
+u08  dallasWriteRAM(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 address, u08 len, u08* data);
 
 // dallasWaitUntilDone()
 //     waits until the conversion of a dallas device is done
-void dallasWaitUntilDone(void);
+void dallasWaitUntilDone(dallas_bus_T *bus);
+
+// dallasGetClock()
+//     returns microseconds of monotonic clock
+u64 dallasGetClock(void);
+
+// dallasJobInit()
+//     prepares the job of the driver step function, drivers wrap it
+//     into functions setting up their jobs
+void dallasJobInit(dallas_job_T *job, u08 (*step)(dallas_job_T *job), dallas_rom_id_T *rom_id, void *result);
+
+// dallasJobRun()
+//     executes the transactions of the job until it waits or is complete,
+//     does nothing before the wake time of a waiting job
+//     returns DALLAS_PENDING while the job waits or the result of the job
+u08 dallasJobRun(dallas_bus_T *bus, dallas_job_T *job);
+
+// dallasJobTimeLeft()
+//     returns microseconds left until the job wants the next dallasJobRun()
+u32 dallasJobTimeLeft(dallas_job_T *job);
+
+// dallasJobExecute()
+//     runs the job to completion sleeping through its waits
+//     returns the result of the job
+u08 dallasJobExecute(dallas_bus_T *bus, dallas_job_T *job);
+
+// dallasJobWaitConversion()
+//     waits for the conversion started by the last transaction of the job, drivers
+//     call it from the step following that transaction until it is not DALLAS_PENDING
+//     with DALLAS_JOB_POLL_DONE the devices answer read slots with 1 when they are done,
+//     they are polled at doubling intervals from 7/8 of expected_us and measured_us
+//     is set when the end is seen; polls are skipped when another job accessed the bus
+//     meanwhile, the wait ends at expected_us plus 1/8 then, without the flag or
+//     anything learned it lasts conversion_us
+//     returns DALLAS_PENDING while waiting or DALLAS_NO_ERROR
+u08 dallasJobWaitConversion(dallas_job_T *job);
+
+// dallasTransactionReadRAM()
+//     queues reading of len bytes of RAM at addr with the CRC16 of every page
+void dallasTransactionReadRAM(dallas_transaction_T *transaction, dallas_rom_id_T* rom_id, u16 addr, u08 len);
+
+// dallasTransactionReadRAMResult()
+//     checks CRC16 of the pages read by the transaction and copies len bytes into data
+//     returns DALLAS_CRC_ERROR or DALLAS_NO_ERROR
+u08 dallasTransactionReadRAMResult(dallas_transaction_T *transaction, u16 addr, u08 len, u08 *data);
 
 // dallasReadROM()
 //     finds the ROM code of a device if only 1 device is
 //     connected to the bus the ROM value is passed by referenced
 //     returns any error that occured or DALLAS_NO_ERROR
-u08 dallasReadROM(dallas_rom_id_T* rom_id);
+u08 dallasReadROM(dallas_bus_T *bus, dallas_rom_id_T* rom_id);
 
 // dallasMatchROM()
 //     performs a reset on the 1-wire bus and then
 //     selects the specified dallas device on the network
 //     returns any error that occured or DALLAS_NO_ERROR
-u08  dallasMatchROM(dallas_rom_id_T* rom_id);
-#define dallasSkipROM() dallasMatchROM(0)
+u08  dallasMatchROM(dallas_bus_T *bus, dallas_rom_id_T* rom_id);
+#define dallasSkipROM(bus) dallasMatchROM((bus), 0)
 
 // dallasCommand
 //     performs match rom and send command byte
-u08 dallasCommand(dallas_rom_id_T* rom_id, u08 command);
+u08 dallasCommand(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 command);
 
 // dallasPrintROM
 //     prints the ROM from MSB to LSB in the format: xx xx xx xx xx xx xx xx
@@ -160,11 +372,29 @@ u08  dallasAddressCheck(dallas_rom_id_T* rom_id, u08 family);
 //     finds all the devices on the network, or up to the *count
 //     stores the ids in the given array
 //     returns any error that occured or DALLAS_NO_ERROR
-u08 dallasFindDevices(dallas_rom_id_T rom_id[], u08 *count);
+u08 dallasFindDevices(dallas_bus_T *bus, dallas_rom_id_T rom_id[], u08 *count);
 
 // dallasFindInit()
 //     prepares internal variables for device searching
-void dallasFindInit(void);
+void dallasFindInit(dallas_bus_T *bus);
+
+// dallasFindConditionalInit()
+//     prepares searching with CONDITIONAL SEARCH command instead of SEARCH ROM,
+//     dallasFindNextDevice() finds then only the devices whose condition is met
+void dallasFindConditionalInit(dallas_bus_T *bus);
+
+// dallasFindFamilyInit()
+//     prepares searching only the devices of the family, the passes take its bits
+//     at the first ROM byte and do not walk the branches of other families,
+//     dallasFindNextDevice() finds nothing if no device of the family is present
+void dallasFindFamilyInit(dallas_bus_T *bus, u08 family);
+
+// dallasFindSave()
+// dallasFindRestore()
+//     save the position of the search and continue it later, other searches
+//     may run in between, the caller keeps the last rom_id found for the next call
+void dallasFindSave(dallas_bus_T *bus, dallas_search_T *search);
+void dallasFindRestore(dallas_bus_T *bus, const dallas_search_T *search);
 
 // dallasFindNextDevice()
 //     finds devices one by one
@@ -172,11 +402,22 @@ void dallasFindInit(void);
 //     stores error in the error
 //     returns 0 if device not found
 //     function dallasFindInit() must be called before this function called
-int dallasFindNextDevice(dallas_rom_id_T *rom_id, u08 *error);
+//     the bus keeps the discrepancy tree of the last complete SEARCH ROM, passes
+//     along it take a single exchange and only the paths changed since are
+//     searched bit by bit, DS2480B searches every pass in one exchange anyway
+int dallasFindNextDevice(dallas_bus_T *bus, dallas_rom_id_T *rom_id, u08 *error);
+
+// dallasVerifyDevice()
+//     checks that the device with the rom_id is on the bus by one SEARCH ROM
+//     pass along its id, returns DALLAS_NO_ERROR if it is there,
+//     DALLAS_DEVICE_ERROR if it is not, the search of dallasFindNextDevice()
+//     going on and the kept discrepancy tree are not changed
+u08 dallasVerifyDevice(dallas_bus_T *bus, dallas_rom_id_T *rom_id);
 
 // dallasGetErrorText()
 //     returns error text for given error code
-char *dallasGetErrorText(u08 error);
+//     text of DALLAS_OS_ERROR is taken from the given bus
+char *dallasGetErrorText(dallas_bus_T *bus, u08 error);
 
 #ifdef	__cplusplus
 };
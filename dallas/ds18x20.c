@@ -2,6 +2,7 @@
 // Ported to ARM by cherep22
 
 //----- Include Files ---------------------------------------------------------
+#include <string.h>			// include string support
 //#include "uart.h"			// include uart function library
 #include "dallas.h"			// include dallas support
 #include "ds18x20.h"		// include ds18b20 support
@@ -36,57 +37,135 @@ typedef union ds18x20_scratch_pad_U {
 extern "C" {
 #endif
 
-void ds18b20Init(void)
+void ds18b20Init(dallas_bus_T *bus)
 {
+	(void) bus;
 	// initialize the 1-wire
 	// dallasInit();
 }
 
-static u08 ds18x20ReadScratchPad(dallas_rom_id_T* rom_id, ds18x20_scratch_pad_T *scratch_pad)
+// states of ds18b20 jobs
+#define DS18B20_JOB_START			0
+#define DS18B20_JOB_WAIT			1
+#define DS18B20_JOB_READ			2
+#define DS18B20_JOB_RESULT			3
+
+static void ds18x20TransactionReadScratchPad(dallas_transaction_T *transaction, dallas_rom_id_T* rom_id)
 {
-	u08 i;
-	u08 crc = 0;
+	dallasTransactionInit(transaction);
+	dallasTransactionSelect(transaction, rom_id);
 
-	dallasBufferEnabled(1);
-	DALLAS_CHECK(dallasMatchROM(rom_id));
+	// start reading at address 0x00, bytes 0-7 and crc
+	dallasTransactionWrite(transaction, DS18B20_READ_SCRATCHPAD);
+	dallasTransactionRead(transaction, sizeof(ds18x20_scratch_pad_T) + 1);
+}
 
-	// start reading at address 0x00
-	dallasWriteByte(DS18B20_READ_SCRATCHPAD);
-	dallasBufferRead(sizeof(ds18x20_scratch_pad_T) + 1);
-	for (i = 0; i < sizeof(ds18x20_scratch_pad_T); ++i)
-	{
-		scratch_pad->byte[i] = dallasReadByte();		// 0x00-0x07, bytes 0-7
-		crc = crc8_update(crc, scratch_pad->byte[i]);
-	}
-	i = dallasReadByte();
-	crc = crc8_update(crc, i); 			// 0x08, crc
-	dallasBufferEnabled(0);
-	if (crc != 0)
+static u08 ds18x20ScratchPadResult(dallas_transaction_T *transaction, ds18x20_scratch_pad_T *scratch_pad)
+{
+	u08 index = transaction->read_index;
+
+	if (crc8(&transaction->data[index], sizeof(ds18x20_scratch_pad_T) + 1) != 0)
 		return DALLAS_CRC_ERROR;
+	memcpy(scratch_pad->byte, &transaction->data[index], sizeof(ds18x20_scratch_pad_T));
 	return DALLAS_NO_ERROR;
 }
 
-u08 ds18b20GetResolution(dallas_rom_id_T* rom_id, u08 *resolution)
+static u08 ds18x20ReadScratchPad(dallas_bus_T *bus, dallas_rom_id_T* rom_id, ds18x20_scratch_pad_T *scratch_pad)
+{
+	dallas_transaction_T transaction;
+
+	ds18x20TransactionReadScratchPad(&transaction, rom_id);
+	DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+	return ds18x20ScratchPadResult(&transaction, scratch_pad);
+}
+
+static void ds18b20TransactionStart(dallas_transaction_T *transaction, dallas_rom_id_T* rom_id, u08 pullup)
+{
+	// reset, select (or skip rom) and send convert command
+	dallasTransactionInit(transaction);
+	dallasTransactionSelect(transaction, rom_id);
+	dallasTransactionWrite(transaction, DS18B20_CONVERT_TEMP);
+	// parasite powered sensors are fed by strong pull-up until the next bus access,
+	// it holds the bus, so externally powered sensors go without it
+	transaction->pullup = pullup;
+}
+
+static u16 ds18x20Temperature(dallas_rom_id_T* rom_id, ds18x20_scratch_pad_T *scratch_pad)
+{
+	u16 result = scratch_pad->data.t_high << 8 | scratch_pad->data.t_low;
+	if (rom_id->byte[DALLAS_FAMILY_IDX] == DS18S20_FAMILY)
+		result <<= 3;
+	return result;
+}
+
+// convert, wait for the conversion and read the scratch pad, see ds18b20StartAndResultJob()
+static u08 ds18b20Step(dallas_job_T *job)
+{
+	ds18x20_scratch_pad_T scratch_pad;
+
+	DALLAS_CHECK(job->error);
+	switch (job->state) {
+	case DS18B20_JOB_START:
+		if (job->rom_id)
+			DALLAS_CHECK(ds18x20CheckAddress(job->rom_id));
+		ds18b20TransactionStart(&job->transaction, (job->flags & DALLAS_JOB_START_ALL) ? 0 : job->rom_id,
+			(job->flags & DALLAS_JOB_PARASITE_POWER) != 0);
+		job->state = DS18B20_JOB_WAIT;
+		return DALLAS_PENDING;
+	case DS18B20_JOB_WAIT:
+		DALLAS_CHECK(dallasJobWaitConversion(job));
+		if (!job->result)
+			break;
+		job->state = DS18B20_JOB_READ;
+		// fall through
+	case DS18B20_JOB_READ:
+		DALLAS_CHECK(ds18x20CheckAddress(job->rom_id));
+		ds18x20TransactionReadScratchPad(&job->transaction, job->rom_id);
+		job->state = DS18B20_JOB_RESULT;
+		return DALLAS_PENDING;
+	case DS18B20_JOB_RESULT:
+		DALLAS_CHECK(ds18x20ScratchPadResult(&job->transaction, &scratch_pad));
+		*(u16 *) job->result = ds18x20Temperature(job->rom_id, &scratch_pad);
+		break;
+	}
+	return DALLAS_NO_ERROR;
+}
+
+u08 ds18b20GetResolution(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *resolution)
 {
 	ds18x20_scratch_pad_T scratch_pad;
 
 	// check address
 	DALLAS_CHECK(dallasAddressCheck(rom_id, DS18B20_FAMILY));
 
-	// reset and select
-	DALLAS_CHECK(dallasMatchROM(rom_id));
+	// read scratch pad and check CRC
+	DALLAS_CHECK(ds18x20ReadScratchPad(bus, rom_id, &scratch_pad));
+
+	*resolution = ((scratch_pad.data.config.ds18b20.resolution >> 5) & 0x03) + DS18B20_RES_MIN;
+
+	return DALLAS_NO_ERROR;
+}
+
+u08 ds18b20GetAlarms(dallas_bus_T *bus, dallas_rom_id_T* rom_id, s08 *alarm_low, s08 *alarm_high)
+{
+	ds18x20_scratch_pad_T scratch_pad;
+
+	// check address
+	DALLAS_CHECK(dallasAddressCheck(rom_id, DS18B20_FAMILY));
 
 	// read scratch pad and check CRC
-	DALLAS_CHECK(ds18x20ReadScratchPad(rom_id, &scratch_pad));
+	DALLAS_CHECK(ds18x20ReadScratchPad(bus, rom_id, &scratch_pad));
 
-	*resolution = (scratch_pad.data.config.ds18b20.resolution >> 5) & 0x03;
+	*alarm_low = (s08) scratch_pad.data.alarm_low;
+	*alarm_high = (s08) scratch_pad.data.alarm_high;
 
 	return DALLAS_NO_ERROR;
 }
 
-u08 ds18b20Setup(dallas_rom_id_T* rom_id, u08 resolution, s08 alarm_low, s08 alarm_high)
+u08 ds18b20Setup(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 resolution, s08 alarm_low, s08 alarm_high)
 {
 	ds18x20_scratch_pad_T scratch_pad;
+	dallas_transaction_T transaction;
 
 	// check resolution
 	if ((resolution < DS18B20_RES_MIN) || (resolution > DS18B20_RES_MAX))
@@ -96,23 +175,25 @@ u08 ds18b20Setup(dallas_rom_id_T* rom_id, u08 resolution, s08 alarm_low, s08 ala
 	DALLAS_CHECK(ds18x20CheckAddress(rom_id));
 
 	// reset and select
-	DALLAS_CHECK(dallasMatchROM(rom_id));
+	dallasTransactionInit(&transaction);
+	dallasTransactionSelect(&transaction, rom_id);
 
 	// starts writting at address 0x02, T_H
-	dallasWriteByte(DS18B20_WRITE_SCRATCHPAD);
-	dallasWriteByte(alarm_high);
-	dallasWriteByte(alarm_low);
+	dallasTransactionWrite(&transaction, DS18B20_WRITE_SCRATCHPAD);
+	dallasTransactionWrite(&transaction, alarm_high);
+	dallasTransactionWrite(&transaction, alarm_low);
 
 	if (rom_id->byte[0] == DS18B20_FAMILY)
 	{
 		// convert resolution to bitmask
 		// valid value are 9-12 encoded as 0-4, resolution stored in bits 5&6 and bits 0-4 are always one
 		resolution = ((resolution - 9) << 5) | 0x1F;
-		dallasWriteByte(resolution);
+		dallasTransactionWrite(&transaction, resolution);
 	}
+	DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
 
 	// read scratch pad and check CRC
-	DALLAS_CHECK(ds18x20ReadScratchPad(rom_id, &scratch_pad));
+	DALLAS_CHECK(ds18x20ReadScratchPad(bus, rom_id, &scratch_pad));
 
 	// verify the data
 	if (scratch_pad.data.alarm_high != (u08)alarm_high)
@@ -127,6 +208,32 @@ u08 ds18b20Setup(dallas_rom_id_T* rom_id, u08 resolution, s08 alarm_low, s08 ala
 	return DALLAS_NO_ERROR;
 }
 
+u08 ds18b20ReadPowerSupply(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *external)
+{
+	dallas_transaction_T transaction;
+	u08 index;
+
+	if (rom_id)
+		DALLAS_CHECK(ds18x20CheckAddress(rom_id));
+
+	// parasite powered sensors pull the read slots low
+	dallasTransactionInit(&transaction);
+	dallasTransactionSelect(&transaction, rom_id);
+	dallasTransactionWrite(&transaction, DS18B20_READ_POWER);
+	index = dallasTransactionRead(&transaction, 1);
+	DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+
+	*external = transaction.data[index] & 0x01;
+	return DALLAS_NO_ERROR;
+}
+
+u32 ds18b20ConversionTime(u08 resolution)
+{
+	if (resolution < DS18B20_RES_MIN || resolution > DS18B20_RES_MAX)
+		resolution = DS18B20_RES_MAX;
+	return DS18B20_CONVERSION_US >> (DS18B20_RES_MAX - resolution);
+}
+
 u08 ds18x20CheckAddress(dallas_rom_id_T *rom_id)
 {
 	u08 error;
@@ -136,42 +243,50 @@ u08 ds18x20CheckAddress(dallas_rom_id_T *rom_id)
 	return error;
 }
 
-u08 ds18b20Start(dallas_rom_id_T* rom_id)
+u08 ds18b20Start(dallas_bus_T *bus, dallas_rom_id_T* rom_id)
 {
-	dallasBufferEnabled(1);
+	dallas_transaction_T transaction;
+
 	if (rom_id)
-	{
 		DALLAS_CHECK(ds18x20CheckAddress(rom_id));
-		DALLAS_CHECK(dallasMatchROM(rom_id));
-	}
-	else
-	{
-		DALLAS_CHECK(dallasSkipROM());
-	}
-	
-	// send convert command
-	dallasWriteByte(DS18B20_CONVERT_TEMP);
-	dallasBufferEnabled(0);
-	
-	return DALLAS_NO_ERROR;
+
+	ds18b20TransactionStart(&transaction, rom_id, 1);
+	return dallasTransactionExecute(bus, &transaction);
 }
 
-u08 ds18b20Result(dallas_rom_id_T* rom_id, u16 *result)
+u08 ds18b20Result(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 *result)
 {
 	ds18x20_scratch_pad_T scratch_pad;
 	DALLAS_CHECK(ds18x20CheckAddress(rom_id));
-	DALLAS_CHECK(ds18x20ReadScratchPad(rom_id, &scratch_pad));
-	*result = scratch_pad.data.t_high << 8 | scratch_pad.data.t_low;
-	if (rom_id->byte[DALLAS_FAMILY_IDX] == DS18S20_FAMILY)
-		*result <<= 3;
+	DALLAS_CHECK(ds18x20ReadScratchPad(bus, rom_id, &scratch_pad));
+	*result = ds18x20Temperature(rom_id, &scratch_pad);
 	return DALLAS_NO_ERROR;
 }
 
-u08 ds18b20StartAndResult(dallas_rom_id_T* rom_id, u16 *result)
+u08 ds18b20StartAndResult(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 *result)
+{
+	dallas_job_T job;
+	ds18b20StartAndResultJob(&job, rom_id, DS18B20_CONVERSION_US, result);
+	job.flags |= DALLAS_JOB_PARASITE_POWER;
+	return dallasJobExecute(bus, &job);		// return any errors - results passed by reference
+}
+
+void ds18b20StartJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u32 conversion_us)
+{
+	dallasJobInit(job, ds18b20Step, rom_id, 0);
+	job->conversion_us = conversion_us;
+}
+
+void ds18b20ResultJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u16 *result)
+{
+	dallasJobInit(job, ds18b20Step, rom_id, result);
+	job->state = DS18B20_JOB_READ;
+}
+
+void ds18b20StartAndResultJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u32 conversion_us, u16 *result)
 {
-	DALLAS_CHECK(ds18b20Start(rom_id));		// start
-	dallasWaitUntilDone();					// wait
-	return ds18b20Result(rom_id, result);	// return any errors - results passed by reference
+	dallasJobInit(job, ds18b20Step, rom_id, result);
+	job->conversion_us = conversion_us;
 }
 
 //void ds18b20Print(u16 result, u08 resolution)
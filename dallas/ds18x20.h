@@ -25,6 +25,8 @@
 // resolution min and max
 #define DS18B20_RES_MIN				9
 #define DS18B20_RES_MAX				12
+// conversion time at maximal resolution, it halves with every bit less
+#define DS18B20_CONVERSION_US		750000
 
 // no alarm values for high and low
 #define DS18B20_NO_ALARM_LOW		-56		// min temp read is -55C
@@ -38,7 +40,7 @@ extern "C" {
 
 // ds18b20Init()
 //     initializes the dallas 1-wire bus
-void ds18b20Init(void);
+void ds18b20Init(dallas_bus_T *bus);
 
 // ds18b20Setup
 //     Sets up the device
@@ -46,14 +48,31 @@ void ds18b20Init(void);
 //     the resolution [9-12], and the low and high alarm values.
 //     If no low and/or high alarm is desired, use the values -55 and/or 126
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds18b20Setup(dallas_rom_id_T* rom_id, u08 resolution, s08 alarm_low, s08 alarm_high);
+u08 ds18b20Setup(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 resolution, s08 alarm_low, s08 alarm_high);
 
 // ds18b20GetResolution
 //     Get device resolution
 //     The parameters are the rom id of the device,
 //     Output parameter esolution [9-12] is set.
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds18b20GetResolution(dallas_rom_id_T* rom_id, u08 *resolution);
+u08 ds18b20GetResolution(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *resolution);
+
+// ds18b20GetAlarms
+//     Get the low and high alarm values of the device in whole degrees,
+//     after a conversion the device answers CONDITIONAL SEARCH if the integer part
+//     of the temperature is not above the low one or not below the high one
+//     Returns either the corresponding error or DALLAS_NO_ERROR
+u08 ds18b20GetAlarms(dallas_bus_T *bus, dallas_rom_id_T* rom_id, s08 *alarm_low, s08 *alarm_high);
+
+// ds18b20ReadPowerSupply
+//     Finds out if the device is externally powered, rom id 0 asks all sensors
+//     and *external is 0 if any of them is parasite powered
+//     Returns either the corresponding error or DALLAS_NO_ERROR
+u08 ds18b20ReadPowerSupply(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *external);
+
+// ds18b20ConversionTime
+//     Returns microseconds the conversion takes at the resolution [9-12]
+u32 ds18b20ConversionTime(u08 resolution);
 
 // ds18x20CheckAddress
 //     Check that rom id has valid family code (DS18B20 or DS18S20)
@@ -61,21 +80,44 @@ u08 ds18b20GetResolution(dallas_rom_id_T* rom_id, u08 *resolution);
 u08 ds18x20CheckAddress(dallas_rom_id_T *rom_id);
 
 // ds18b20Start()
-//     Start the conversion for the given device
+//     Start the conversion for the given device, parasite powered devices
+//     are fed by strong pull-up until the next bus access
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds18b20Start(dallas_rom_id_T* rom_id);
+u08 ds18b20Start(dallas_bus_T *bus, dallas_rom_id_T* rom_id);
 
 // ds18b20Result()
 //     Gets the result of the conversion and stores it in *result
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds18b20Result(dallas_rom_id_T* rom_id, u16 *result);
+u08 ds18b20Result(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 *result);
 
 // ds18b20StartAndResult();
-//     1-step command to start the conversion and store the result in *result
+//     1-step command to start the conversion and store the result in *result,
+//     it waits for the conversion at maximal resolution
 //     The conversion takes some time to do, so it can be more efficient
 //     to do the 1-step commands Start() and Result()
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds18b20StartAndResult(dallas_rom_id_T* rom_id, u16 *result);
+u08 ds18b20StartAndResult(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 *result);
+
+//----- Resumable Functions -------------------------------------------------
+// The jobs do the same as the functions above but return to the caller while
+// the conversion runs, see dallasJobRun(). With DALLAS_JOB_START_ALL in job
+// flags the conversion is started on all sensors of the bus by SKIP ROM.
+// With DALLAS_JOB_POLL_DONE the jobs end the wait when read slots see
+// the conversion done, set it for externally powered sensors only.
+// Strong pull-up feeds the conversion only with DALLAS_JOB_PARASITE_POWER,
+// on DS2480B it holds the bus and read slots cannot end the wait then.
+
+// ds18b20StartJob()
+//     Start the conversion and wait conversion_us for it, rom id 0 starts all sensors
+void ds18b20StartJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u32 conversion_us);
+
+// ds18b20ResultJob()
+//     Gets the result of the conversion done already and stores it in *result
+void ds18b20ResultJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u16 *result);
+
+// ds18b20StartAndResultJob()
+//     Start the conversion, wait conversion_us for it and store the result in *result
+void ds18b20StartAndResultJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u32 conversion_us, u16 *result);
 
 // ds18b20Print()
 //     Does a formatted print on the given resultat the given resolution: +xx x/xx
@@ -48,43 +48,152 @@
 signed int ds2408_buffer=-1;
 #endif
 
-#define W1_WRITE dallasWriteByte
-#define W1_READ dallasReadByte
-
 #ifdef	__cplusplus
 extern "C" {
 #endif
 
-u08	ds2408_write_register(dallas_rom_id_T *id, u08 address, u08 data)
+// states of ds2408 jobs
+#define DS2408_JOB_READ		0
+#define DS2408_JOB_RESULT	1
+#define DS2408_JOB_ACTIVITY	2
+#define DS2408_JOB_REGISTERS	3
+#define DS2408_JOB_ARM		4
+
+// control/status of a device answering conditional search when any activity latch is set
+#define ACTIVITY_SEARCH(control)	(((control) & RSTZ_STRB) | PLS_LATCH | CT_OR)
+
+// queues reading of count registers with Read PIO Registers command
+static void ds2408_transaction_read_registers(dallas_transaction_T *transaction, dallas_rom_id_T *id, u08 address, u08 count)
+{
+	dallasTransactionInit(transaction);
+	dallasTransactionSelect(transaction, id);
+	dallasTransactionWrite(transaction, READ_PIO);
+	dallasTransactionWrite(transaction, address);
+	dallasTransactionWrite(transaction, ADR_NULL);
+	dallasTransactionRead(transaction, count);
+}
+
+// reads one register with Read PIO Registers command
+static u08 ds2408_read_register(dallas_bus_T *bus, dallas_rom_id_T *id, u08 address, u08 *result)
+{
+	dallas_transaction_T transaction;
+	ds2408_transaction_read_registers(&transaction, id, address, 1);
+	DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+	*result = transaction.data[transaction.read_index];
+	return DALLAS_NO_ERROR;
+}
+
+// queues writing of conditional search registers selecting all channels with polarity 1,
+// writing 0 clears PORL
+static void ds2408_transaction_arm(dallas_transaction_T *transaction, dallas_rom_id_T *id, u08 control)
+{
+	dallasTransactionInit(transaction);
+	dallasTransactionSelect(transaction, id);
+	dallasTransactionWrite(transaction, WRITE_REGISTER);
+	dallasTransactionWrite(transaction, CS_CHANNEL_MASK);
+	dallasTransactionWrite(transaction, ADR_NULL);
+	dallasTransactionWrite(transaction, 0xFF);
+	dallasTransactionWrite(transaction, 0xFF);
+	dallasTransactionWrite(transaction, control);
+}
+
+// queues reset of activity latches
+static void ds2408_transaction_reset_activity(dallas_transaction_T *transaction, dallas_rom_id_T *id)
+{
+	dallasTransactionInit(transaction);
+	dallasTransactionSelect(transaction, id);
+	dallasTransactionWrite(transaction, RESET_ACTIVITY);
+	dallasTransactionRead(transaction, 1);
+}
+
+// resets activity latches, then reads the logic state and the registers up to control/status,
+// rearms the conditional search if power-on reset has cleared it, see ds2408_read_activity_job()
+static u08 ds2408_activity_step(dallas_job_T *job)
+{
+	u08 *data = &job->transaction.data[job->transaction.read_index];
+
+	DALLAS_CHECK(job->error);
+	switch (job->state) {
+	case DS2408_JOB_READ:
+		ds2408_transaction_reset_activity(&job->transaction, job->rom_id);
+		job->state = DS2408_JOB_ACTIVITY;
+		return DALLAS_PENDING;
+	case DS2408_JOB_ACTIVITY:
+		if (data[0] != RESET_CONFIRMATION)
+			return DALLAS_VERIFY_ERROR;
+		// activity from now on is latched for the next search
+		ds2408_transaction_read_registers(&job->transaction, job->rom_id, LOGIC_STATE, CONTROL_STATUS - LOGIC_STATE + 1);
+		job->state = DS2408_JOB_REGISTERS;
+		return DALLAS_PENDING;
+	case DS2408_JOB_REGISTERS:
+		*(u08 *) job->result = data[0];
+		if (data[CS_CHANNEL_MASK - LOGIC_STATE] != 0xFF || data[CS_POLARITY - LOGIC_STATE] != 0xFF
+				|| data[CONTROL_STATUS - LOGIC_STATE] & PORL
+				|| (data[CONTROL_STATUS - LOGIC_STATE] & (PLS_LATCH | CT_AND)) != (PLS_LATCH | CT_OR)) {
+			ds2408_transaction_arm(&job->transaction, job->rom_id, ACTIVITY_SEARCH(data[CONTROL_STATUS - LOGIC_STATE]));
+			job->state = DS2408_JOB_ARM;
+			return DALLAS_PENDING;
+		}
+		break;
+	case DS2408_JOB_ARM:
+		break;
+	}
+	return DALLAS_NO_ERROR;
+}
+
+// reads the register job->param, see ds2408_read_input_job()
+static u08 ds2408_step(dallas_job_T *job)
 {
-	dallasBufferEnabled(1);
-	DALLAS_CHECK(dallasCommand((dallas_rom_id_T *)&id[0], WRITE_REGISTER));
-	W1_WRITE(address);
-	W1_WRITE(ADR_NULL);
-	W1_WRITE(data);
-	dallasBufferEnabled(0);
+	DALLAS_CHECK(job->error);
+	switch (job->state) {
+	case DS2408_JOB_READ:
+		ds2408_transaction_read_registers(&job->transaction, job->rom_id, job->param, 1);
+		job->state = DS2408_JOB_RESULT;
+		return DALLAS_PENDING;
+	case DS2408_JOB_RESULT:
+		*(u08 *) job->result = job->transaction.data[job->transaction.read_index];
+		break;
+	}
 	return DALLAS_NO_ERROR;
 }
 
+u08	ds2408_write_register(dallas_bus_T *bus, dallas_rom_id_T *id, u08 address, u08 data)
+{
+	dallas_transaction_T transaction;
+	dallasTransactionInit(&transaction);
+	dallasTransactionSelect(&transaction, id);
+	dallasTransactionWrite(&transaction, WRITE_REGISTER);
+	dallasTransactionWrite(&transaction, address);
+	dallasTransactionWrite(&transaction, ADR_NULL);
+	dallasTransactionWrite(&transaction, data);
+	return dallasTransactionExecute(bus, &transaction);
+}
+
 // **********************************************************************************
 /// \brief  	DS2408 Ausgaenge setzen (Channel Access Write)
 /// @param[in]  data 8-Bit data
 ///
 // **********************************************************************************
-u08 ds2408_write_output(dallas_rom_id_T *id, unsigned char data)
+u08 ds2408_write_output(dallas_bus_T *bus, dallas_rom_id_T *id, unsigned char data)
 {
+	dallas_transaction_T transaction;
+	u08 index;
 #ifdef DS2408_BUFFER
 	if (ds2408_buffer==data)
 		return DALLAS_NO_ERROR;
 	else
 		ds2408_buffer = data;
 #endif
-	dallasBufferEnabled(1);
 	// channel-access-write
-	DALLAS_CHECK(dallasCommand((dallas_rom_id_T *)&id[0], CAW));
-	W1_WRITE(data);			// write byte to PIO
-	W1_WRITE(~data);		// write inverted byte to PIO
-	dallasBufferEnabled(0);
+	dallasTransactionInit(&transaction);
+	dallasTransactionSelect(&transaction, id);
+	dallasTransactionWrite(&transaction, CAW);
+	dallasTransactionWrite(&transaction, data);			// write byte to PIO
+	dallasTransactionWrite(&transaction, ~data);		// write inverted byte to PIO
+	index = dallasTransactionRead(&transaction, 1);	// confirmation byte
+	DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+	if (transaction.data[index] != CAW_CONFIRMATION)
+		return DALLAS_VERIFY_ERROR;
 	return DALLAS_NO_ERROR;
 }
 
@@ -94,18 +203,12 @@ u08 ds2408_write_output(dallas_rom_id_T *id, unsigned char data)
 /// @return  	8-Bit Data Status
 ///
 // **********************************************************************************
-u08 ds2408_read_output(dallas_rom_id_T *id, u08 *result)
+u08 ds2408_read_output(dallas_bus_T *bus, dallas_rom_id_T *id, u08 *result)
 {
 #ifdef DS2408_BUFFER
 	*result = ds2408_buffer;
 #else
-	dallasBufferEnabled(1);
-	DALLAS_CHECK(dallasCommand((dallas_rom_id_T *)&id[0], READ_PIO));
-	W1_WRITE(OUT_LATCH_STATE);
-	W1_WRITE(ADR_NULL);
-	dallasBufferRead(1);
-	*result = W1_READ();	// read PIO Output Latch State Register
-	dallasBufferEnabled(0);
+	DALLAS_CHECK(ds2408_read_register(bus, id, OUT_LATCH_STATE, result));	// read PIO Output Latch State Register
 #endif
 	return DALLAS_NO_ERROR;
 }
@@ -116,31 +219,70 @@ u08 ds2408_read_output(dallas_rom_id_T *id, u08 *result)
 /// @return  	8-Bit data
 ///
 // **********************************************************************************
-u08 ds2408_read_input(dallas_rom_id_T *id, u08 *result)
+u08 ds2408_read_input(dallas_bus_T *bus, dallas_rom_id_T *id, u08 *result)
 {
-	dallasBufferEnabled(1);
-	DALLAS_CHECK(dallasCommand((dallas_rom_id_T *)&id[0], READ_PIO));
-	W1_WRITE(LOGIC_STATE);
-	W1_WRITE(ADR_NULL);
-	dallasBufferRead(1);
-	*result = W1_READ();
-	dallasBufferEnabled(0);
+	return ds2408_read_register(bus, id, LOGIC_STATE, result);
+}
+
+
+// **********************************************************************************
+/// \brief  	DS2408 Eingaenge lesen als Job, siehe dallasJobRun()
+/// @return  	8-Bit data
+///
+// **********************************************************************************
+void ds2408_read_input_job(dallas_job_T *job, dallas_rom_id_T *id, u08 *result)
+{
+	dallasJobInit(job, ds2408_step, id, result);
+	job->param = LOGIC_STATE;
+}
+
+
+// **********************************************************************************
+/// \brief  	DS2408 fuer Conditional Search vorbereiten: der Baustein antwortet,
+///				wenn ein Activity Latch gesetzt ist, die Latches werden zurueckgesetzt
+/// @return  	Fehlercode
+///
+// **********************************************************************************
+u08 ds2408_arm_activity_search(dallas_bus_T *bus, dallas_rom_id_T *id)
+{
+	dallas_transaction_T transaction;
+	u08 control;
+	DALLAS_CHECK(ds2408_read_register(bus, id, CONTROL_STATUS, &control));
+	ds2408_transaction_arm(&transaction, id, ACTIVITY_SEARCH(control));
+	DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+	ds2408_transaction_reset_activity(&transaction, id);
+	DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+	if (transaction.data[transaction.read_index] != RESET_CONFIRMATION)
+		return DALLAS_VERIFY_ERROR;
 	return DALLAS_NO_ERROR;
 }
 
 
+// **********************************************************************************
+/// \brief  	DS2408 Eingaenge lesen als Job nach Conditional Search: setzt die
+///				Activity Latches zurueck und liest dann die Eingaenge, siehe
+///				ds2408_arm_activity_search()
+/// @return  	8-Bit data
+///
+// **********************************************************************************
+void ds2408_read_activity_job(dallas_job_T *job, dallas_rom_id_T *id, u08 *result)
+{
+	dallasJobInit(job, ds2408_activity_step, id, result);
+}
+
+
 // **********************************************************************************
 /// \brief  	Mehrere Bit am DS2408 auf vorgegebenen Wert schreiben (setzen+lschen)
 /// @param[in] 	bitmask - Bitmaske fr die Bits, die beeinflusst werden sollen
 /// @param[in] 	value - neuer Wert fr die Bits -> bitmask
 // **********************************************************************************
-u08 ds2408_write_bits(dallas_rom_id_T *id, unsigned char bitmask, unsigned char value)
+u08 ds2408_write_bits(dallas_bus_T *bus, dallas_rom_id_T *id, unsigned char bitmask, unsigned char value)
 {
 	unsigned char pattern;
-	DALLAS_CHECK(ds2408_read_output(id, &pattern));
+	DALLAS_CHECK(ds2408_read_output(bus, id, &pattern));
 	pattern &= ~bitmask;		// alten Wert lschen
 	pattern |= value;			// neuen Wert einspielen
-	return ds2408_write_output(id, pattern);
+	return ds2408_write_output(bus, id, pattern);
 }
 
 
@@ -149,12 +291,12 @@ u08 ds2408_write_bits(dallas_rom_id_T *id, unsigned char bitmask, unsigned char
 /// @param[in] 	bitmask - Bitmaske fr die Bits, die gesetzt werden sollen
 ///
 // **********************************************************************************
-u08 ds2408_set_bits(dallas_rom_id_T *id, unsigned char bitmask)
+u08 ds2408_set_bits(dallas_bus_T *bus, dallas_rom_id_T *id, unsigned char bitmask)
 {
 	unsigned char pattern;
-	DALLAS_CHECK(ds2408_read_output(id, &pattern));
+	DALLAS_CHECK(ds2408_read_output(bus, id, &pattern));
 	pattern |= bitmask;
-	return ds2408_write_output(id, pattern);
+	return ds2408_write_output(bus, id, pattern);
 }
 
 
@@ -163,12 +305,12 @@ u08 ds2408_set_bits(dallas_rom_id_T *id, unsigned char bitmask)
 /// @param[in] 	bitmask - Bitmaske fr die Bits, die gelscht werden sollen
 ///
 // **********************************************************************************
-u08 ds2408_clear_bits(dallas_rom_id_T *id, unsigned char bitmask)
+u08 ds2408_clear_bits(dallas_bus_T *bus, dallas_rom_id_T *id, unsigned char bitmask)
 {
 	unsigned char pattern;
-	DALLAS_CHECK(ds2408_read_output(id, &pattern));
+	DALLAS_CHECK(ds2408_read_output(bus, id, &pattern));
 	pattern &= ~bitmask;
-	return ds2408_write_output(id, pattern);
+	return ds2408_write_output(bus, id, pattern);
 }
 
 #ifdef	__cplusplus
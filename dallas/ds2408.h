@@ -45,11 +45,17 @@
 #define SKIP_ROM			0xCC	// skip rom command
 #define READ_PIO			0xF0    // read pio registers command
 #define CAW					0x5A	// channel-access-write command
+#define CAW_CONFIRMATION	0xAA	// answer to successful channel-access-write
 #define WRITE_REGISTER		0xCC	// write conditional search register
+#define RESET_ACTIVITY		0xC3	// reset activity latches command
+#define RESET_CONFIRMATION	0xAA	// answer to reset activity latches
 
 //DS2408 target addresses
 #define LOGIC_STATE			0x88	// address of PIO Logic State Register
 #define OUT_LATCH_STATE		0x89	// address of PIO Output Latch State Register
+#define ACTIVITY_LATCH		0x8A	// address of PIO Activity Latch State Register
+#define CS_CHANNEL_MASK		0x8B	// address of Conditional Search Channel Selection Mask Register
+#define CS_POLARITY			0x8C	// address of Conditional Search Channel Polarity Selection Register
 #define CONTROL_STATUS		0x8D	// address of Control/Status Register
 #define ADR_NULL			0x00
 
@@ -71,13 +77,16 @@
 extern "C" {
 #endif
 
-extern u08	ds2408_write_register(dallas_rom_id_T *id, u08 address, u08 data);
-extern u08	ds2408_write_output(dallas_rom_id_T *id, unsigned char data);
-extern u08	ds2408_read_output(dallas_rom_id_T *id, u08 *result);
-extern u08	ds2408_read_input(dallas_rom_id_T *id, u08 *result);
-extern u08	ds2408_write_bits(dallas_rom_id_T *id, unsigned char bitmask, unsigned char value);
-extern u08	ds2408_set_bits(dallas_rom_id_T *id, unsigned char bitmask);
-extern u08	ds2408_clear_bits(dallas_rom_id_T *id, unsigned char bitmask);
+extern u08	ds2408_write_register(dallas_bus_T *bus, dallas_rom_id_T *id, u08 address, u08 data);
+extern u08	ds2408_write_output(dallas_bus_T *bus, dallas_rom_id_T *id, unsigned char data);
+extern u08	ds2408_read_output(dallas_bus_T *bus, dallas_rom_id_T *id, u08 *result);
+extern u08	ds2408_read_input(dallas_bus_T *bus, dallas_rom_id_T *id, u08 *result);
+extern void	ds2408_read_input_job(dallas_job_T *job, dallas_rom_id_T *id, u08 *result);
+extern u08	ds2408_arm_activity_search(dallas_bus_T *bus, dallas_rom_id_T *id);
+extern void	ds2408_read_activity_job(dallas_job_T *job, dallas_rom_id_T *id, u08 *result);
+extern u08	ds2408_write_bits(dallas_bus_T *bus, dallas_rom_id_T *id, unsigned char bitmask, unsigned char value);
+extern u08	ds2408_set_bits(dallas_bus_T *bus, dallas_rom_id_T *id, unsigned char bitmask);
+extern u08	ds2408_clear_bits(dallas_bus_T *bus, dallas_rom_id_T *id, unsigned char bitmask);
 
 #ifdef	__cplusplus
 };
@@ -29,13 +29,118 @@ static void ds2450_strupr(u08 *s)
  *-------------------------------------------------------------------------*/
 static u08 ds2450Chan2Addr(u08 channel, u08 page, u16 *address);
 
-void ds2450Init(void)
+/*--------------------------------------------------------------------------
+ * ds2450TransactionConvert: queues the convert command
+ * input..................... rom_id - device to select or 0 to skip rom
+ *                            mask - input select mask
+ *                            readout - read-out control
+ *-------------------------------------------------------------------------*/
+static void ds2450TransactionConvert(dallas_transaction_T *transaction, dallas_rom_id_T* rom_id, u08 mask, u08 readout);
+
+// states of ds2450 jobs
+#define DS2450_JOB_START			0
+#define DS2450_JOB_WAIT				1
+#define DS2450_JOB_CONVERSION		2
+#define DS2450_JOB_READ				3
+#define DS2450_JOB_RESULT			4
+
+/*--------------------------------------------------------------------------
+ * ds2450Convert: starts conversion
+ * input......... rom_id - device to select or 0 to skip rom
+ *                mask - input select mask
+ *                readout - read-out control
+ * returns....... the corresponding error or DALLAS_NO_ERROR
+ *-------------------------------------------------------------------------*/
+static u08 ds2450Convert(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 mask, u08 readout)
+{
+	dallas_transaction_T transaction;
+
+	ds2450TransactionConvert(&transaction, rom_id, mask, readout);
+	DALLAS_CHECK(dallasTransactionExecute(bus, &transaction));
+
+	// if CRC is not valid, no one is paying attention
+	return dallasTransactionCheckCRC16(&transaction, transaction.select_size, 3);
+}
+
+static void ds2450TransactionConvert(dallas_transaction_T *transaction, dallas_rom_id_T* rom_id, u08 mask, u08 readout)
 {
+	// reset and select node
+	dallasTransactionInit(transaction);
+	dallasTransactionSelect(transaction, rom_id);
+
+	// send convert command with input select mask and read-out control
+	dallasTransactionWrite(transaction, DS2450_CONVERT);
+	dallasTransactionWrite(transaction, mask);
+	dallasTransactionWrite(transaction, readout);
+
+	// we must read 2byte CRC16 to start the conversion
+	dallasTransactionRead(transaction, 2);
+}
+
+// convert, wait for the conversion and read the data page, see ds2450StartAndResultAllJob()
+// job->param is the channel [A-D] or 0 for all channels
+static u08 ds2450Step(dallas_job_T *job)
+{
+	u08 data[8];
+	u08 i, mask;
+	u16 address;
+
+	DALLAS_CHECK(job->error);
+	switch (job->state) {
+	case DS2450_JOB_START:
+		if (job->rom_id)
+			DALLAS_CHECK(dallasAddressCheck(job->rom_id, DS2450_FAMILY));
+		if (job->param) {
+			// input select mask and read-out control of the channel
+			DALLAS_CHECK(ds2450Chan2Addr(job->param, DS2450_DATA_PAGE, &address));
+			mask = 0x01 << (address >> 1);
+			ds2450TransactionConvert(&job->transaction, (job->flags & DALLAS_JOB_START_ALL) ? 0 : job->rom_id,
+				mask, mask << (address >> 1));
+		} else {
+			ds2450TransactionConvert(&job->transaction, (job->flags & DALLAS_JOB_START_ALL) ? 0 : job->rom_id,
+				DS2450_CONVERT_ALL4_MASK, DS2450_CLEAR_ALL4_MASK);
+		}
+		job->state = DS2450_JOB_WAIT;
+		return DALLAS_PENDING;
+	case DS2450_JOB_WAIT:
+		// if CRC is not valid, no one is paying attention
+		DALLAS_CHECK(dallasTransactionCheckCRC16(&job->transaction, job->transaction.select_size, 3));
+		job->state = DS2450_JOB_CONVERSION;
+		// fall through
+	case DS2450_JOB_CONVERSION:
+		DALLAS_CHECK(dallasJobWaitConversion(job));
+		if (!job->result)
+			break;
+		job->state = DS2450_JOB_READ;
+		// fall through
+	case DS2450_JOB_READ:
+		DALLAS_CHECK(dallasAddressCheck(job->rom_id, DS2450_FAMILY));
+		address = DS2450_DATA_PAGE;
+		if (job->param)
+			DALLAS_CHECK(ds2450Chan2Addr(job->param, DS2450_DATA_PAGE, &address));
+		dallasTransactionReadRAM(&job->transaction, job->rom_id, address, job->param ? 2 : 8);
+		job->state = DS2450_JOB_RESULT;
+		return DALLAS_PENDING;
+	case DS2450_JOB_RESULT:
+		address = DS2450_DATA_PAGE;
+		if (job->param)
+			DALLAS_CHECK(ds2450Chan2Addr(job->param, DS2450_DATA_PAGE, &address));
+		DALLAS_CHECK(dallasTransactionReadRAMResult(&job->transaction, address, job->param ? 2 : 8, data));
+		for (i = 0; i < (job->param ? 2 : 8); i += 2)
+			((u16 *) job->result)[i >> 1] = ((u16)data[i + 1] << 8) | data[i];
+		break;
+	}
+	return DALLAS_NO_ERROR;
+}
+
+void ds2450Init(dallas_bus_T *bus)
+{
+	(void) bus;
 	// initialize the dallas 1-wire
 	// dallasInit();
 }
 
-u08 ds2450Setup(dallas_rom_id_T* rom_id, u08 channel, u08 resolution, u08 range)
+u08 ds2450Setup(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel, u08 resolution, u08 range)
 {
 	u08 data[2];
 	u16 address;
@@ -56,13 +161,13 @@ u08 ds2450Setup(dallas_rom_id_T* rom_id, u08 channel, u08 resolution, u08 range)
 		resolution = 0x00;
 
 	// read in current digital output settings
-	DALLAS_CHECK(dallasReadRAM(rom_id, address, 1, data));
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, address, 1, data));
 
 	data[0] = (data[0] & 0xF0) | resolution;	// maintain digital output portion and add new resolution
 	data[1] = (data[1] & 0xFE) | range;			// maintain alarm states and add new range
 
 	// actually write config, handles CRC too
-	DALLAS_CHECK(dallasWriteRAM(rom_id, address, 2, data));
+	DALLAS_CHECK(dallasWriteRAM(bus, rom_id, address, 2, data));
 
 	// Normally, the DS2450 is designed to run off of parasite power from the data line
 	// Typically the master (us) strongly pulls high long enough to power the conversion, so
@@ -70,10 +175,10 @@ u08 ds2450Setup(dallas_rom_id_T* rom_id, u08 channel, u08 resolution, u08 range)
 	// work for devices that use external power, we can elliminate this delay by writting
 	// the following byte per the DS2450 datasheet.
 	data[0] = DS2450_VCC_FLAG;
-	DALLAS_CHECK(dallasWriteRAM(rom_id, DS2450_VCC_ADDR, 1, &data[0]));
+	DALLAS_CHECK(dallasWriteRAM(bus, rom_id, DS2450_VCC_ADDR, 1, &data[0]));
 
 	// verify the data
-	DALLAS_CHECK(dallasReadRAM(rom_id, address, 2, data));
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, address, 2, data));
 
 	if ((data[0] & 0x0F) != resolution)
 		return DALLAS_VERIFY_ERROR;
@@ -83,10 +188,9 @@ u08 ds2450Setup(dallas_rom_id_T* rom_id, u08 channel, u08 resolution, u08 range)
 	return DALLAS_NO_ERROR;
 }
 
-u08 ds2450Start(dallas_rom_id_T* rom_id, u08 channel)
+u08 ds2450Start(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel)
 {
 	u08 mask;
-	u16 crc = 0;
 	
 	DALLAS_CHECK(dallasAddressCheck(rom_id, DS2450_FAMILY));	// check address
 
@@ -100,39 +204,11 @@ u08 ds2450Start(dallas_rom_id_T* rom_id, u08 channel)
 	// shift over to construct input select mask
 	mask = 0x01 << channel;
 
-	dallasBufferEnabled(1);
-
-	// reset and select node
-	DALLAS_CHECK(dallasMatchROM(rom_id));
-
-	// send convert command
-	dallasWriteByte(DS2450_CONVERT);
-	crc = crc16_update(crc, DS2450_CONVERT);
-	// input select mask
-	dallasWriteByte(mask);
-	crc = crc16_update(crc, mask);
-	// shift over some more for "read-out" control
-	mask = mask << channel;
-	
-	// set coresponding output buffer to zero	
-	dallasWriteByte(mask);
-	crc = crc16_update(crc, mask);
-
-	dallasBufferRead(2);
-	// we must read 2byte CRC16 to start the conversion:
-	crc ^= dallasReadByte();
-	crc ^= dallasReadByte() << 8;
-
-	dallasBufferEnabled(0);
-
-	//replace with explicit CRC posibilities lookup table
-	if (crc)
-		return DALLAS_CRC_ERROR;        //if CRC is not zero, no one is paying attention
-
-	return DALLAS_NO_ERROR;
+	// shift over some more for "read-out" control, set coresponding output buffer to zero
+	return ds2450Convert(bus, rom_id, mask, mask << channel);
 }
 
-u08 ds2450Result(dallas_rom_id_T* rom_id, u08 channel, u16* result)
+u08 ds2450Result(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel, u16* result)
 {
 	u08 data[2];
 	u16 address;
@@ -142,10 +218,10 @@ u08 ds2450Result(dallas_rom_id_T* rom_id, u08 channel, u16* result)
 
 	ds2450_strupr(&channel);
 	DALLAS_CHECK(ds2450Chan2Addr(channel, DS2450_DATA_PAGE, &address));		// get the RAM address for the data for the channel
-	DALLAS_CHECK(dallasReadRAM(rom_id, address, 2, data));					// read the RAM from the device to get the data
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, address, 2, data));					// read the RAM from the device to get the data
 	// get the address for the setup for the channel
 	DALLAS_CHECK(ds2450Chan2Addr(channel, DS2450_SETUP_PAGE, &address)); 	//find starting address
-	DALLAS_CHECK(dallasReadRAM(rom_id, address, 1, &resolution));			// read the RAM from the device to get the resolution
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, address, 1, &resolution));			// read the RAM from the device to get the resolution
 
 	// get the resultion part of the data
 	resolution &=0x0F;
@@ -160,21 +236,30 @@ u08 ds2450Result(dallas_rom_id_T* rom_id, u08 channel, u16* result)
 	return DALLAS_NO_ERROR;
 }
 
-u08 ds2450StartAndResult(dallas_rom_id_T* rom_id, u08 channel, u16 *result)
+u08 ds2450StartAndResult(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel, u16 *result)
 {
-	DALLAS_CHECK(ds2450Start(rom_id, channel));	// start conversion
-	dallasWaitUntilDone();						// wait till conversion done
-	return ds2450Result(rom_id, channel, result);
+	dallas_job_T job;
+	ds2450StartAndResultJob(&job, rom_id, channel, result);
+	return dallasJobExecute(bus, &job);
 }
 
-u08 ds2450SetupAll(dallas_rom_id_T* rom_id, u08 resolution, u08 range)
+void ds2450StartAndResultJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u08 channel, u16 *result)
+{
+	dallasJobInit(job, ds2450Step, rom_id, result);
+	ds2450_strupr(&channel);
+	job->param = channel;
+	// setup functions make the converters VCC powered
+	job->flags |= DALLAS_JOB_POLL_DONE;
+}
+
+u08 ds2450SetupAll(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 resolution, u08 range)
 {
 	u08 res[4] = {resolution, resolution, resolution, resolution};
 	u08 rng[4] = {range, range, range, range};
-	return ds2450WriteAllSettings(rom_id, res, rng, 0);
+	return ds2450WriteAllSettings(bus, rom_id, res, rng, 0);
 }
 
-u08 ds2450WriteAllSettings(dallas_rom_id_T* rom_id, u08 *resolution, u08 *range, u08 *digital_output)
+u08 ds2450WriteAllSettings(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *resolution, u08 *range, u08 *digital_output)
 {
 	u08 i;
 	u08 data[8];
@@ -197,7 +282,7 @@ u08 ds2450WriteAllSettings(dallas_rom_id_T* rom_id, u08 *resolution, u08 *range,
 	}
 	
 	DALLAS_CHECK(ds2450Chan2Addr('A', DS2450_SETUP_PAGE, &address));	// get address - start with channel A
-	DALLAS_CHECK(dallasReadRAM(rom_id, address, 8, data));				// read in current settings so we can extract digital part
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, address, 8, data));				// read in current settings so we can extract digital part
 
 	// build up config data to write - increment by 2 b/c two bytes per channel
 	for (i = 0; i < 8; i += 2) { 
@@ -216,7 +301,7 @@ u08 ds2450WriteAllSettings(dallas_rom_id_T* rom_id, u08 *resolution, u08 *range,
 	}
 
 	// actually write config - handles CRC too
-	DALLAS_CHECK(dallasWriteRAM(rom_id, address, 8, data));
+	DALLAS_CHECK(dallasWriteRAM(bus, rom_id, address, 8, data));
 
 	// Normally, the DS2450 is designed to run off of parasite power from the data line
 	// Typically the master (us) strongly pulls high long enough to power the conversion, so
@@ -224,12 +309,12 @@ u08 ds2450WriteAllSettings(dallas_rom_id_T* rom_id, u08 *resolution, u08 *range,
 	// work for devices that use external power, we can elliminate this delay by writting
 	// the following byte per the DS2450 datasheet.
 	data[0] = DS2450_VCC_FLAG;
-	DALLAS_CHECK(dallasWriteRAM(rom_id, DS2450_VCC_ADDR, 1, &data[0]));
+	DALLAS_CHECK(dallasWriteRAM(bus, rom_id, DS2450_VCC_ADDR, 1, &data[0]));
 
 	return DALLAS_NO_ERROR;
 }
 
-u08 ds2450ReadAllSettings(dallas_rom_id_T* rom_id, u08 *resolution, u08 *range, u08 *digital_output)
+u08 ds2450ReadAllSettings(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *resolution, u08 *range, u08 *digital_output)
 {
 	u08 i;
 	u08 data[8];
@@ -237,7 +322,7 @@ u08 ds2450ReadAllSettings(dallas_rom_id_T* rom_id, u08 *resolution, u08 *range,
 
 	DALLAS_CHECK(dallasAddressCheck(rom_id, DS2450_FAMILY));			// check address
 	DALLAS_CHECK(ds2450Chan2Addr('A', DS2450_SETUP_PAGE, &address));	// get address - start with channel A
-	DALLAS_CHECK(dallasReadRAM(rom_id, address, 8, data));				// read in current settings so we can extract digital part
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, address, 8, data));				// read in current settings so we can extract digital part
 
 	// analyze config data - increment by 2 b/c two bytes per channel
 	for(i=0;i<8;i+= 2) { 
@@ -257,36 +342,58 @@ u08 ds2450ReadAllSettings(dallas_rom_id_T* rom_id, u08 *resolution, u08 *range,
 	return DALLAS_NO_ERROR;
 }
 
-u08 ds2450StartAll(dallas_rom_id_T* rom_id)
+u08 ds2450ReadAlarms(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *alarm_low, u08 *alarm_high)
 {
-	u16 crc = 0;
+	u08 i;
+	u08 data[8];
 
-	DALLAS_CHECK(dallasAddressCheck(rom_id, DS2450_FAMILY));	// check address
-	dallasBufferEnabled(1);
-	DALLAS_CHECK(dallasMatchROM(rom_id));						// reset and select node
+	DALLAS_CHECK(dallasAddressCheck(rom_id, DS2450_FAMILY));			// check address
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, DS2450_ALARM_PAGE, 8, data));
 
-	dallasWriteByte(DS2450_CONVERT);				// send convert command
-	dallasWriteByte(DS2450_CONVERT_ALL4_MASK);  	// select all 4 inputs
-	dallasWriteByte(DS2450_CLEAR_ALL4_MASK);		// set all output buffers to zero
+	// low and high levels of each channel follow each other
+	for (i = 0; i < 4; ++i) {
+		alarm_low[i] = data[i * 2];
+		alarm_high[i] = data[i * 2 + 1];
+	}
 
-	crc = crc16_update(crc, DS2450_CONVERT);
-	crc = crc16_update(crc, DS2450_CONVERT_ALL4_MASK);
-	crc = crc16_update(crc, DS2450_CLEAR_ALL4_MASK);
+	return DALLAS_NO_ERROR;
+}
+
+u08 ds2450WriteAlarms(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *alarm_low, u08 *alarm_high)
+{
+	u08 i;
+	u08 data[8];
 
-	dallasBufferRead(2);
-	crc = ~crc;
-	// we must read 2byte CRC16 to start the conversion:
-	crc ^= dallasReadByte();
-	crc ^= dallasReadByte() << 8;
-	dallasBufferEnabled(0);
+	DALLAS_CHECK(dallasAddressCheck(rom_id, DS2450_FAMILY));			// check address
+	for (i = 0; i < 4; ++i) {
+		data[i * 2] = alarm_low[i];
+		data[i * 2 + 1] = alarm_high[i];
+	}
+	DALLAS_CHECK(dallasWriteRAM(bus, rom_id, DS2450_ALARM_PAGE, 8, data));
 
-	if (crc)
-		return DALLAS_CRC_ERROR;
+	// enable the alarms in the setup page, writing 0 clears the power-on reset flag
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, DS2450_SETUP_PAGE, 8, data));
+	for (i = 0; i < 4; ++i) {
+		data[i * 2 + 1] &= ~(DS2450_ALARM_ENABLE_LOW | DS2450_ALARM_ENABLE_HIGH | DS2450_POR_FLAG);
+		if (alarm_low[i] != DS2450_NO_ALARM_LOW)
+			data[i * 2 + 1] |= DS2450_ALARM_ENABLE_LOW;
+		if (alarm_high[i] != DS2450_NO_ALARM_HIGH)
+			data[i * 2 + 1] |= DS2450_ALARM_ENABLE_HIGH;
+	}
+	DALLAS_CHECK(dallasWriteRAM(bus, rom_id, DS2450_SETUP_PAGE, 8, data));
 
 	return DALLAS_NO_ERROR;
 }
 
-u08 ds2450ResultAll(dallas_rom_id_T* rom_id, u16 result[4])
+u08 ds2450StartAll(dallas_bus_T *bus, dallas_rom_id_T* rom_id)
+{
+	DALLAS_CHECK(dallasAddressCheck(rom_id, DS2450_FAMILY));	// check address
+
+	// select all 4 inputs and set all output buffers to zero
+	return ds2450Convert(bus, rom_id, DS2450_CONVERT_ALL4_MASK, DS2450_CLEAR_ALL4_MASK);
+}
+
+u08 ds2450ResultAll(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 result[4])
 {
 	u08 bytes_to_read = 8;                  // read 8bytes = 2bytes/ch*4ch, 2 additional bytes of CRC16 read and checked in dallasReadRam)
 	u08 i;
@@ -297,10 +404,10 @@ u08 ds2450ResultAll(dallas_rom_id_T* rom_id, u16 result[4])
 
 	DALLAS_CHECK(dallasAddressCheck(rom_id, DS2450_FAMILY));			// check address
 	DALLAS_CHECK(ds2450Chan2Addr('A', DS2450_DATA_PAGE, &address));		// start address with channel A
-	DALLAS_CHECK(dallasReadRAM(rom_id, address, bytes_to_read, data));	// read the conversion data
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, address, bytes_to_read, data));	// read the conversion data
 
 	//DALLAS_CHECK(ds2450Chan2Addr('A', DS2450_SETUP_PAGE, &address));	// start address with channel A
-	//DALLAS_CHECK(dallasReadRAM(rom_id, address, bytes_to_read, resolution));	// read the resolution data
+	//DALLAS_CHECK(dallasReadRAM(bus, rom_id, address, bytes_to_read, resolution));	// read the resolution data
 
 	// store the result by combining the 2 bytes
 	// the result's MSB is always the same, so we may need to
@@ -320,11 +427,29 @@ u08 ds2450ResultAll(dallas_rom_id_T* rom_id, u16 result[4])
 	return DALLAS_NO_ERROR;
 }
 
-u08 ds2450StartAndResultAll(dallas_rom_id_T* rom_id, u16 result[4])
+u08 ds2450StartAndResultAll(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 result[4])
+{
+	dallas_job_T job;
+	ds2450StartAndResultAllJob(&job, rom_id, result);
+	return dallasJobExecute(bus, &job);		// return any error - results passed by reference
+}
+
+void ds2450StartAndResultAllJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u16 result[4])
+{
+	dallasJobInit(job, ds2450Step, rom_id, result);
+	job->flags |= DALLAS_JOB_POLL_DONE;
+}
+
+void ds2450StartAllJob(dallas_job_T *job, dallas_rom_id_T* rom_id)
+{
+	dallasJobInit(job, ds2450Step, rom_id, 0);
+	job->flags |= DALLAS_JOB_POLL_DONE;
+}
+
+void ds2450ResultAllJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u16 result[4])
 {
-	DALLAS_CHECK(ds2450StartAll(rom_id));	// start Conversion
-	dallasWaitUntilDone();					// wait until conversion done
-	return ds2450ResultAll(rom_id, result);	// return any error - results passed by reference
+	dallasJobInit(job, ds2450Step, rom_id, result);
+	job->state = DS2450_JOB_READ;
 }
 
 //void ds2450Print(u16 result, u08 range)
@@ -347,21 +472,21 @@ u08 ds2450StartAndResultAll(dallas_rom_id_T* rom_id, u16 result[4])
 //	rprintfProgStrM(" Volts");
 //}
 
-u08 ds2450DigitalOut(dallas_rom_id_T* rom_id, u08 channel, dallas_a2d_out_T state)
+u08 ds2450DigitalOut(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel, dallas_a2d_out_T state)
 {
 	u08 old_resolution;
 	u16 address;
 
 	DALLAS_CHECK(dallasAddressCheck(rom_id, DS2450_FAMILY));				// check address
 	DALLAS_CHECK(ds2450Chan2Addr(channel, DS2450_SETUP_PAGE, &address));	// get the address for the channel in the setup page
-	DALLAS_CHECK(dallasReadRAM(rom_id, address, 1, &old_resolution));		// read in current resolution
+	DALLAS_CHECK(dallasReadRAM(bus, rom_id, address, 1, &old_resolution));		// read in current resolution
 	
 	// extract resolution portion
 	old_resolution &= 0x0F;
 
 	// write new setup byte
 	state |= old_resolution;
-	DALLAS_CHECK(dallasWriteRAM(rom_id, address, 1, ((u08*)&state)));
+	DALLAS_CHECK(dallasWriteRAM(bus, rom_id, address, 1, ((u08*)&state)));
 
 	return DALLAS_NO_ERROR;
 }
@@ -27,6 +27,17 @@
 #define DS2450_VCC_FLAG				0x40
 #define DS2450_VCC_ADDR				0x1C
 
+// alarm enable and flag bits of the second setup byte of each channel
+#define DS2450_ALARM_ENABLE_LOW		0x04
+#define DS2450_ALARM_ENABLE_HIGH	0x08
+#define DS2450_ALARM_FLAG_LOW		0x10
+#define DS2450_ALARM_FLAG_HIGH		0x20
+#define DS2450_POR_FLAG				0x80	// power-on reset, the converter answers CONDITIONAL SEARCH
+
+// alarm levels compare the most significant byte of the result, these never alarm
+#define DS2450_NO_ALARM_LOW			0x00
+#define DS2450_NO_ALARM_HIGH		0xFF
+
 // maximum allowable resolution
 #define DS2450_RES_MAX				16
 #define DS2450_RES_DO_NOT_CHANGE	0xFF	// don't change resolution for channel
@@ -57,7 +68,7 @@ extern "C" {
 
 // ds2450Init()
 //     initializes the dallas 1-wire bus
-void ds2450Init(void);
+void ds2450Init(dallas_bus_T *bus);
 
 //----- Single Channel Functions ----------------------------------------------
 // The following 4 functions are used for controlling a single channel on the
@@ -73,24 +84,24 @@ void ds2450Init(void);
 //     Sets up the given device, for the given channel [A-D],
 //     the given resolution [1-16] and the given range 0-2.55 or 0-5.10
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08  ds2450Setup(dallas_rom_id_T* rom_id, u08 channel, u08 resolution, u08 range);
+u08  ds2450Setup(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel, u08 resolution, u08 range);
 
 // ds2450Start()
 //     Starts the a2d conversion for the given device and the given channel [A-D]
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08  ds2450Start(dallas_rom_id_T* rom_id, u08 channel);
+u08  ds2450Start(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel);
 
 // ds2450Result()
 //     Gets the result from the a2d conversion
 //     for the given device and the given channel [A-D]
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08  ds2450Result(dallas_rom_id_T* rom_id, u08 channel, u16* result);
+u08  ds2450Result(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel, u16* result);
 
 // ds2450StartAndResult()
 //     Starts the conversion of the given device and the given channel [A-D]
 //     Stores the result in the variable result
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08  ds2450StartAndResult(dallas_rom_id_T* rom_id, u08 channel, u16 *result);
+u08  ds2450StartAndResult(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel, u16 *result);
 
 //----- All Channel Functions -------------------------------------------------
 // The following 4 commands are used to access data from all 4 channels on the
@@ -105,37 +116,77 @@ u08  ds2450StartAndResult(dallas_rom_id_T* rom_id, u08 channel, u16 *result);
 //     digital_output[i] will be set to DS2450_OUTPUT_LOW, DS2450_OUTPUT_HIGH
 //     resolution[i] will be set from 1 to 16
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds2450ReadAllSettings(dallas_rom_id_T* rom_id, u08 *resolution, u08 *range, u08 *digital_output);
+u08 ds2450ReadAllSettings(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *resolution, u08 *range, u08 *digital_output);
 
 // ds2450WriteAllSettings()
 //     Sets up the given device for all channels for the given resultions (1..16 or DS2450_RES_DO_NOT_CHANGE), 
 //     ranges [0-2.55, 0-5.10 or DS2450_RANGE_DO_NOT_CHANGE]
 //     and digital output states (low, high, DS2450_OUTPUT_DO_NOT_CHANGE)
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds2450WriteAllSettings(dallas_rom_id_T* rom_id, u08 *resolution, u08 *range, u08 *digital_output);
+u08 ds2450WriteAllSettings(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *resolution, u08 *range, u08 *digital_output);
+
+// ds2450ReadAlarms()
+//     Gets the low and high alarm levels of all channels into 4 bytes buffers
+//     Returns either the corresponding error or DALLAS_NO_ERROR
+u08 ds2450ReadAlarms(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *alarm_low, u08 *alarm_high);
+
+// ds2450WriteAlarms()
+//     Sets the low and high alarm levels of all channels from 4 bytes buffers and enables
+//     the alarms with levels other than DS2450_NO_ALARM_LOW and DS2450_NO_ALARM_HIGH,
+//     clears the power-on reset flag, after a conversion the converter answers
+//     CONDITIONAL SEARCH if the most significant byte of a result is below
+//     the low level or above the high level
+//     Returns either the corresponding error or DALLAS_NO_ERROR
+u08 ds2450WriteAlarms(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 *alarm_low, u08 *alarm_high);
 
 // ds2450SetupAll()
 //     Sets up the given device for all channels for the given resolution
 //     and the given range [0-2.55 or 0-5.10]
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds2450SetupAll(dallas_rom_id_T* rom_id, u08 resolution, u08 range);
+u08 ds2450SetupAll(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 resolution, u08 range);
 
 // ds2450StartAll()
 //     Starts the conversion for all 4 channels on the given a2d converter
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds2450StartAll(dallas_rom_id_T* rom_id);
+u08 ds2450StartAll(dallas_bus_T *bus, dallas_rom_id_T* rom_id);
 
 // ds2450ResultAll
 //     Gets the results from the given device
 //     and stores the result in the given array
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08  ds2450ResultAll(dallas_rom_id_T* rom_id, u16 result[4]);
+u08  ds2450ResultAll(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 result[4]);
 
 // ds2450StartAndResultAll()
 //     1-Step command to start the conversion for the given device,
 //     and store the results in the given array
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds2450StartAndResultAll(dallas_rom_id_T* rom_id, u16 result[4]);
+u08 ds2450StartAndResultAll(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u16 result[4]);
+
+//----- Resumable Functions -------------------------------------------------
+// The jobs do the same as StartAndResult functions but return to the caller
+// while the conversion runs, see dallasJobRun(). With DALLAS_JOB_START_ALL in
+// job flags the conversion is started on all converters of the bus by SKIP ROM.
+// The setup functions make the converters VCC powered, so the jobs come with
+// DALLAS_JOB_POLL_DONE and end the wait when read slots see the conversion done.
+
+// ds2450StartAndResultJob()
+//     Starts the conversion of the given channel [A-D], waits for it
+//     and stores the result in the variable result
+void ds2450StartAndResultJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u08 channel, u16 *result);
+
+// ds2450StartAndResultAllJob()
+//     Starts the conversion of all channels, waits for it
+//     and stores the results in the given array
+void ds2450StartAndResultAllJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u16 result[4]);
+
+// ds2450StartAllJob()
+//     Starts the conversion of all channels and waits for it, rom id 0
+//     starts all converters of the bus
+void ds2450StartAllJob(dallas_job_T *job, dallas_rom_id_T* rom_id);
+
+// ds2450ResultAllJob()
+//     Reads the results of the conversion done already into the given array
+void ds2450ResultAllJob(dallas_job_T *job, dallas_rom_id_T* rom_id, u16 result[4]);
 
 // ds2450Print()
 //     Does a formatted print on the given result for the given range
@@ -145,7 +196,7 @@ u08 ds2450StartAndResultAll(dallas_rom_id_T* rom_id, u16 result[4]);
 // ds2450DigitalOut
 //     Use the given channel of the given device as a digital out
 //     Returns either the corresponding error or DALLAS_NO_ERROR
-u08 ds2450DigitalOut(dallas_rom_id_T* rom_id, u08 channel, dallas_a2d_out_T state);
+u08 ds2450DigitalOut(dallas_bus_T *bus, dallas_rom_id_T* rom_id, u08 channel, dallas_a2d_out_T state);
 
 #ifdef	__cplusplus
 };
@@ -0,0 +1,249 @@
+// DS2480B serial 1-Wire line driver
+// The adapter is controlled with command bytes at constant host baud rate.
+// In data mode every byte written is a 1-Wire byte and the byte read back is
+// its result; 0xE3 switches to command mode, so data byte 0xE3 is doubled.
+
+//----- Include Files ---------------------------------------------------------
+#include <string.h>
+
+#include "delay.h"
+#include "dallas.h"
+#include "ds2480.h"
+
+//----- Defines ---------------------------------------------------------------
+
+#define DS2480_DATA_MODE            0xE1
+#define DS2480_COMMAND_MODE         0xE3
+#define DS2480_STOP_PULSE           0xF1
+
+// communication commands, speed bits select standard speed or overdrive
+#define DS2480_BIT                  0x81
+#define DS2480_BIT_ONE              0x10
+#define DS2480_BIT_STRONG_PULLUP    0x02    // strong pull-up after the bit
+#define DS2480_SEARCH_ON            0xB1
+#define DS2480_SEARCH_OFF           0xA1
+#define DS2480_RESET                0xC1
+#define DS2480_OVERDRIVE            0x08
+
+// reset response: presence is in two low bits
+#define DS2480_RESET_MASK           0x03
+#define DS2480_RESET_SHORT          0x00
+#define DS2480_RESET_NO_PRESENCE    0x03
+
+// configuration commands, the response is the command without bit 0
+#define DS2480_CONFIG_SLEW          0x17    // pull-down slew rate 1.37 V/us
+#define DS2480_CONFIG_WRITE1        0x45    // write 1 low time 10 us
+#define DS2480_CONFIG_SAMPLE        0x5B    // data sample offset 8 us
+#define DS2480_CONFIG_PULLUP        0x3F    // strong pull-up lasts until DS2480_STOP_PULSE
+#define DS2480_CONFIG_115200        0x77    // host baud rate 115200
+#define DS2480_READ_BAUD            0x0F    // returns host baud rate code shifted left
+#define DS2480_BAUD_9600            0x00
+#define DS2480_BAUD_115200          0x06
+
+// 1-Wire time of reset and slots, the port waits for it besides the transfer
+#define DS2480_RESET_US             1100
+#define DS2480_OVERDRIVE_RESET_US   150
+#define DS2480_SLOT_US              70
+#define DS2480_OVERDRIVE_SLOT_US    10
+
+//----- Functions ---------------------------------------------------------------
+
+#ifdef    __cplusplus
+extern "C" {
+#endif
+
+static u32 ds2480BusyTime(u08 overdrive, u08 resets, u16 slots)
+{
+    if (overdrive)
+        return resets * DS2480_OVERDRIVE_RESET_US + slots * (u32) DS2480_OVERDRIVE_SLOT_US;
+    return resets * DS2480_RESET_US + slots * (u32) DS2480_SLOT_US;
+}
+
+u08 ds2480Init(dallas_bus_T *bus, ds2480_T *adapter)
+{
+    u08 packet[6];
+
+    adapter->pulse = 0;
+
+    // break returns the adapter to 9600 baud command mode
+    DALLAS_CHECK(dallasPortSetSpeed(bus, 0));
+    dallasPortBreak(bus);
+    delay_ms(2);
+
+    // the first reset command calibrates the adapter and has no response
+    packet[0] = DS2480_RESET;
+    DALLAS_CHECK(dallasPortExchange(bus, packet, 1, 0, 0));
+    delay_ms(5);
+    dallasPortFlush(bus);
+
+    packet[0] = DS2480_CONFIG_SLEW;
+    packet[1] = DS2480_CONFIG_WRITE1;
+    packet[2] = DS2480_CONFIG_SAMPLE;
+    packet[3] = DS2480_CONFIG_PULLUP;
+    packet[4] = DS2480_READ_BAUD;
+    packet[5] = DS2480_BIT | DS2480_BIT_ONE;
+    DALLAS_CHECK(dallasPortExchange(bus, packet, 6, 6, ds2480BusyTime(0, 0, 1)));
+    if (packet[0] != (DS2480_CONFIG_SLEW & 0xFE) || packet[1] != (DS2480_CONFIG_WRITE1 & 0xFE) ||
+        packet[2] != (DS2480_CONFIG_SAMPLE & 0xFE) || packet[3] != (DS2480_CONFIG_PULLUP & 0xFE) ||
+        packet[4] != DS2480_BAUD_9600 || packet[5] != (DS2480_BIT | DS2480_BIT_ONE | 0x02))
+        return DALLAS_DEVICE_ERROR;
+
+    // the adapter answers at the new baud rate, the answer is dropped
+    packet[0] = DS2480_CONFIG_115200;
+    DALLAS_CHECK(dallasPortExchange(bus, packet, 1, 0, 0));
+    delay_ms(2);
+    DALLAS_CHECK(dallasPortSetSpeed(bus, 1));
+    delay_ms(5);
+    dallasPortFlush(bus);
+
+    packet[0] = DS2480_READ_BAUD;
+    DALLAS_CHECK(dallasPortExchange(bus, packet, 1, 1, 0));
+    if (packet[0] != DS2480_BAUD_115200)
+        return DALLAS_DEVICE_ERROR;
+
+    return DALLAS_NO_ERROR;
+}
+
+// appends bytes in data mode, returns the new packet size
+static u16 ds2480AppendData(u08 *packet, u16 size, const u08 *data, u16 count)
+{
+    packet[size++] = DS2480_DATA_MODE;
+    while (count--) {
+        if (*data == DS2480_COMMAND_MODE)
+            packet[size++] = DS2480_COMMAND_MODE;
+        packet[size++] = *data++;
+    }
+    packet[size++] = DS2480_COMMAND_MODE;
+    return size;
+}
+
+// appends STOP PULSE if strong pull-up is on and reset, returns the new packet size
+static u16 ds2480AppendReset(ds2480_T *adapter, u08 *packet, u16 size, u08 reset, u08 speed)
+{
+    if (adapter->pulse)
+        packet[size++] = DS2480_STOP_PULSE;
+    if (reset)
+        packet[size++] = DS2480_RESET | speed;
+    return size;
+}
+
+// checks responses of STOP PULSE and reset and moves index past them
+static u08 ds2480CheckReset(ds2480_T *adapter, const u08 *packet, u16 *index, u08 reset)
+{
+    if (adapter->pulse) {
+        adapter->pulse = 0;
+        (*index)++;
+    }
+    if (reset) {
+        switch (packet[(*index)++] & DS2480_RESET_MASK) {
+        case DS2480_RESET_SHORT:
+            return DALLAS_BUS_ERROR;
+        case DS2480_RESET_NO_PRESENCE:
+            return DALLAS_NO_PRESENCE;
+        }
+    }
+    return DALLAS_NO_ERROR;
+}
+
+// bytes of data sent in data mode, strong pull-up is armed by the bit command,
+// so the last byte goes as bits then
+static u16 ds2480ByteCount(u16 bit_count, u08 pullup)
+{
+    u16 byte_count = bit_count / 8;
+    if (pullup && byte_count)
+        byte_count--;
+    return byte_count;
+}
+
+u08 ds2480Prepare(ds2480_T *adapter, u08 reset, u08 overdrive, const u08 *data, u16 bit_count, u08 pullup,
+    u08 *packet, u16 *size, u16 *read_size, u32 *busy_us)
+{
+    u08 speed = overdrive ? DS2480_OVERDRIVE : 0;
+    u16 byte_count = ds2480ByteCount(bit_count, pullup);
+    u16 i;
+    u08 command;
+
+    if (2 * byte_count + (bit_count - byte_count * 8) + 4 > DS2480_PACKET_SIZE)
+        return DALLAS_OVERFLOW_ERROR;
+
+    *size = ds2480AppendReset(adapter, packet, 0, reset, speed);
+    *read_size = *size;
+    if (byte_count) {
+        *size = ds2480AppendData(packet, *size, data, byte_count);
+        *read_size += byte_count;
+    }
+    for (i = byte_count * 8; i < bit_count; i++) {
+        command = DS2480_BIT | speed;
+        if ((data[i >> 3] >> (i & 7)) & 1)
+            command |= DS2480_BIT_ONE;
+        if (pullup && i == bit_count - 1)
+            command |= DS2480_BIT_STRONG_PULLUP;
+        packet[(*size)++] = command;
+        (*read_size)++;
+    }
+    *busy_us = ds2480BusyTime(overdrive, reset, bit_count);
+
+    return DALLAS_NO_ERROR;
+}
+
+u08 ds2480Complete(ds2480_T *adapter, u08 reset, const u08 *packet, u08 *data, u16 bit_count, u08 pullup)
+{
+    u16 byte_count = ds2480ByteCount(bit_count, pullup);
+    u16 index = 0, i;
+
+    DALLAS_CHECK(ds2480CheckReset(adapter, packet, &index, reset));
+    if (byte_count) {
+        memcpy(data, &packet[index], byte_count);
+        index += byte_count;
+    }
+    for (i = byte_count * 8; i < bit_count; i++) {
+        // both low bits of the response hold the bit read
+        if (packet[index++] & 1)
+            data[i >> 3] |= 1 << (i & 7);
+        else
+            data[i >> 3] &= ~(1 << (i & 7));
+    }
+
+    if (pullup && bit_count)
+        adapter->pulse = 1;
+
+    return DALLAS_NO_ERROR;
+}
+
+u08 ds2480Exchange(dallas_bus_T *bus, ds2480_T *adapter, u08 reset, u08 overdrive, u08 *data, u16 bit_count, u08 pullup)
+{
+    u08 packet[DS2480_PACKET_SIZE];
+    u16 size, read_size;
+    u32 busy_us;
+
+    DALLAS_CHECK(ds2480Prepare(adapter, reset, overdrive, data, bit_count, pullup, packet, &size, &read_size, &busy_us));
+    DALLAS_CHECK(dallasPortExchange(bus, packet, size, read_size, busy_us));
+    return ds2480Complete(adapter, reset, packet, data, bit_count, pullup);
+}
+
+u08 ds2480Search(dallas_bus_T *bus, ds2480_T *adapter, u08 overdrive, u08 command, u08 path[16])
+{
+    u08 packet[DS2480_PACKET_SIZE];
+    u08 speed = overdrive ? DS2480_OVERDRIVE : 0;
+    u16 size, index;
+
+    size = ds2480AppendReset(adapter, packet, 0, 1, speed);
+    size = ds2480AppendData(packet, size, &command, 1);
+    packet[size++] = DS2480_SEARCH_ON | speed;
+    size = ds2480AppendData(packet, size, path, 16);
+    packet[size++] = DS2480_SEARCH_OFF | speed;
+
+    // search command byte and 64 triplets of two read slots and one write slot
+    DALLAS_CHECK(dallasPortExchange(bus, packet, size, (adapter->pulse ? 2 : 1) + 1 + 16,
+        ds2480BusyTime(overdrive, 1, 8 + 64 * 3)));
+
+    index = 0;
+    DALLAS_CHECK(ds2480CheckReset(adapter, packet, &index, 1));
+    memcpy(path, &packet[index + 1], 16);
+
+    return DALLAS_NO_ERROR;
+}
+
+#ifdef    __cplusplus
+};
+#endif
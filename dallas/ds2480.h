@@ -0,0 +1,82 @@
+// DS2480B serial 1-Wire line driver
+// dallas.c uses it instead of the UART bit slots when the bus adapter is DALLAS_ADAPTER_DS2480B
+
+#ifndef ds2480_h
+#define ds2480_h
+
+//----- Include Files ---------------------------------------------------------
+#include "types.h"
+#include "dallas.h"
+
+//----- Defines ---------------------------------------------------------------
+
+// the largest packet of commands and data sent to the adapter at once
+#define DS2480_PACKET_SIZE			(2 * DALLAS_TRANSACTION_SIZE + 16)
+
+//----- Typedefs --------------------------------------------------------------
+
+// adapter state kept in the bus context
+typedef struct ds2480_S
+{
+	u08 pulse;					// strong pull-up is on until the next command
+} ds2480_T;
+
+//----- Functions ---------------------------------------------------------------
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+// port access of dallas.c used by the line driver
+
+// dallasPortSetSpeed()
+//     sets 115200 baud if fast, 9600 baud otherwise
+u08 dallasPortSetSpeed(dallas_bus_T *bus, u08 fast);
+
+// dallasPortBreak()
+//     sends break condition to the port
+void dallasPortBreak(dallas_bus_T *bus);
+
+// dallasPortFlush()
+//     drops received bytes which were not read yet
+void dallasPortFlush(dallas_bus_T *bus);
+
+// dallasPortExchange()
+//     writes write_size bytes of buffer and reads read_size bytes back into it,
+//     busy_us is the time the adapter spends on the bus besides the port transfer
+u08 dallasPortExchange(dallas_bus_T *bus, u08 *buffer, u16 write_size, u16 read_size, u32 busy_us);
+
+// ds2480Init()
+//     calibrates the adapter after break, configures 1-Wire timing
+//     and switches the port to 115200 baud
+u08 ds2480Init(dallas_bus_T *bus, ds2480_T *adapter);
+
+// ds2480Exchange()
+//     sends optional reset, writes bit_count bits of data and replaces them with the bits read,
+//     whole bytes go in data mode, the rest as single bit commands, all in one packet;
+//     pullup turns strong pull-up on after the last bit until the next command
+//     returns DALLAS_NO_PRESENCE or DALLAS_BUS_ERROR (short circuit) if reset fails
+u08 ds2480Exchange(dallas_bus_T *bus, ds2480_T *adapter, u08 reset, u08 overdrive, u08 *data, u16 bit_count, u08 pullup);
+
+// ds2480Prepare()
+//     builds the packet of ds2480Exchange() without sending it,
+//     busy_us is the time the adapter will spend on the bus
+u08 ds2480Prepare(ds2480_T *adapter, u08 reset, u08 overdrive, const u08 *data, u16 bit_count, u08 pullup,
+	u08 *packet, u16 *size, u16 *read_size, u32 *busy_us);
+
+// ds2480Complete()
+//     checks the response of a packet built by ds2480Prepare() and stores the bits read into data
+u08 ds2480Complete(ds2480_T *adapter, u08 reset, const u08 *packet, u08 *data, u16 bit_count, u08 pullup);
+
+// ds2480Search()
+//     resets the bus and sends the search command, SEARCH ROM or CONDITIONAL SEARCH,
+//     with search accelerator on, path holds 64 pairs of bits: the direction taken
+//     on discrepancy is the odd bit of each pair,
+//     it is replaced with pairs of discrepancy flag and ROM bit found
+u08 ds2480Search(dallas_bus_T *bus, ds2480_T *adapter, u08 overdrive, u08 command, u08 path[16]);
+
+#ifdef	__cplusplus
+};
+#endif
+
+#endif
@@ -0,0 +1,141 @@
+// CRC8 and CRC16 of crc.c
+// The tables generated by the preprocessor are checked against the bit loops
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "crc.h"
+#include "dallasbench.h"
+
+#define BENCH_CRC8POLY				0x8C
+#define BENCH_CRC16POLY				0xA001
+#define BENCH_CRC_MAX_SIZE			256
+
+// the bit loops replaced by the tables
+static u08 benchCrc8UpdateOld(u08 crc, u08 next_byte)
+{
+	u16 i;
+	crc ^= next_byte;
+	for (i = 0; i < 8; ++i)
+		crc = (crc >> 1) ^ ((crc & 1) ? BENCH_CRC8POLY : 0);
+	return crc;
+}
+
+static u16 benchCrc16UpdateOld(u16 crc, u08 next_byte)
+{
+	u16 i;
+	crc ^= next_byte;
+	for (i = 0; i < 8; ++i)
+		crc = (crc >> 1) ^ ((crc & 1) ? BENCH_CRC16POLY : 0);
+	return crc;
+}
+
+static u08 benchCrc8Old(u08 *data, u16 size)
+{
+	u08 crc = 0;
+	u16 i;
+	for (i = 0; i < size; ++i)
+		crc = benchCrc8UpdateOld(crc, data[i]);
+	return crc;
+}
+
+static u16 benchCrc16Old(u08 *data, u16 size)
+{
+	u16 crc = 0;
+	u16 i;
+	for (i = 0; i < size; ++i)
+		crc = benchCrc16UpdateOld(crc, data[i]);
+	return crc;
+}
+
+// every crc and byte of the updates, every size from 0 to 256 bytes at 4 alignments
+// of the slice-by-4 words, a ROM id with its CRC byte gives 0
+int benchCrcCheck(void)
+{
+	u08 data[BENCH_CRC_MAX_SIZE + 4];
+	u08 rom_id[8] = { 0x28, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00 };
+	unsigned long crc;
+	unsigned int next_byte;
+	u16 size;
+	int offset;
+
+	for (crc = 0; crc <= 0xFF; crc++) {
+		for (next_byte = 0; next_byte <= 0xFF; next_byte++) {
+			if (crc8_update(crc, next_byte) != benchCrc8UpdateOld(crc, next_byte)) {
+				printf("crc8_update(0x%02lX, 0x%02X) differs\n", crc, next_byte);
+				return 0;
+			}
+		}
+	}
+	for (crc = 0; crc <= 0xFFFF; crc++) {
+		for (next_byte = 0; next_byte <= 0xFF; next_byte++) {
+			if (crc16_update(crc, next_byte) != benchCrc16UpdateOld(crc, next_byte)) {
+				printf("crc16_update(0x%04lX, 0x%02X) differs\n", crc, next_byte);
+				return 0;
+			}
+		}
+	}
+
+	srand(2);
+	for (size = 0; size < sizeof(data); size++)
+		data[size] = rand();
+	for (size = 0; size <= BENCH_CRC_MAX_SIZE; size++) {
+		for (offset = 0; offset < 4; offset++) {
+			if (crc8(&data[offset], size) != benchCrc8Old(&data[offset], size)) {
+				printf("crc8() differs at %u bytes, offset %d\n", size, offset);
+				return 0;
+			}
+			if (crc16(&data[offset], size) != benchCrc16Old(&data[offset], size)) {
+				printf("crc16() differs at %u bytes, offset %d\n", size, offset);
+				return 0;
+			}
+		}
+	}
+
+	rom_id[7] = benchCrc8Old(rom_id, 7);
+	if (crc8(rom_id, 8)) {
+		printf("crc8() of ROM id with its CRC is not 0\n");
+		return 0;
+	}
+	return 1;
+}
+
+// 8 bytes - ROM id, 9 bytes - DS18B20 scratchpad, 13 bytes - DS2450 page with CRC16
+void benchCrc(long rounds)
+{
+	static const int sizes[] = { 8, 9, 13, 32 };
+	u08 data[BENCH_CRC_MAX_SIZE];
+	double crc8_old, crc8_new, crc16_old, crc16_new;
+	clock_t start;
+	unsigned int i;
+	long r;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = rand();
+
+	printf("crc\n");
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		start = clock();
+		for (r = 0; r < rounds; r++)
+			bench_sink += benchCrc8Old(&data[r & 7], sizes[i]);
+		crc8_old = benchNsPerByte(start, rounds, sizes[i]);
+
+		start = clock();
+		for (r = 0; r < rounds; r++)
+			bench_sink += crc8(&data[r & 7], sizes[i]);
+		crc8_new = benchNsPerByte(start, rounds, sizes[i]);
+
+		start = clock();
+		for (r = 0; r < rounds; r++)
+			bench_sink += benchCrc16Old(&data[r & 7], sizes[i]);
+		crc16_old = benchNsPerByte(start, rounds, sizes[i]);
+
+		start = clock();
+		for (r = 0; r < rounds; r++)
+			bench_sink += crc16(&data[r & 7], sizes[i]);
+		crc16_new = benchNsPerByte(start, rounds, sizes[i]);
+
+		printf("  %3d bytes: crc8 %5.2f -> %5.2f ns/byte, crc16 %5.2f -> %5.2f ns/byte\n",
+			sizes[i], crc8_old, crc8_new, crc16_old, crc16_new);
+	}
+}
@@ -0,0 +1,135 @@
+// Slot encoding and decoding of dallasWriteBits()
+// The codecs are static, so the library source is compiled in here
+
+#include <stdio.h>
+
+#include "dallas.c"
+#include "dallasbench.h"
+
+#define BENCH_SLOTS_MAX_BITS		1024
+
+// the loops replaced by the slot table and the vectorized decode
+static void benchEncodeSlotsOld(const u08 *data, u16 bit_count, unsigned char *slots)
+{
+	u16 i;
+	for (i = 0; i < bit_count; i++)
+		slots[i] = (data[i >> 3] >> (i & 7)) & 1 ? 0xFF : 0;
+}
+
+static void benchDecodeSlotsOld(const unsigned char *slots, u16 bit_count, u08 *data)
+{
+	u16 i;
+	for (i = 0; i < bit_count; i++) {
+		if ((i & 7) == 0)
+			data[i >> 3] = 0;
+		if (slots[i] == 0xFF)
+			data[i >> 3] |= 1 << (i & 7);
+	}
+}
+
+// every length from 1 to 1024 bits at every alignment of the slots to 16 bytes,
+// read slots received low by a device (0xFE) or garbled (any value) decode to 0
+int benchSlotsCheck(void)
+{
+	static const unsigned char received[4] = { 0xFF, 0xFE, 0x00, 0x7F };
+	unsigned char old_slots[BENCH_SLOTS_MAX_BITS + 16];
+	unsigned char new_slots[BENCH_SLOTS_MAX_BITS + 16];
+	u08 data[BENCH_SLOTS_MAX_BITS / 8];
+	u08 old_data[BENCH_SLOTS_MAX_BITS / 8];
+	u08 new_data[BENCH_SLOTS_MAX_BITS / 8];
+	u16 bits, i;
+	int offset;
+
+	srand(1);
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = rand();
+
+	for (bits = 1; bits <= BENCH_SLOTS_MAX_BITS; bits++) {
+		for (offset = 0; offset < 16; offset++) {
+			memset(old_slots, 0x55, sizeof(old_slots));
+			memset(new_slots, 0x55, sizeof(new_slots));
+			benchEncodeSlotsOld(data, bits, &old_slots[offset]);
+			dallasEncodeSlots(data, bits, &new_slots[offset]);
+			if (memcmp(old_slots, new_slots, sizeof(old_slots))) {
+				printf("slot encoding differs at %u bits, offset %d\n", bits, offset);
+				return 0;
+			}
+
+			for (i = 0; i < bits; i++) {
+				if (rand() % 4 == 0)
+					new_slots[offset + i] = received[rand() % 4];
+			}
+			memset(old_data, 0xAA, sizeof(old_data));
+			memset(new_data, 0xAA, sizeof(new_data));
+			benchDecodeSlotsOld(&new_slots[offset], bits, old_data);
+			dallasDecodeSlots(&new_slots[offset], bits, new_data);
+			if (memcmp(old_data, new_data, sizeof(old_data))) {
+				printf("slot decoding differs at %u bits, offset %d\n", bits, offset);
+				return 0;
+			}
+		}
+	}
+	return 1;
+}
+
+// 9 bytes - MATCH ROM, 17 bytes - MATCH ROM and scratchpad read, 128 bytes - long read
+void benchSlots(long rounds)
+{
+	static const int sizes[] = { 9, 17, 128 };
+	unsigned char slots[BENCH_SLOTS_MAX_BITS];
+	u08 data[BENCH_SLOTS_MAX_BITS / 8];
+	double encode_old, encode_new, decode_old, decode_new;
+	clock_t start;
+	unsigned int i;
+	long r;
+	u16 bits;
+
+	for (i = 0; i < sizeof(data); i++)
+		data[i] = rand();
+
+#if defined(DALLAS_SSE2)
+	printf("slots, decode with SSE2\n");
+#elif defined(DALLAS_NEON)
+	printf("slots, decode with NEON\n");
+#else
+	printf("slots, scalar decode\n");
+#endif
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		bits = sizes[i] * 8;
+
+		start = clock();
+		for (r = 0; r < rounds; r++) {
+			data[r % sizes[i]] ^= 1;
+			benchEncodeSlotsOld(data, bits, slots);
+			bench_sink += slots[r % bits];
+		}
+		encode_old = benchNsPerByte(start, rounds, sizes[i]);
+
+		start = clock();
+		for (r = 0; r < rounds; r++) {
+			data[r % sizes[i]] ^= 1;
+			dallasEncodeSlots(data, bits, slots);
+			bench_sink += slots[r % bits];
+		}
+		encode_new = benchNsPerByte(start, rounds, sizes[i]);
+
+		start = clock();
+		for (r = 0; r < rounds; r++) {
+			slots[r % bits] ^= 1;
+			benchDecodeSlotsOld(slots, bits, data);
+			bench_sink += data[r % sizes[i]];
+		}
+		decode_old = benchNsPerByte(start, rounds, sizes[i]);
+
+		start = clock();
+		for (r = 0; r < rounds; r++) {
+			slots[r % bits] ^= 1;
+			dallasDecodeSlots(slots, bits, data);
+			bench_sink += data[r % sizes[i]];
+		}
+		decode_new = benchNsPerByte(start, rounds, sizes[i]);
+
+		printf("  %3d bytes: encode %5.2f -> %5.2f ns/byte, decode %5.2f -> %5.2f ns/byte\n",
+			sizes[i], encode_old, encode_new, decode_old, decode_new);
+	}
+}
@@ -0,0 +1,52 @@
+// Benchmarks of the dallas library hot paths
+// The checks compare the library code with the loops it replaced on every
+// length (and every input where it is small enough), a mismatch is printed
+// and the exit code is 1. The benchmarks print ns per data byte, old -> new.
+//
+// Usage: dallasbench [options]
+//   -c            run the checks only
+//   -r rounds     rounds of every benchmark (default 1000000)
+//
+// The decode of slots uses SSE2 or NEON when the compiler enables them,
+// build with DEFINES += DALLAS_NO_SIMD to measure the scalar code
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "dallasbench.h"
+
+volatile unsigned long bench_sink;
+
+double benchNsPerByte(clock_t start, long rounds, int bytes)
+{
+	return (double) (clock() - start) / CLOCKS_PER_SEC * 1e9 / rounds / bytes;
+}
+
+int main(int argc, char **argv)
+{
+	int option, check_only = 0;
+	long rounds = 1000000;
+
+	while ((option = getopt(argc, argv, "cr:")) != -1) {
+		switch (option) {
+		case 'c': check_only = 1; break;
+		case 'r': rounds = atol(optarg); break;
+		default:
+			fprintf(stderr, "usage: dallasbench [-c] [-r rounds]\n");
+			return 2;
+		}
+	}
+	if (rounds < 1)
+		rounds = 1;
+
+	if (!benchSlotsCheck() || !benchCrcCheck())
+		return 1;
+	printf("checks passed\n");
+	if (check_only)
+		return 0;
+
+	benchSlots(rounds);
+	benchCrc(rounds);
+	return 0;
+}
@@ -0,0 +1,28 @@
+// Benchmarks of the dallas library hot paths
+// Every part compares the library code with the plain loops it replaced,
+// checks that both give identical results and measures them
+
+#ifndef dallasbench_h
+#define dallasbench_h
+
+#include <time.h>
+
+#include "types.h"
+
+//----- Prototypes ------------------------------------------------------------
+
+// ns per byte of the loop run rounds times over bytes, from clock() before the loop
+double benchNsPerByte(clock_t start, long rounds, int bytes);
+
+// results of the code measured are added here, so the compiler keeps the loops
+extern volatile unsigned long bench_sink;
+
+// slot encoding and decoding of dallasWriteBits(), benchslots.c
+int benchSlotsCheck(void);
+void benchSlots(long rounds);
+
+// CRC8 and CRC16 tables, benchcrc.c
+int benchCrcCheck(void);
+void benchCrc(long rounds);
+
+#endif
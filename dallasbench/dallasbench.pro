@@ -0,0 +1,32 @@
+######################################################################
+# Benchmarks and equivalence checks of the dallas library hot paths,
+# console application without Qt
+######################################################################
+
+TEMPLATE = app
+TARGET = dallasbench
+DEPENDPATH += . ../dallas
+INCLUDEPATH += . ../dallas
+
+CONFIG += console release
+CONFIG -= qt
+
+# Input
+HEADERS += dallasbench.h \
+           ../dallas/crc.h \
+           ../dallas/dallas.h \
+           ../dallas/delay.h \
+           ../dallas/ds2480.h \
+           ../dallas/types.h
+SOURCES += benchcrc.c \
+           benchslots.c \
+           dallasbench.c \
+           ../dallas/crc.c \
+           ../dallas/delay.c \
+           ../dallas/ds2480.c
+
+OBJECTS_DIR = build
+
+# win32:DEFINES += _WINDOWS_NT_
+win32:DEFINES += _WINDOWS_CE_
+unix:DEFINES += _LINUX_
@@ -0,0 +1,272 @@
+// 1-Wire bus simulator
+// ROM command layer shared by all virtual devices
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "crc.h"
+#include "w1sim.h"
+
+#define ROM_READ_ROM				0x33
+#define ROM_MATCH_ROM				0x55
+#define ROM_SKIP_ROM				0xCC
+#define ROM_SEARCH_ROM				0xF0
+#define ROM_CONDITIONAL_SEARCH		0xEC
+#define ROM_RESUME					0xA5
+#define ROM_OVERDRIVE_SKIP_ROM		0x3C
+#define ROM_OVERDRIVE_MATCH_ROM		0x69
+
+w1sim_device_T w1sim_devices[W1SIM_MAX_DEVICES];
+int w1sim_device_count = 0;
+w1sim_options_T w1sim_options;
+
+static const w1sim_type_T *w1sim_types[] = {
+	&w1sim_ds18b20,
+	&w1sim_ds2450,
+	&w1sim_ds2408,
+	0
+};
+
+double w1simNow(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+w1sim_device_T *w1simAddDevice(const char *spec)
+{
+	const w1sim_type_T **type;
+	const char *values = strchr(spec, '=');
+	size_t name_size = values ? (size_t)(values - spec) : strlen(spec);
+	w1sim_device_T *dev;
+	int i, serial;
+
+	if (w1sim_device_count >= W1SIM_MAX_DEVICES)
+		return 0;
+	for (type = w1sim_types; *type; type++)
+		if (strlen((*type)->name) == name_size && !strncmp((*type)->name, spec, name_size))
+			break;
+	if (!*type)
+		return 0;
+
+	dev = &w1sim_devices[w1sim_device_count];
+	memset(dev, 0, sizeof(*dev));
+	dev->type = *type;
+	dev->state = ROM_WAIT_RESET;
+
+	// serial number is made of device index so ROM ids are stable between runs
+	serial = w1sim_device_count + 1;
+	dev->rom[0] = (*type)->family;
+	for (i = 1; i < 7; i++) {
+		dev->rom[i] = (u08) serial;
+		serial >>= 8;
+	}
+	dev->rom[7] = crc8(dev->rom, 7);
+
+	(*type)->init(dev);
+	if (values && !(*type)->set(dev, values + 1))
+		return 0;
+	w1sim_device_count++;
+	return dev;
+}
+
+void w1simQueue(w1sim_device_T *dev, const u08 *data, int size)
+{
+	if (dev->tx_pos == dev->tx_size)
+		dev->tx_pos = dev->tx_size = 0;
+	if (size > W1SIM_TX_SIZE - dev->tx_size)
+		size = W1SIM_TX_SIZE - dev->tx_size;
+	memcpy(dev->tx + dev->tx_size, data, size);
+	dev->tx_size += size;
+}
+
+void w1simBusy(w1sim_device_T *dev, double seconds)
+{
+	dev->busy = 1;
+	dev->busy_until = w1simNow() + seconds;
+}
+
+int w1simReset(int overdrive)
+{
+	int i, presence = 0;
+	for (i = 0; i < w1sim_device_count; i++) {
+		w1sim_device_T *dev = &w1sim_devices[i];
+		if (!overdrive) {
+			dev->overdrive = 0;
+		} else if (!dev->overdrive) {
+			// too short for reset at standard speed
+			dev->state = ROM_WAIT_RESET;
+			continue;
+		}
+		dev->state = ROM_COMMAND;
+		dev->bit_index = 0;
+		dev->rom_command = 0;
+		dev->rx_bits = 0;
+		dev->tx_pos = dev->tx_size = dev->tx_bit = 0;
+		dev->count = 0;
+		dev->busy = 0;
+		presence = 1;
+	}
+	return presence;
+}
+
+static int w1simRomBit(w1sim_device_T *dev, int index)
+{
+	return (dev->rom[index >> 3] >> (index & 7)) & 1;
+}
+
+static void w1simRomCommand(w1sim_device_T *dev)
+{
+	dev->bit_index = 0;
+	dev->search_phase = 0;
+	switch (dev->rom_command) {
+	case ROM_READ_ROM:
+		dev->state = ROM_READ;
+		dev->resume_flag = 0;
+		break;
+	case ROM_MATCH_ROM:
+		dev->state = ROM_MATCH;
+		break;
+	case ROM_SKIP_ROM:
+		dev->state = ROM_SELECTED;
+		dev->resume_flag = 0;
+		break;
+	case ROM_SEARCH_ROM:
+		dev->state = ROM_SEARCH;
+		break;
+	case ROM_CONDITIONAL_SEARCH:
+		dev->state = dev->type->alarm(dev) ? ROM_SEARCH : ROM_WAIT_RESET;
+		if (dev->state == ROM_WAIT_RESET)
+			dev->resume_flag = 0;
+		break;
+	case ROM_RESUME:
+		// devices without Resume take it as unknown command
+		if (dev->type->resume && dev->resume_flag)
+			dev->state = ROM_SELECTED;
+		else
+			dev->state = ROM_WAIT_RESET;
+		break;
+	case ROM_OVERDRIVE_SKIP_ROM:
+		dev->overdrive = dev->type->overdrive && !w1sim_options.no_overdrive;
+		dev->state = dev->overdrive ? ROM_SELECTED : ROM_WAIT_RESET;
+		dev->resume_flag = 0;
+		break;
+	case ROM_OVERDRIVE_MATCH_ROM:
+		// ROM id is already sent at overdrive speed
+		dev->overdrive = dev->type->overdrive && !w1sim_options.no_overdrive;
+		dev->state = dev->overdrive ? ROM_MATCH : ROM_WAIT_RESET;
+		break;
+	default:
+		dev->state = ROM_WAIT_RESET;
+		break;
+	}
+}
+
+// function layer slot of selected device
+static int w1simFunctionSlot(w1sim_device_T *dev, int bit)
+{
+	if (dev->busy) {
+		if (w1simNow() < dev->busy_until)
+			return 0;
+		dev->busy = 0;
+		return 1;
+	}
+	if (dev->tx_pos < dev->tx_size) {
+		int result = (dev->tx[dev->tx_pos] >> dev->tx_bit) & 1;
+		if (++dev->tx_bit == 8) {
+			dev->tx_bit = 0;
+			if (++dev->tx_pos == dev->tx_size && dev->type->tx_done)
+				dev->type->tx_done(dev);
+		}
+		return result;
+	}
+	dev->rx_byte = (u08) ((dev->rx_byte >> 1) | (bit << 7));
+	if (++dev->rx_bits == 8) {
+		dev->rx_bits = 0;
+		if (dev->count == 0)
+			dev->command = dev->rx_byte;
+		dev->type->rx(dev, dev->rx_byte);
+		dev->count++;
+	}
+	return 1;
+}
+
+// one slot of a single device, returns bit driven by device (1 - released)
+static int w1simDeviceSlot(w1sim_device_T *dev, int bit)
+{
+	int result = 1;
+	switch (dev->state) {
+	case ROM_COMMAND:
+		dev->rom_command = (u08) ((dev->rom_command >> 1) | (bit << 7));
+		if (++dev->bit_index == 8)
+			w1simRomCommand(dev);
+		break;
+	case ROM_MATCH:
+		if (bit != w1simRomBit(dev, dev->bit_index)) {
+			dev->state = ROM_WAIT_RESET;
+			dev->resume_flag = 0;
+			if (dev->rom_command == ROM_OVERDRIVE_MATCH_ROM)
+				dev->overdrive = 0;
+		} else if (++dev->bit_index == 64) {
+			dev->state = ROM_SELECTED;
+			dev->resume_flag = 1;
+		}
+		break;
+	case ROM_READ:
+		result = w1simRomBit(dev, dev->bit_index);
+		if (++dev->bit_index == 64)
+			dev->state = ROM_SELECTED;
+		break;
+	case ROM_SEARCH:
+		if (dev->search_phase == 0) {
+			result = w1simRomBit(dev, dev->bit_index);
+		} else if (dev->search_phase == 1) {
+			result = !w1simRomBit(dev, dev->bit_index);
+		} else if (bit != w1simRomBit(dev, dev->bit_index)) {
+			dev->state = ROM_WAIT_RESET;
+			dev->resume_flag = 0;
+		} else if (++dev->bit_index == 64) {
+			dev->state = ROM_SELECTED;
+			dev->resume_flag = 1;
+		}
+		dev->search_phase = (dev->search_phase + 1) % 3;
+		break;
+	case ROM_SELECTED:
+		result = w1simFunctionSlot(dev, bit);
+		break;
+	}
+	return result;
+}
+
+int w1simSlot(int bit, int overdrive)
+{
+	int i, bus = bit;
+	// all devices see the bit written by master, the bus is wired-AND of everybody
+	for (i = 0; i < w1sim_device_count; i++) {
+		w1sim_device_T *dev = &w1sim_devices[i];
+		// slot at the other speed is garbage, the device waits for reset
+		if (dev->overdrive != overdrive)
+			dev->state = ROM_WAIT_RESET;
+		else
+			bus &= w1simDeviceSlot(dev, bit);
+	}
+	return bus;
+}
+
+void w1simPrintDevices(void)
+{
+	int i, j;
+	for (i = 0; i < w1sim_device_count; i++) {
+		w1sim_device_T *dev = &w1sim_devices[i];
+		printf("%2d %-8s ", i, dev->type->name);
+		for (j = 7; j >= 0; j--)
+			printf("%02X", dev->rom[j]);
+		printf(" ");
+		dev->type->print(dev);
+		printf("\n");
+	}
+	fflush(stdout);
+}
@@ -0,0 +1,486 @@
+// 1-Wire bus simulator
+// Function command layer of virtual DS18B20, DS2450 and DS2408 devices
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc.h"
+#include "w1sim.h"
+
+//----- DS18B20 ---------------------------------------------------------------
+
+#define DS18B20_CONVERT_T			0x44
+#define DS18B20_WRITE_SCRATCHPAD	0x4E
+#define DS18B20_READ_SCRATCHPAD		0xBE
+#define DS18B20_COPY_SCRATCHPAD		0x48
+#define DS18B20_RECALL_E2			0xB8
+#define DS18B20_READ_POWER_SUPPLY	0xB4
+
+static int ds18b20Resolution(w1sim_device_T *dev)
+{
+	return ((dev->u.ds18b20.scratchpad[4] >> 5) & 3) + 9;
+}
+
+static void ds18b20Init(w1sim_device_T *dev)
+{
+	static const u08 power_on[8] = { 0x50, 0x05, 0x4B, 0x46, 0x7F, 0xFF, 0x0C, 0x10 };
+	memcpy(dev->u.ds18b20.scratchpad, power_on, 8);
+	dev->u.ds18b20.scratchpad[8] = crc8(dev->u.ds18b20.scratchpad, 8);
+	memcpy(dev->u.ds18b20.eeprom, power_on + 2, 3);
+	dev->u.ds18b20.temperature = 20.0;
+}
+
+static int ds18b20Set(w1sim_device_T *dev, const char *values)
+{
+	char *end;
+	double temperature = strtod(values, &end);
+	if (end == values || temperature < -55.0 || temperature > 125.0)
+		return 0;
+	dev->u.ds18b20.temperature = temperature;
+	return 1;
+}
+
+static void ds18b20Print(w1sim_device_T *dev)
+{
+	u08 *scratchpad = dev->u.ds18b20.scratchpad;
+	printf("%.4f C, last %.4f C, %d bits, TH %d TL %d",
+		dev->u.ds18b20.temperature,
+		(short) (scratchpad[0] | (scratchpad[1] << 8)) / 16.0,
+		ds18b20Resolution(dev), (s08) scratchpad[2], (s08) scratchpad[3]);
+}
+
+static void ds18b20Rx(w1sim_device_T *dev, u08 byte)
+{
+	u08 *scratchpad = dev->u.ds18b20.scratchpad;
+	int resolution = ds18b20Resolution(dev);
+	short raw;
+
+	if (dev->count == 0) {
+		switch (byte) {
+		case DS18B20_CONVERT_T:
+			// undefined low bits are cleared according to resolution
+			raw = (short) floor(dev->u.ds18b20.temperature * 16.0 + 0.5);
+			raw &= ~((1 << (12 - resolution)) - 1);
+			scratchpad[0] = (u08) raw;
+			scratchpad[1] = (u08) (raw >> 8);
+			scratchpad[8] = crc8(scratchpad, 8);
+			w1simBusy(dev, 0.09375 * (1 << (resolution - 9)));
+			break;
+		case DS18B20_READ_SCRATCHPAD:
+			w1simQueue(dev, scratchpad, 9);
+			break;
+		case DS18B20_COPY_SCRATCHPAD:
+			memcpy(dev->u.ds18b20.eeprom, scratchpad + 2, 3);
+			w1simBusy(dev, 0.01);
+			break;
+		case DS18B20_RECALL_E2:
+			memcpy(scratchpad + 2, dev->u.ds18b20.eeprom, 3);
+			scratchpad[8] = crc8(scratchpad, 8);
+			break;
+		case DS18B20_READ_POWER_SUPPLY:
+			// externally powered device answers with ones
+			break;
+		}
+	} else if (dev->command == DS18B20_WRITE_SCRATCHPAD && dev->count <= 3) {
+		if (dev->count == 3)
+			byte = (byte & 0x60) | 0x1F;
+		scratchpad[dev->count + 1] = byte;
+		scratchpad[8] = crc8(scratchpad, 8);
+	}
+}
+
+// alarm condition compares integer part of the last conversion with TH and TL
+static int ds18b20Alarm(w1sim_device_T *dev)
+{
+	u08 *scratchpad = dev->u.ds18b20.scratchpad;
+	s08 temperature = (s08) ((scratchpad[0] >> 4) | (scratchpad[1] << 4));
+	return temperature >= (s08) scratchpad[2] || temperature <= (s08) scratchpad[3];
+}
+
+const w1sim_type_T w1sim_ds18b20 = {
+	"ds18b20", 0x28, 0, 0, ds18b20Init, ds18b20Set, ds18b20Print, ds18b20Rx, 0, ds18b20Alarm
+};
+
+//----- DS2450 ----------------------------------------------------------------
+
+#define DS2450_READ_MEMORY			0xAA
+#define DS2450_WRITE_MEMORY			0x55
+#define DS2450_CONVERT				0x3C
+#define DS2450_MEMORY_SIZE			0x20
+
+// control/status page bits
+#define DS2450_RC_MASK				0x0F
+#define DS2450_IR					0x01
+#define DS2450_AEL					0x04
+#define DS2450_AEH					0x08
+#define DS2450_AFL					0x10
+#define DS2450_AFH					0x20
+#define DS2450_POR					0x80
+
+static void ds2450Init(w1sim_device_T *dev)
+{
+	u08 *memory = dev->u.ds2450.memory;
+	int i;
+	memset(memory, 0, DS2450_MEMORY_SIZE);
+	for (i = 0; i < 4; i++) {
+		memory[0x08 + i * 2] = 0x08;
+		memory[0x09 + i * 2] = DS2450_POR | DS2450_AEH | DS2450_AEL;
+		memory[0x10 + i * 2] = 0x00;
+		memory[0x11 + i * 2] = 0xFF;
+	}
+}
+
+static int ds2450Set(w1sim_device_T *dev, const char *values)
+{
+	int i;
+	for (i = 0; i < 4; i++) {
+		char *end;
+		double millivolts = strtod(values, &end);
+		if (end == values || millivolts < 0)
+			return 0;
+		dev->u.ds2450.millivolts[i] = millivolts;
+		if (*end != ',')
+			break;
+		values = end + 1;
+	}
+	return 1;
+}
+
+static void ds2450Print(w1sim_device_T *dev)
+{
+	u08 *memory = dev->u.ds2450.memory;
+	int i;
+	for (i = 0; i < 4; i++)
+		printf("%c %.0f mV (%04X) ", 'A' + i, dev->u.ds2450.millivolts[i],
+			memory[i * 2] | (memory[i * 2 + 1] << 8));
+}
+
+static void ds2450Convert(w1sim_device_T *dev, u08 mask)
+{
+	u08 *memory = dev->u.ds2450.memory;
+	double seconds = 160e-6;
+	int i;
+
+	for (i = 0; i < 4; i++) {
+		u08 *control = memory + 0x08 + i * 2;
+		int resolution = control[0] & DS2450_RC_MASK;
+		double range = control[1] & DS2450_IR ? 5120.0 : 2560.0;
+		long value;
+
+		if (!(mask & (1 << i)))
+			continue;
+		if (!resolution)
+			resolution = 16;
+		seconds += resolution * 80e-6;
+
+		value = (long) (dev->u.ds2450.millivolts[i] / range * 65536.0);
+		if (w1sim_options.noise_lsb)
+			value += (rand() % (2 * w1sim_options.noise_lsb + 1) - w1sim_options.noise_lsb) << (16 - resolution);
+		if (value < 0)
+			value = 0;
+		if (value > 0xFFFF)
+			value = 0xFFFF;
+		value &= ~((1L << (16 - resolution)) - 1);
+		memory[i * 2] = (u08) value;
+		memory[i * 2 + 1] = (u08) (value >> 8);
+
+		// alarm flags compare the most significant byte of the result
+		control[1] &= ~(DS2450_AFL | DS2450_AFH);
+		if ((control[1] & DS2450_AEL) && memory[i * 2 + 1] < memory[0x10 + i * 2])
+			control[1] |= DS2450_AFL;
+		if ((control[1] & DS2450_AEH) && memory[i * 2 + 1] > memory[0x11 + i * 2])
+			control[1] |= DS2450_AFH;
+	}
+	w1simBusy(dev, seconds);
+}
+
+// queues rest of the page starting at current address and inverted CRC16
+static void ds2450QueuePage(w1sim_device_T *dev)
+{
+	u08 data[10];
+	int size = 0;
+	do {
+		data[size] = dev->u.ds2450.memory[dev->address];
+		dev->crc = crc16_update(dev->crc, data[size++]);
+		dev->address++;
+	} while (dev->address & 7);
+	data[size++] = (u08) ~dev->crc;
+	data[size++] = (u08) (~dev->crc >> 8);
+	w1simQueue(dev, data, size);
+	dev->crc = 0;
+}
+
+static void ds2450Rx(w1sim_device_T *dev, u08 byte)
+{
+	u08 data[3];
+
+	if (dev->count == 0) {
+		dev->crc = crc16_update(0, byte);
+		dev->address = 0;
+		return;
+	}
+	if (dev->count <= 2)
+		dev->crc = crc16_update(dev->crc, byte);
+
+	switch (dev->command) {
+	case DS2450_READ_MEMORY:
+		if (dev->count == 1) {
+			dev->address = byte;
+		} else if (dev->count == 2) {
+			dev->address |= byte << 8;
+			if (dev->address < DS2450_MEMORY_SIZE)
+				ds2450QueuePage(dev);
+		}
+		break;
+	case DS2450_WRITE_MEMORY:
+		if (dev->count == 1) {
+			dev->address = byte;
+		} else if (dev->count == 2) {
+			dev->address |= byte << 8;
+		} else if (dev->address < DS2450_MEMORY_SIZE) {
+			// CRC of the first byte covers command and address, next ones start from address
+			if (dev->count > 3)
+				dev->crc = dev->address;
+			dev->crc = crc16_update(dev->crc, byte);
+			// conversion results are read only
+			if (dev->address >= 0x08)
+				dev->u.ds2450.memory[dev->address] = byte;
+			data[0] = (u08) ~dev->crc;
+			data[1] = (u08) (~dev->crc >> 8);
+			data[2] = dev->u.ds2450.memory[dev->address];
+			w1simQueue(dev, data, 3);
+			dev->address++;
+		}
+		break;
+	case DS2450_CONVERT:
+		if (dev->count == 1) {
+			dev->u.ds2450.convert_mask = byte;
+		} else if (dev->count == 2) {
+			data[0] = (u08) ~dev->crc;
+			data[1] = (u08) (~dev->crc >> 8);
+			w1simQueue(dev, data, 2);
+		}
+		break;
+	}
+}
+
+static void ds2450TxDone(w1sim_device_T *dev)
+{
+	switch (dev->command) {
+	case DS2450_READ_MEMORY:
+		// reading continues with the next page
+		if (dev->address < DS2450_MEMORY_SIZE)
+			ds2450QueuePage(dev);
+		break;
+	case DS2450_CONVERT:
+		// conversion starts after CRC16 is read by master, presets of
+		// readout control are not emulated as they are overwritten by results
+		if (dev->count == 3) {
+			ds2450Convert(dev, dev->u.ds2450.convert_mask);
+			dev->count++;
+		}
+		break;
+	}
+}
+
+static int ds2450Alarm(w1sim_device_T *dev)
+{
+	u08 *memory = dev->u.ds2450.memory;
+	int i;
+	for (i = 0; i < 4; i++) {
+		u08 status = memory[0x09 + i * 2];
+		if ((status & DS2450_POR)
+			|| ((status & DS2450_AEL) && (status & DS2450_AFL))
+			|| ((status & DS2450_AEH) && (status & DS2450_AFH)))
+			return 1;
+	}
+	return 0;
+}
+
+const w1sim_type_T w1sim_ds2450 = {
+	"ds2450", 0x20, 0, 1, ds2450Init, ds2450Set, ds2450Print, ds2450Rx, ds2450TxDone, ds2450Alarm
+};
+
+//----- DS2408 ----------------------------------------------------------------
+
+#define DS2408_READ_PIO_REGISTERS	0xF0
+#define DS2408_CHANNEL_ACCESS_READ	0xF5
+#define DS2408_CHANNEL_ACCESS_WRITE	0x5A
+#define DS2408_WRITE_CS_REGISTER	0xCC
+#define DS2408_RESET_ACTIVITY		0xC3
+
+// register indexes relative to 0x88
+#define DS2408_LOGIC_STATE			0
+#define DS2408_OUTPUT_LATCH			1
+#define DS2408_ACTIVITY_LATCH		2
+#define DS2408_CS_MASK				3
+#define DS2408_CS_POLARITY			4
+#define DS2408_CONTROL_STATUS		5
+
+// control/status register bits
+#define DS2408_PLS					0x01
+#define DS2408_CT					0x02
+#define DS2408_PORL					0x08
+#define DS2408_VCCP					0x80
+
+// pins are open drain outputs: a pin is low if either its latch or the outside pulls it
+static void ds2408UpdatePins(w1sim_device_T *dev)
+{
+	u08 *registers = dev->u.ds2408.registers;
+	u08 pins = registers[DS2408_OUTPUT_LATCH] & dev->u.ds2408.inputs;
+	registers[DS2408_ACTIVITY_LATCH] |= pins ^ registers[DS2408_LOGIC_STATE];
+	registers[DS2408_LOGIC_STATE] = pins;
+}
+
+static void ds2408Init(w1sim_device_T *dev)
+{
+	u08 *registers = dev->u.ds2408.registers;
+	memset(registers, 0, sizeof(dev->u.ds2408.registers));
+	registers[DS2408_OUTPUT_LATCH] = 0xFF;
+	registers[DS2408_CONTROL_STATUS] = DS2408_VCCP | DS2408_PORL;
+	registers[6] = registers[7] = 0xFF;
+	dev->u.ds2408.inputs = 0xFF;
+	registers[DS2408_LOGIC_STATE] = 0xFF;
+}
+
+static int ds2408Set(w1sim_device_T *dev, const char *values)
+{
+	char *end;
+	unsigned long inputs = strtoul(values, &end, 0);
+	if (end == values || inputs > 0xFF)
+		return 0;
+	dev->u.ds2408.inputs = (u08) inputs;
+	ds2408UpdatePins(dev);
+	return 1;
+}
+
+static void ds2408Print(w1sim_device_T *dev)
+{
+	u08 *registers = dev->u.ds2408.registers;
+	printf("inputs %02X latch %02X pins %02X activity %02X control %02X",
+		dev->u.ds2408.inputs, registers[DS2408_OUTPUT_LATCH], registers[DS2408_LOGIC_STATE],
+		registers[DS2408_ACTIVITY_LATCH], registers[DS2408_CONTROL_STATUS]);
+}
+
+// queues registers starting at current address and inverted CRC16
+static void ds2408QueueRegisters(w1sim_device_T *dev)
+{
+	u08 data[10];
+	int size = 0;
+	ds2408UpdatePins(dev);
+	for (; dev->address < 0x90; dev->address++) {
+		data[size] = dev->u.ds2408.registers[dev->address - 0x88];
+		dev->crc = crc16_update(dev->crc, data[size++]);
+	}
+	data[size++] = (u08) ~dev->crc;
+	data[size++] = (u08) (~dev->crc >> 8);
+	w1simQueue(dev, data, size);
+}
+
+// queues 32 samples of pins and inverted CRC16
+static void ds2408QueueChannel(w1sim_device_T *dev)
+{
+	u08 data[34];
+	int size;
+	ds2408UpdatePins(dev);
+	for (size = 0; size < 32; size++) {
+		data[size] = dev->u.ds2408.registers[DS2408_LOGIC_STATE];
+		dev->crc = crc16_update(dev->crc, data[size]);
+	}
+	data[size++] = (u08) ~dev->crc;
+	data[size++] = (u08) (~dev->crc >> 8);
+	w1simQueue(dev, data, size);
+	dev->crc = 0;
+}
+
+static void ds2408Rx(w1sim_device_T *dev, u08 byte)
+{
+	u08 *registers = dev->u.ds2408.registers;
+	u08 data[2];
+
+	if (dev->count == 0) {
+		dev->crc = crc16_update(0, byte);
+		switch (byte) {
+		case DS2408_CHANNEL_ACCESS_READ:
+			ds2408QueueChannel(dev);
+			break;
+		case DS2408_RESET_ACTIVITY:
+			registers[DS2408_ACTIVITY_LATCH] = 0;
+			data[0] = 0xAA;
+			w1simQueue(dev, data, 1);
+			break;
+		}
+		return;
+	}
+
+	switch (dev->command) {
+	case DS2408_READ_PIO_REGISTERS:
+		dev->crc = crc16_update(dev->crc, byte);
+		if (dev->count == 1) {
+			dev->address = byte;
+		} else if (dev->count == 2) {
+			dev->address |= byte << 8;
+			if (dev->address >= 0x88 && dev->address < 0x90)
+				ds2408QueueRegisters(dev);
+		}
+		break;
+	case DS2408_CHANNEL_ACCESS_WRITE:
+		// odd bytes are data, even bytes are its inversion
+		if (dev->count & 1) {
+			dev->address = byte;
+		} else if ((u08) ~byte == (u08) dev->address) {
+			registers[DS2408_OUTPUT_LATCH] = (u08) dev->address;
+			ds2408UpdatePins(dev);
+			data[0] = 0xAA;
+			data[1] = registers[DS2408_LOGIC_STATE];
+			w1simQueue(dev, data, 2);
+		} else {
+			data[0] = data[1] = 0xFF;
+			w1simQueue(dev, data, 2);
+		}
+		break;
+	case DS2408_WRITE_CS_REGISTER:
+		if (dev->count == 1) {
+			dev->address = byte;
+		} else if (dev->count == 2) {
+			dev->address |= byte << 8;
+		} else {
+			if (dev->address >= 0x88 + DS2408_CS_MASK && dev->address <= 0x88 + DS2408_CONTROL_STATUS) {
+				if (dev->address == 0x88 + DS2408_CONTROL_STATUS)
+					// only PLS, CT and ROS bits are writable, PORL is cleared by writing 0
+					byte = (registers[DS2408_CONTROL_STATUS] & (DS2408_VCCP | (byte & DS2408_PORL))) | (byte & 0x07);
+				registers[dev->address - 0x88] = byte;
+			}
+			dev->address++;
+		}
+		break;
+	}
+}
+
+static void ds2408TxDone(w1sim_device_T *dev)
+{
+	if (dev->command == DS2408_CHANNEL_ACCESS_READ)
+		ds2408QueueChannel(dev);
+}
+
+static int ds2408Alarm(w1sim_device_T *dev)
+{
+	u08 *registers = dev->u.ds2408.registers;
+	u08 source, match, mask = registers[DS2408_CS_MASK];
+
+	ds2408UpdatePins(dev);
+	// power-on reset makes the device answer until PORL is cleared
+	if (registers[DS2408_CONTROL_STATUS] & DS2408_PORL)
+		return 1;
+	source = registers[DS2408_CONTROL_STATUS] & DS2408_PLS ? registers[DS2408_ACTIVITY_LATCH] : registers[DS2408_LOGIC_STATE];
+	match = ~(source ^ registers[DS2408_CS_POLARITY]) & mask;
+	if (registers[DS2408_CONTROL_STATUS] & DS2408_CT)
+		return match == mask;
+	return match != 0;
+}
+
+const w1sim_type_T w1sim_ds2408 = {
+	"ds2408", 0x29, 1, 1, ds2408Init, ds2408Set, ds2408Print, ds2408Rx, ds2408TxDone, ds2408Alarm
+};
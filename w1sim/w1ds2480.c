@@ -0,0 +1,181 @@
+// 1-Wire bus simulator
+// DS2480B serial 1-Wire line driver in front of the virtual devices.
+// Bytes from master are commands in command mode and 1-Wire bytes in data
+// mode; data byte 0xE3 is doubled, single 0xE3 returns to command mode.
+// Break (host baud rate changed behind the adapter's back) returns it to
+// power-on state: 9600 baud, command mode, waiting for the timing byte.
+
+#include "w1sim.h"
+
+#define DS2480_DATA_MODE			0xE1
+#define DS2480_COMMAND_MODE			0xE3
+
+// command byte groups
+#define DS2480_CONFIG				0x00	// 0ppp vvv1: write parameter p, p == 0 reads parameter vvv
+#define DS2480_BIT					0x80	// 100b ss p1: single bit b, strong pull-up p
+#define DS2480_SEARCH				0xA0	// 101a ss 01: search accelerator on/off
+#define DS2480_RESET				0xC0	// 110x ss 01: reset pulse
+#define DS2480_PULSE				0xE0	// 111x xx x1: mode switch, pulse control
+
+#define DS2480_SPEED_OVERDRIVE		2		// speed bits ss
+#define DS2480_PARAM_BAUD			7		// host baud rate parameter
+
+// 1-Wire time of reset and slots in microseconds
+#define DS2480_RESET_US				1000
+#define DS2480_OVERDRIVE_RESET_US	150
+#define DS2480_SLOT_US				70
+#define DS2480_OVERDRIVE_SLOT_US	10
+
+static const long ds2480_bauds[4] = { 9600, 19200, 57600, 115200 };
+
+static struct
+{
+	int calibrated;			// the first reset command after power-on only sets timing
+	int data_mode;
+	int escape;				// 0xE3 received in data mode
+	int search;				// search accelerator is on
+	int overdrive;			// speed of the last communication command
+	int pulse;				// strong pull-up is on
+	u08 params[8];
+} ds2480;
+
+static void w1ds2480PowerOn(void)
+{
+	int i;
+	ds2480.calibrated = 0;
+	ds2480.data_mode = 0;
+	ds2480.escape = 0;
+	ds2480.search = 0;
+	ds2480.overdrive = 0;
+	ds2480.pulse = 0;
+	for (i = 0; i < 8; i++)
+		ds2480.params[i] = 0;
+}
+
+static int w1ds2480Slot(int bit, long *wire_us)
+{
+	*wire_us += ds2480.overdrive ? DS2480_OVERDRIVE_SLOT_US : DS2480_SLOT_US;
+	return w1simBusSlot(bit, ds2480.overdrive);
+}
+
+// data mode byte: 8 slots, LSB first
+static u08 w1ds2480DataByte(u08 byte, long *wire_us)
+{
+	u08 result = 0;
+	int i;
+	for (i = 0; i < 8; i++)
+		if (w1ds2480Slot((byte >> i) & 1, wire_us))
+			result |= 1 << i;
+	return result;
+}
+
+// accelerated search: the byte holds directions of 4 ROM bits in odd bits,
+// the result holds discrepancy flag and ROM bit chosen for each of them
+static u08 w1ds2480SearchByte(u08 byte, long *wire_us)
+{
+	u08 result = 0;
+	int i, bit, complement, discrepancy;
+	for (i = 0; i < 4; i++) {
+		bit = w1ds2480Slot(1, wire_us);
+		complement = w1ds2480Slot(1, wire_us);
+		discrepancy = bit == complement;
+		if (discrepancy && !bit)
+			bit = (byte >> (2 * i + 1)) & 1;
+		w1ds2480Slot(bit, wire_us);
+		result |= discrepancy << (2 * i) | bit << (2 * i + 1);
+	}
+	return result;
+}
+
+// handles one command byte, returns the new response size
+static int w1ds2480Command(u08 byte, u08 *response, int count, long *wire_us)
+{
+	int param;
+
+	if (!ds2480.calibrated) {
+		// timing byte after power-on, no response
+		if ((byte & 0xE0) == DS2480_RESET)
+			ds2480.calibrated = 1;
+		return count;
+	}
+
+	if (!(byte & 0x80)) {
+		param = (byte >> 4) & 7;
+		if (param == 0) {
+			response[count++] = (u08) (ds2480.params[(byte >> 1) & 7] << 1);
+		} else {
+			ds2480.params[param] = (byte >> 1) & 7;
+			response[count++] = byte & 0xFE;
+		}
+		return count;
+	}
+
+	if ((byte & 0xE0) != DS2480_PULSE)
+		ds2480.overdrive = ((byte >> 2) & 3) == DS2480_SPEED_OVERDRIVE;
+
+	switch (byte & 0xE0) {
+	case DS2480_BIT:
+		ds2480.pulse = 0;
+		response[count++] = (byte & 0xFC) | (w1ds2480Slot((byte >> 4) & 1, wire_us) ? 3 : 0);
+		if (byte & 0x02)
+			ds2480.pulse = 1;
+		break;
+	case DS2480_SEARCH:
+		ds2480.search = (byte >> 4) & 1;
+		break;
+	case DS2480_RESET:
+		ds2480.pulse = 0;
+		*wire_us += ds2480.overdrive ? DS2480_OVERDRIVE_RESET_US : DS2480_RESET_US;
+		response[count++] = w1simBusReset(ds2480.overdrive) ? 0xCD : 0xCF;
+		break;
+	default:
+		if (byte == DS2480_DATA_MODE) {
+			ds2480.data_mode = 1;
+		} else if (byte != DS2480_COMMAND_MODE) {
+			// stop pulse
+			ds2480.pulse = 0;
+			response[count++] = byte & 0xFC;
+		}
+		break;
+	}
+	return count;
+}
+
+int w1simDS2480Exchange(const u08 *request, int size, u08 *response, long baud, long *wire_us)
+{
+	static int powered = 0;
+	int i, count = 0;
+
+	if (!powered) {
+		w1ds2480PowerOn();
+		powered = 1;
+	}
+	*wire_us = size * 10 * 1000000LL / baud;
+	if (baud != ds2480_bauds[ds2480.params[DS2480_PARAM_BAUD] & 3]) {
+		// master switched baud rate without telling the adapter, it is taken as break
+		w1ds2480PowerOn();
+		if (baud != ds2480_bauds[0])
+			return 0;
+	}
+
+	for (i = 0; i < size; i++) {
+		u08 byte = request[i];
+		if (!ds2480.data_mode) {
+			count = w1ds2480Command(byte, response, count, wire_us);
+			continue;
+		}
+		if (ds2480.escape) {
+			ds2480.escape = 0;
+			if (byte != DS2480_COMMAND_MODE) {
+				ds2480.data_mode = 0;
+				count = w1ds2480Command(byte, response, count, wire_us);
+				continue;
+			}
+		} else if (byte == DS2480_COMMAND_MODE) {
+			ds2480.escape = 1;
+			continue;
+		}
+		response[count++] = ds2480.search ? w1ds2480SearchByte(byte, wire_us) : w1ds2480DataByte(byte, wire_us);
+	}
+	return count;
+}
@@ -0,0 +1,335 @@
+// 1-Wire bus simulator
+// Emulates an UART based 1-Wire adapter (DS9097 style) on a pseudo-terminal,
+// so dallasInit("/dev/pts/N") drives virtual devices exactly like a real bus:
+// byte 0xF0 written at 9600 baud is a reset pulse, every byte written at
+// 115200 baud is one time slot (0xFF - write 1 or read, 0x00 - write 0).
+// Overdrive uses byte 0xF8 at 57600 baud as reset pulse and 1000000 baud
+// (or 921600 baud) for time slots.
+// With -a ds2480b the pseudo-terminal is a DS2480B serial line driver instead
+// (see w1ds2480.c).
+//
+// Usage: w1sim [options] device...
+//   device        ds18b20[=celsius], ds2450[=mvA,mvB,mvC,mvD], ds2408[=inputs]
+//   -l link       create symbolic link to the slave side of pseudo-terminal
+//   -L us         latency added before each response (USB adapters have 1-16 ms)
+//   -w            add time the bytes would take on the wire
+//   -P permille   resets without presence pulse
+//   -B permille   read slots with inverted bit
+//   -D permille   response bytes that are lost
+//   -n lsb        noise of DS2450 conversions
+//   -O            devices ignore overdrive commands
+//   -a adapter    uart (default) or ds2480b
+//   -s seed       seed of random generator
+//   -v            print every reset
+//
+// Console commands on stdin: list, set <index> <value>, stats, quit
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "w1sim.h"
+
+#define W1SIM_BUFFER_SIZE			4096
+
+#define W1SIM_RESET_PULSE			0xF0
+#define W1SIM_OVERDRIVE_RESET_PULSE	0xF8
+#define W1SIM_PRESENCE				0xE0
+#define W1SIM_SLOT_LOW				0xFE	// device pulled read slot low shortly after start bit
+
+typedef struct w1sim_stats_S
+{
+	unsigned long resets;
+	unsigned long presences;
+	unsigned long slots;
+	unsigned long overdrive_slots;
+	unsigned long exchanges;		// chunks read from master, i.e. round trips of the client
+	unsigned long baud_switches;
+	unsigned long faults;
+} w1sim_stats_T;
+
+static w1sim_stats_T w1sim_stats;
+static volatile sig_atomic_t w1sim_quit = 0;
+
+static void w1simSignal(int signal)
+{
+	(void) signal;
+	w1sim_quit = 1;
+}
+
+static int w1simFault(int permille)
+{
+	return permille && rand() % 1000 < permille;
+}
+
+static long w1simBaud(speed_t speed)
+{
+	switch (speed) {
+	case B9600:   return 9600;
+	case B19200:  return 19200;
+	case B38400:  return 38400;
+	case B57600:  return 57600;
+	case B115200: return 115200;
+	case B230400: return 230400;
+	case B921600: return 921600;
+#if defined(B1000000)
+	case B1000000: return 1000000;
+#endif
+	}
+	return 9600;
+}
+
+static void w1simPrintStats(void)
+{
+	printf("resets %lu, presences %lu, slots %lu (overdrive %lu), exchanges %lu, baud switches %lu, faults %lu\n",
+		w1sim_stats.resets, w1sim_stats.presences, w1sim_stats.slots, w1sim_stats.overdrive_slots,
+		w1sim_stats.exchanges, w1sim_stats.baud_switches, w1sim_stats.faults);
+	fflush(stdout);
+}
+
+int w1simBusReset(int overdrive)
+{
+	int presence = 0;
+	w1sim_stats.resets++;
+	if (!w1simReset(overdrive)) {
+		// nobody at this speed
+	} else if (!w1simFault(w1sim_options.presence_faults)) {
+		presence = 1;
+		w1sim_stats.presences++;
+	} else {
+		w1sim_stats.faults++;
+	}
+	if (w1sim_options.verbose)
+		printf("reset%s\n", presence ? "" : " - no presence");
+	return presence;
+}
+
+int w1simBusSlot(int bit, int overdrive)
+{
+	int bus = w1simSlot(bit, overdrive);
+	if (overdrive)
+		w1sim_stats.overdrive_slots++;
+	if (bit && w1simFault(w1sim_options.bit_faults)) {
+		bus = !bus;
+		w1sim_stats.faults++;
+	}
+	w1sim_stats.slots++;
+	return bus;
+}
+
+// handles one chunk written by master, response has the same size
+static void w1simExchange(const u08 *request, u08 *response, int size, speed_t speed)
+{
+	int i, overdrive;
+	for (i = 0; i < size; i++) {
+		if (speed == B9600 || speed == B57600) {
+			// reset speeds: anything but the reset pulse is just echoed
+			overdrive = speed == B57600;
+			response[i] = request[i];
+			if (request[i] == (overdrive ? W1SIM_OVERDRIVE_RESET_PULSE : W1SIM_RESET_PULSE)
+				&& w1simBusReset(overdrive))
+				response[i] = W1SIM_PRESENCE;
+		} else {
+			int bit = request[i] == 0xFF;
+			int bus = w1simBusSlot(bit, speed != B115200);
+			response[i] = bus ? 0xFF : bit ? W1SIM_SLOT_LOW : 0x00;
+		}
+	}
+}
+
+static int w1simWriteAll(int fd, const u08 *data, int size)
+{
+	while (size > 0) {
+		ssize_t written = write(fd, data, size);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return 0;
+		}
+		data += written;
+		size -= written;
+	}
+	return 1;
+}
+
+static void w1simConsole(char *line)
+{
+	char *command = strtok(line, " \t\r\n");
+	char *index, *value;
+
+	if (!command)
+		return;
+	if (!strcmp(command, "list")) {
+		w1simPrintDevices();
+	} else if (!strcmp(command, "stats")) {
+		w1simPrintStats();
+	} else if (!strcmp(command, "quit")) {
+		w1sim_quit = 1;
+	} else if (!strcmp(command, "set")) {
+		index = strtok(0, " \t\r\n");
+		value = strtok(0, " \t\r\n");
+		if (!index || !value || atoi(index) < 0 || atoi(index) >= w1sim_device_count
+			|| !w1sim_devices[atoi(index)].type->set(&w1sim_devices[atoi(index)], value))
+			printf("usage: set <index> <value>\n");
+		fflush(stdout);
+	} else {
+		printf("commands: list, set <index> <value>, stats, quit\n");
+		fflush(stdout);
+	}
+}
+
+static void w1simUsage(void)
+{
+	fprintf(stderr,
+		"usage: w1sim [-l link] [-L us] [-w] [-P permille] [-B permille] [-D permille]\n"
+		"             [-n lsb] [-O] [-a uart|ds2480b] [-s seed] [-v] device...\n"
+		"devices: ds18b20[=celsius], ds2450[=mvA,mvB,mvC,mvD], ds2408[=inputs]\n");
+	exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *link_name = 0;
+	int master, slave, option, console = 1;
+	speed_t last_speed = B9600;
+	struct termios options;
+	struct pollfd fds[2];
+	char *slave_name;
+
+	srand(1);
+	while ((option = getopt(argc, argv, "l:L:wP:B:D:n:Oa:s:v")) != -1) {
+		switch (option) {
+		case 'l': link_name = optarg; break;
+		case 'L': w1sim_options.latency_us = atol(optarg); break;
+		case 'w': w1sim_options.wire_time = 1; break;
+		case 'P': w1sim_options.presence_faults = atoi(optarg); break;
+		case 'B': w1sim_options.bit_faults = atoi(optarg); break;
+		case 'D': w1sim_options.drop_faults = atoi(optarg); break;
+		case 'n': w1sim_options.noise_lsb = atoi(optarg); break;
+		case 'O': w1sim_options.no_overdrive = 1; break;
+		case 'a':
+			if (!strcmp(optarg, "ds2480b"))
+				w1sim_options.ds2480b = 1;
+			else if (strcmp(optarg, "uart"))
+				w1simUsage();
+			break;
+		case 's': srand(atoi(optarg)); break;
+		case 'v': w1sim_options.verbose = 1; break;
+		default: w1simUsage();
+		}
+	}
+	for (; optind < argc; optind++) {
+		if (!w1simAddDevice(argv[optind])) {
+			fprintf(stderr, "invalid device: %s\n", argv[optind]);
+			w1simUsage();
+		}
+	}
+
+	master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) || unlockpt(master) || !(slave_name = ptsname(master))) {
+		perror("w1sim: cannot create pseudo-terminal");
+		return 1;
+	}
+	// slave side is kept open: the client may reopen the port and its
+	// current baud rate tells reset pulses from time slots
+	slave = open(slave_name, O_RDWR | O_NOCTTY);
+	if (slave < 0 || tcgetattr(slave, &options)) {
+		perror("w1sim: cannot open slave side");
+		return 1;
+	}
+	cfmakeraw(&options);
+	cfsetispeed(&options, B9600);
+	cfsetospeed(&options, B9600);
+	tcsetattr(slave, TCSANOW, &options);
+
+	if (link_name) {
+		unlink(link_name);
+		if (symlink(slave_name, link_name)) {
+			perror("w1sim: cannot create link");
+			return 1;
+		}
+	}
+
+	signal(SIGINT, w1simSignal);
+	signal(SIGTERM, w1simSignal);
+
+	printf("%s\n", slave_name);
+	w1simPrintDevices();
+
+	fds[0].fd = master;
+	fds[0].events = POLLIN;
+	fds[1].fd = STDIN_FILENO;
+	fds[1].events = POLLIN;
+
+	while (!w1sim_quit) {
+		u08 request[W1SIM_BUFFER_SIZE], response[W1SIM_BUFFER_SIZE];
+		int size, i, kept;
+		long wire_us = 0;
+		speed_t speed;
+
+		if (poll(fds, console ? 2 : 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			break;
+		}
+
+		if (console && fds[1].revents) {
+			char line[256];
+			if (fgets(line, sizeof(line), stdin))
+				w1simConsole(line);
+			else
+				console = 0;
+		}
+
+		if (!(fds[0].revents & POLLIN))
+			continue;
+		size = read(master, request, sizeof(request));
+		if (size <= 0)
+			continue;
+
+		tcgetattr(slave, &options);
+		speed = cfgetospeed(&options);
+		if (speed != last_speed) {
+			w1sim_stats.baud_switches++;
+			last_speed = speed;
+		}
+		w1sim_stats.exchanges++;
+		if (w1sim_options.ds2480b) {
+			size = w1simDS2480Exchange(request, size, response, w1simBaud(speed), &wire_us);
+		} else {
+			w1simExchange(request, response, size, speed);
+			wire_us = (long) (size * 10 * 1000000LL / w1simBaud(speed));
+		}
+
+		for (i = kept = 0; i < size; i++) {
+			if (w1simFault(w1sim_options.drop_faults))
+				w1sim_stats.faults++;
+			else
+				response[kept++] = response[i];
+		}
+
+		if (w1sim_options.latency_us || w1sim_options.wire_time) {
+			long us = w1sim_options.latency_us;
+			if (w1sim_options.wire_time)
+				us += wire_us;
+			usleep(us);
+		}
+		if (!w1simWriteAll(master, response, kept))
+			break;
+	}
+
+	w1simPrintStats();
+	if (link_name)
+		unlink(link_name);
+	close(slave);
+	close(master);
+	return 0;
+}
@@ -0,0 +1,167 @@
+// 1-Wire bus simulator
+// Emulates an UART based 1-Wire adapter (DS9097 style) or DS2480B serial
+// line driver on a pseudo-terminal
+
+#ifndef w1sim_h
+#define w1sim_h
+
+#include "types.h"
+
+//----- Defines ---------------------------------------------------------------
+
+#define W1SIM_MAX_DEVICES			64
+#define W1SIM_TX_SIZE				64
+
+// ROM layer states of a virtual device
+#define ROM_WAIT_RESET				0		// not selected, ignores slots until next reset
+#define ROM_COMMAND					1		// receiving ROM command byte
+#define ROM_MATCH					2		// comparing ROM id bits sent by master
+#define ROM_SEARCH					3		// taking part in (conditional) search
+#define ROM_READ					4		// sending ROM id bits
+#define ROM_SELECTED				5		// function command layer
+
+//----- Typedefs --------------------------------------------------------------
+
+typedef struct w1sim_device_S w1sim_device_T;
+
+// virtual device family
+typedef struct w1sim_type_S
+{
+	const char *name;
+	u08 family;
+	int resume;				// supports Resume ROM command
+	int overdrive;			// supports Overdrive Skip and Match ROM commands
+	// sets power-on state
+	void (*init)(w1sim_device_T *dev);
+	// parses "value[,value...]" from the command line or the console
+	int (*set)(w1sim_device_T *dev, const char *values);
+	// prints current values
+	void (*print)(w1sim_device_T *dev);
+	// function command layer: one byte received from master
+	void (*rx)(w1sim_device_T *dev, u08 byte);
+	// function command layer: all queued bytes are sent
+	void (*tx_done)(w1sim_device_T *dev);
+	// condition for Conditional Search ROM command
+	int (*alarm)(w1sim_device_T *dev);
+} w1sim_type_T;
+
+struct w1sim_device_S
+{
+	const w1sim_type_T *type;
+	u08 rom[8];
+
+	// ROM layer
+	int state;
+	int bit_index;
+	int search_phase;
+	u08 rom_command;
+	int resume_flag;		// RC flag: selected by the last Match or Search ROM
+	int overdrive;			// works at overdrive speed until standard reset
+
+	// function layer
+	u08 rx_byte;
+	int rx_bits;
+	u08 tx[W1SIM_TX_SIZE];
+	int tx_size, tx_pos, tx_bit;
+	u08 command;			// function command
+	int count;				// bytes received after function command
+	u16 address;			// target address of memory commands
+	u16 crc;
+	double busy_until;		// read slots return 0 until this moment while busy
+	int busy;
+
+	// family specific state
+	union {
+		struct {
+			double temperature;		// value of next conversion
+			u08 scratchpad[9];
+			u08 eeprom[3];			// TH, TL, configuration
+		} ds18b20;
+		struct {
+			double millivolts[4];	// input voltages of next conversion
+			u08 memory[32];			// conversion, control/status, alarm and calibration pages
+			u08 convert_mask;		// input select mask of the last convert command
+		} ds2450;
+		struct {
+			u08 inputs;				// levels driven on PIO pins from outside
+			u08 registers[8];		// 0x88..0x8F
+		} ds2408;
+	} u;
+};
+
+// simulation options
+typedef struct w1sim_options_S
+{
+	long latency_us;			// delay before each response
+	int wire_time;				// add time the bits would take on the wire
+	int presence_faults;		// per mille of resets without presence
+	int bit_faults;				// per mille of read slots with inverted bit
+	int drop_faults;			// per mille of responses that are lost
+	int noise_lsb;				// noise added to DS2450 conversions
+	int no_overdrive;			// devices ignore overdrive commands
+	int ds2480b;				// emulate DS2480B instead of UART adapter
+	int verbose;
+} w1sim_options_T;
+
+//----- Globals ---------------------------------------------------------------
+
+extern const w1sim_type_T w1sim_ds18b20;
+extern const w1sim_type_T w1sim_ds2450;
+extern const w1sim_type_T w1sim_ds2408;
+
+extern w1sim_device_T w1sim_devices[W1SIM_MAX_DEVICES];
+extern int w1sim_device_count;
+extern w1sim_options_T w1sim_options;
+
+//----- Functions ---------------------------------------------------------------
+
+// w1simNow()
+//     returns monotonic time in seconds
+double w1simNow(void);
+
+// w1simAddDevice()
+//     creates device from "family[=value,...]" specification
+//     returns 0 if specification is invalid
+w1sim_device_T *w1simAddDevice(const char *spec);
+
+// w1simReset()
+//     performs reset pulse, standard reset returns all devices to standard speed,
+//     overdrive reset is seen by devices at overdrive speed only
+//     returns true if any device answered with presence pulse
+int w1simReset(int overdrive);
+
+// w1simSlot()
+//     performs one time slot at standard or overdrive speed,
+//     bit is the value written by master
+//     returns the value seen on the bus
+int w1simSlot(int bit, int overdrive);
+
+// w1simBusReset()
+//     reset pulse of the adapter with fault injection and statistics
+//     returns true if presence pulse was seen
+int w1simBusReset(int overdrive);
+
+// w1simBusSlot()
+//     time slot of the adapter with fault injection and statistics
+//     returns the value seen on the bus
+int w1simBusSlot(int bit, int overdrive);
+
+// w1simDS2480Exchange()
+//     DS2480B: handles bytes received from master at host baud rate baud,
+//     adds time of 1-Wire activity to *wire_us
+//     returns the number of response bytes
+int w1simDS2480Exchange(const u08 *request, int size, u08 *response, long baud, long *wire_us);
+
+// w1simQueue()
+//     queues bytes to be sent by device
+void w1simQueue(w1sim_device_T *dev, const u08 *data, int size);
+
+// w1simBusy()
+//     device answers read slots with 0 for given time
+void w1simBusy(w1sim_device_T *dev, double seconds);
+
+// w1simPrintDevices()
+//     prints list of devices with their ROM ids and values
+void w1simPrintDevices(void);
+
+#endif
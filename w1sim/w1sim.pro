@@ -0,0 +1,25 @@
+######################################################################
+# 1-Wire bus simulator on pseudo-terminal, console application without Qt
+######################################################################
+
+TEMPLATE = app
+TARGET = w1sim
+DEPENDPATH += . ../dallas
+INCLUDEPATH += . ../dallas
+
+CONFIG += console release
+CONFIG -= qt
+
+# Input
+HEADERS += w1sim.h \
+           ../dallas/crc.h \
+           ../dallas/types.h
+SOURCES += w1bus.c \
+           w1devices.c \
+           w1sim.c \
+           w1ds2480.c \
+           ../dallas/crc.c
+
+OBJECTS_DIR = build
+
+unix:LIBS += -lm